@@ -4,22 +4,76 @@
 
 # Add inputs and outputs from these tool invocations to the build variables 
 CPP_SRCS += \
+../src/BackpressureSampler.cpp \
 ../src/Cache.cpp \
 ../src/CacheLine.cpp \
 ../src/CacheSet.cpp \
-../src/MultilevelCache.cpp 
+../src/CapturePipeline.cpp \
+../src/CaptureRing.cpp \
+../src/CommunicationMatrix.cpp \
+../src/ConcurrentMultilevelCache.cpp \
+../src/DataObjectMap.cpp \
+../src/FalseSharingDetector.cpp \
+../src/FootprintHistogram.cpp \
+../src/MarkovPrefetcher.cpp \
+../src/MultilevelCache.cpp \
+../src/NextLinePrefetcher.cpp \
+../src/PcAttribution.cpp \
+../src/SharedCaptureRegion.cpp \
+../src/SimulatorDaemon.cpp \
+../src/SpatialPrefetcher.cpp \
+../src/StreamPrefetcher.cpp \
+../src/StridePrefetcher.cpp \
+../src/Symbolizer.cpp \
+../src/TraceMerger.cpp 
 
 OBJS += \
+./src/BackpressureSampler.o \
 ./src/Cache.o \
 ./src/CacheLine.o \
 ./src/CacheSet.o \
-./src/MultilevelCache.o 
+./src/CapturePipeline.o \
+./src/CaptureRing.o \
+./src/CommunicationMatrix.o \
+./src/ConcurrentMultilevelCache.o \
+./src/DataObjectMap.o \
+./src/FalseSharingDetector.o \
+./src/FootprintHistogram.o \
+./src/MarkovPrefetcher.o \
+./src/MultilevelCache.o \
+./src/NextLinePrefetcher.o \
+./src/PcAttribution.o \
+./src/SharedCaptureRegion.o \
+./src/SimulatorDaemon.o \
+./src/SpatialPrefetcher.o \
+./src/StreamPrefetcher.o \
+./src/StridePrefetcher.o \
+./src/Symbolizer.o \
+./src/TraceMerger.o 
 
 CPP_DEPS += \
+./src/BackpressureSampler.d \
 ./src/Cache.d \
 ./src/CacheLine.d \
 ./src/CacheSet.d \
-./src/MultilevelCache.d 
+./src/CapturePipeline.d \
+./src/CaptureRing.d \
+./src/CommunicationMatrix.d \
+./src/ConcurrentMultilevelCache.d \
+./src/DataObjectMap.d \
+./src/FalseSharingDetector.d \
+./src/FootprintHistogram.d \
+./src/MarkovPrefetcher.d \
+./src/MultilevelCache.d \
+./src/NextLinePrefetcher.d \
+./src/PcAttribution.d \
+./src/SharedCaptureRegion.d \
+./src/SimulatorDaemon.d \
+./src/SpatialPrefetcher.d \
+./src/StreamPrefetcher.d \
+./src/StridePrefetcher.d \
+./src/Symbolizer.d \
+./src/TraceMerger.d 
 
 
 # Each subdirectory must supply rules for building sources it contributes
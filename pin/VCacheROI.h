@@ -0,0 +1,37 @@
+/*
+ * VCacheROI.h
+ *
+ *  Created on: Aug 25, 2016
+ *      Author: vance
+ */
+
+#ifndef VCACHEROI_H_
+#define VCACHEROI_H_
+
+/**
+ * Region of interest markers for applications run under VCacheTool with
+ * -roi 1. Call VCacheBeginROI() where simulation should start and
+ * VCacheEndROI() where it should stop; regions may repeat. Outside the tool
+ * the markers do nothing.
+ *
+ * The tool finds the markers by name, so they are weak, never inlined and
+ * have C linkage: every translation unit that includes this header shares
+ * one copy of each.
+ */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+__attribute__((weak, noinline)) void VCacheBeginROI(void) {
+  __asm__ __volatile__("" ::: "memory");
+}
+
+__attribute__((weak, noinline)) void VCacheEndROI(void) {
+  __asm__ __volatile__("" ::: "memory");
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* VCACHEROI_H_ */
@@ -0,0 +1,637 @@
+/*
+ * VCacheTool.cpp
+ *
+ *  Created on: Aug 25, 2016
+ *      Author: vance
+ */
+
+/*
+ * A Pintool that simulates the loads, stores and instruction fetches of an
+ * application in a VCache hierarchy.
+ *
+ * The accesses are not simulated one analysis call at a time: Pin's buffering
+ * API writes a record per access into a per-thread buffer, and the thread
+ * simulates the whole buffer when it fills. Threads simulate their buffers in
+ * parallel through a ConcurrentMultilevelCache.
+ *
+ * Simulation can be restricted to regions of interest marked in the
+ * application with VCacheROI.h (-roi 1), and can skip the first instructions
+ * of the run (-ff).
+ *
+ * With -objects 1, misses are charged to the global variables of the images
+ * and to the call sites of malloc and calloc. The allocations and frees go
+ * through the buffers with the accesses, so they are simulated in order.
+ *
+ * Build with the Pin kit: make PIN_ROOT=<kit> obj-intel64/VCacheTool.so
+ * Run: pin -t obj-intel64/VCacheTool.so [knobs] -- application
+ */
+
+#include <fstream>
+#include <iostream>
+#include <stddef.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "pin.H"
+
+#include "AccessRecord.h"
+#include "ConcurrentMultilevelCache.h"
+#include "Symbolizer.h"
+
+KNOB<std::string> KnobOutputFile(KNOB_MODE_WRITEONCE, "pintool", "o",
+    "vcache.out", "output file");
+KNOB<UINT32> KnobCores(KNOB_MODE_WRITEONCE, "pintool", "cores", "1",
+    "cores; thread i runs on core i modulo cores");
+KNOB<UINT32> KnobLineSize(KNOB_MODE_WRITEONCE, "pintool", "line", "64",
+    "line size in bytes");
+KNOB<UINT64> KnobL1Size(KNOB_MODE_WRITEONCE, "pintool", "l1", "32768",
+    "L1 (data) capacity in bytes");
+KNOB<UINT32> KnobL1Assoc(KNOB_MODE_WRITEONCE, "pintool", "l1_assoc", "8",
+    "L1 (data) associativity");
+KNOB<UINT64> KnobL1ISize(KNOB_MODE_WRITEONCE, "pintool", "l1i", "0",
+    "L1 instruction capacity in bytes, 0 for a unified L1");
+KNOB<UINT32> KnobL1IAssoc(KNOB_MODE_WRITEONCE, "pintool", "l1i_assoc", "8",
+    "L1 instruction associativity");
+KNOB<UINT64> KnobL2Size(KNOB_MODE_WRITEONCE, "pintool", "l2", "262144",
+    "L2 capacity in bytes, 0 for no L2");
+KNOB<UINT32> KnobL2Assoc(KNOB_MODE_WRITEONCE, "pintool", "l2_assoc", "8",
+    "L2 associativity");
+KNOB<UINT64> KnobL3Size(KNOB_MODE_WRITEONCE, "pintool", "l3", "8388608",
+    "L3 capacity in bytes, 0 for no L3");
+KNOB<UINT32> KnobL3Assoc(KNOB_MODE_WRITEONCE, "pintool", "l3_assoc", "16",
+    "L3 associativity");
+KNOB<BOOL> KnobIFetch(KNOB_MODE_WRITEONCE, "pintool", "ifetch", "1",
+    "simulate instruction fetches");
+KNOB<BOOL> KnobROI(KNOB_MODE_WRITEONCE, "pintool", "roi", "0",
+    "simulate only between VCacheBeginROI() and VCacheEndROI()");
+KNOB<UINT64> KnobFastForward(KNOB_MODE_WRITEONCE, "pintool", "ff", "0",
+    "instructions to execute before simulating");
+KNOB<UINT32> KnobBufferPages(KNOB_MODE_WRITEONCE, "pintool", "pages", "64",
+    "pages of records per thread buffer");
+KNOB<UINT32> KnobPcEntries(KNOB_MODE_WRITEONCE, "pintool", "pcs", "0",
+    "entries per shard of the table charging misses to instructions, a "
+    "power of two, 0 to disable");
+KNOB<BOOL> KnobObjects(KNOB_MODE_WRITEONCE, "pintool", "objects", "0",
+    "charge misses to global variables and heap allocation sites");
+KNOB<std::string> KnobCachegrindFile(KNOB_MODE_WRITEONCE, "pintool", "cg",
+    "cachegrind.out.vcache",
+    "the per source line charges of -pcs, in Cachegrind's format");
+
+/**
+ * The record Pin writes into the buffer for each access. Pin fills the
+ * fields at their offsets, so the addresses must be ADDRINTs.
+ */
+struct PinRecord {
+  ADDRINT address;
+  // The instruction that made the access, for the prefetchers.
+  ADDRINT pc;
+  UINT32 size;
+  UINT32 type;
+};
+
+// Hold the size and type, then the call site, of the allocation of each
+// thread from the entry of the outermost allocator to its return, and the
+// object's address if the allocator returns it through an argument.
+static REG allocation_register;
+static REG site_register;
+static REG address_register;
+// The stack pointer at the entry of the outermost allocator of each
+// thread, or 0 outside the allocators: operator new calls malloc, and only
+// the outermost allocator is recorded, with its caller as the site.
+static REG frame_register;
+
+static ConcurrentMultilevelCache* cache;
+static BUFFER_ID buffer;
+static UINT32 line_size_B;
+// Instructions left to fast-forward; accessed by every thread until zero.
+static volatile UINT64 fast_forward_remaining;
+static volatile BOOL in_roi;
+// Set iff accesses are recorded: the run is past the fast-forward and in a
+// region of interest.
+static volatile BOOL capturing;
+static UINT64 n_records;
+// The upper 32 bits of the addresses simulated, which VCache drops, and
+// whether addresses with other upper bits were reported.
+static volatile UINT64 high_bits = NO_HIGH_BITS;
+static volatile BOOL warned_high_bits;
+// The path and load offset of every image loaded, to symbolize the pcs.
+static std::vector<std::pair<std::string, ADDRINT> > images;
+static std::string main_executable;
+
+static VOID UpdateCapturing() {
+  capturing = fast_forward_remaining == 0 && in_roi;
+}
+
+/* ===================================================================== */
+/* Analysis routines                                                     */
+/* ===================================================================== */
+
+static ADDRINT PIN_FAST_ANALYSIS_CALL IsCapturing() {
+  return capturing;
+}
+
+static ADDRINT PIN_FAST_ANALYSIS_CALL IsFastForwarding() {
+  return fast_forward_remaining != 0;
+}
+
+static VOID PIN_FAST_ANALYSIS_CALL CountBlock(UINT32 n_instructions) {
+  while (true) {
+    const UINT64 remaining = fast_forward_remaining;
+    if (remaining == 0) {
+      return;
+    }
+    const UINT64 next =
+        remaining > n_instructions ? remaining - n_instructions : 0;
+    if (__sync_bool_compare_and_swap(&fast_forward_remaining, remaining,
+        next)) {
+      if (next == 0) {
+        UpdateCapturing();
+      }
+      return;
+    }
+  }
+}
+
+static VOID BeginROI() {
+  in_roi = TRUE;
+  UpdateCapturing();
+}
+
+static VOID EndROI() {
+  in_roi = FALSE;
+  UpdateCapturing();
+}
+
+/**
+ * Returns the size and type fields of the record of an allocation of size
+ * bytes, as one ADDRINT: x86 is little-endian, so size comes first.
+ */
+static ADDRINT PIN_FAST_ANALYSIS_CALL GetAllocationFields(ADDRINT size) {
+  const UINT32 size_field = size < UINT32_MAX ? size : UINT32_MAX;
+  return ((ADDRINT) ACCESS_ALLOC << 32) | size_field;
+}
+
+static ADDRINT PIN_FAST_ANALYSIS_CALL GetCallocFields(ADDRINT n_elements,
+    ADDRINT size) {
+  return GetAllocationFields(n_elements * size);
+}
+
+/**
+ * Returns value, to copy it into a tool register.
+ */
+static ADDRINT PIN_FAST_ANALYSIS_CALL GetValue(ADDRINT value) {
+  return value;
+}
+
+static ADDRINT PIN_FAST_ANALYSIS_CALL GetZero() {
+  return 0;
+}
+
+/**
+ * Returns whether the allocator entered with stack_pointer is the outermost
+ * one. An allocator called by another runs below its frame; a frame at or
+ * below the stack pointer was left without returning, eg. by an exception
+ * or a longjmp, and is forgotten.
+ */
+static ADDRINT PIN_FAST_ANALYSIS_CALL IsOutermostEntry(ADDRINT frame,
+    ADDRINT stack_pointer) {
+  return frame == 0 || stack_pointer >= frame;
+}
+
+/**
+ * Returns whether the ret at stack_pointer returns from the outermost
+ * allocator: the stack pointer is back where it was at the entry.
+ */
+static ADDRINT PIN_FAST_ANALYSIS_CALL IsOutermostReturn(ADDRINT frame,
+    ADDRINT stack_pointer) {
+  return stack_pointer == frame;
+}
+
+/**
+ * Returns the object posix_memalign stored at pointer if it returned 0, or
+ * 0 if it failed. The result is an int, in the low half of the register.
+ */
+static ADDRINT LoadObject(ADDRINT pointer, ADDRINT result) {
+  ADDRINT object = 0;
+  if ((UINT32) result == 0) {
+    PIN_SafeCopy(&object, (const VOID*) pointer, sizeof(object));
+  }
+  return object;
+}
+
+/* ===================================================================== */
+/* Instrumentation routines                                              */
+/* ===================================================================== */
+
+/**
+ * How an allocator takes its arguments and returns the object.
+ */
+struct Allocator {
+  const char* name;
+  // The argument holding the size, and the one holding the number of
+  // objects of that size, or -1.
+  INT32 size_argument;
+  INT32 count_argument;
+  // The argument pointing to where the object is stored, or -1 if it is
+  // returned.
+  INT32 pointer_argument;
+  // The argument holding an object the allocator frees, or -1.
+  INT32 freed_argument;
+};
+
+static const Allocator ALLOCATORS[] = {
+  { "malloc", 0, -1, -1, -1 },
+  { "calloc", 1, 0, -1, -1 },
+  // Recorded as the free of the object, then the allocation of the new one.
+  { "realloc", 1, -1, -1, 0 },
+  { "posix_memalign", 2, -1, 0, -1 },
+  { "aligned_alloc", 1, -1, -1, -1 },
+  { "memalign", 1, -1, -1, -1 },
+  // operator new and new[], plain, aligned and nothrow. The plain and
+  // aligned new[] jump to new, which returns to the caller of new[]: they
+  // are recorded, with that caller as the site, without instrumenting them.
+  // The nothrow new[] call them, and are instrumented.
+  { "_Znwm", 0, -1, -1, -1 },
+  { "_ZnwmSt11align_val_t", 0, -1, -1, -1 },
+  { "_ZnwmRKSt9nothrow_t", 0, -1, -1, -1 },
+  { "_ZnwmSt11align_val_tRKSt9nothrow_t", 0, -1, -1, -1 },
+  { "_ZnamRKSt9nothrow_t", 0, -1, -1, -1 },
+  { "_ZnamSt11align_val_tRKSt9nothrow_t", 0, -1, -1, -1 }
+};
+
+/**
+ * Appends the allocations of an allocator to the buffer when it returns.
+ * The buffered records of the thread are simulated first, in order, and an
+ * allocation is recorded in or out of the regions of interest: the objects
+ * may be accessed in a later region. The allocators called by another are
+ * not recorded, so that an object is recorded once, at the call to the
+ * outermost allocator.
+ */
+static VOID InstrumentAllocator(RTN rtn, const Allocator& allocator) {
+  RTN_Open(rtn);
+  // The arguments are read at the entry, which is the first instruction.
+  // Each call is guarded by its own test, so the frame is saved last.
+  const INS head = RTN_InsHead(rtn);
+  INS_InsertIfCall(head, IPOINT_BEFORE, (AFUNPTR) IsOutermostEntry,
+      IARG_FAST_ANALYSIS_CALL, IARG_REG_VALUE, frame_register,
+      IARG_REG_VALUE, REG_STACK_PTR, IARG_END);
+  if (allocator.count_argument < 0) {
+    INS_InsertThenCall(head, IPOINT_BEFORE, (AFUNPTR) GetAllocationFields,
+        IARG_FAST_ANALYSIS_CALL,
+        IARG_FUNCARG_ENTRYPOINT_VALUE, allocator.size_argument,
+        IARG_RETURN_REGS, allocation_register, IARG_END);
+  } else {
+    INS_InsertThenCall(head, IPOINT_BEFORE, (AFUNPTR) GetCallocFields,
+        IARG_FAST_ANALYSIS_CALL,
+        IARG_FUNCARG_ENTRYPOINT_VALUE, allocator.count_argument,
+        IARG_FUNCARG_ENTRYPOINT_VALUE, allocator.size_argument,
+        IARG_RETURN_REGS, allocation_register, IARG_END);
+  }
+  INS_InsertIfCall(head, IPOINT_BEFORE, (AFUNPTR) IsOutermostEntry,
+      IARG_FAST_ANALYSIS_CALL, IARG_REG_VALUE, frame_register,
+      IARG_REG_VALUE, REG_STACK_PTR, IARG_END);
+  INS_InsertThenCall(head, IPOINT_BEFORE, (AFUNPTR) GetValue,
+      IARG_FAST_ANALYSIS_CALL, IARG_RETURN_IP, IARG_RETURN_REGS,
+      site_register, IARG_END);
+  if (allocator.pointer_argument >= 0) {
+    INS_InsertIfCall(head, IPOINT_BEFORE, (AFUNPTR) IsOutermostEntry,
+        IARG_FAST_ANALYSIS_CALL, IARG_REG_VALUE, frame_register,
+        IARG_REG_VALUE, REG_STACK_PTR, IARG_END);
+    INS_InsertThenCall(head, IPOINT_BEFORE, (AFUNPTR) GetValue,
+        IARG_FAST_ANALYSIS_CALL,
+        IARG_FUNCARG_ENTRYPOINT_VALUE, allocator.pointer_argument,
+        IARG_RETURN_REGS, address_register, IARG_END);
+  }
+  if (allocator.freed_argument >= 0) {
+    INS_InsertIfCall(head, IPOINT_BEFORE, (AFUNPTR) IsOutermostEntry,
+        IARG_FAST_ANALYSIS_CALL, IARG_REG_VALUE, frame_register,
+        IARG_REG_VALUE, REG_STACK_PTR, IARG_END);
+    INS_InsertFillBufferThen(head, IPOINT_BEFORE, buffer,
+        IARG_FUNCARG_ENTRYPOINT_VALUE, allocator.freed_argument,
+        offsetof(PinRecord, address),
+        IARG_INST_PTR, offsetof(PinRecord, pc),
+        IARG_UINT32, 0, offsetof(PinRecord, size),
+        IARG_UINT32, (UINT32) ACCESS_FREE, offsetof(PinRecord, type),
+        IARG_END);
+  }
+  INS_InsertIfCall(head, IPOINT_BEFORE, (AFUNPTR) IsOutermostEntry,
+      IARG_FAST_ANALYSIS_CALL, IARG_REG_VALUE, frame_register,
+      IARG_REG_VALUE, REG_STACK_PTR, IARG_END);
+  INS_InsertThenCall(head, IPOINT_BEFORE, (AFUNPTR) GetValue,
+      IARG_FAST_ANALYSIS_CALL, IARG_REG_VALUE, REG_STACK_PTR,
+      IARG_RETURN_REGS, frame_register, IARG_END);
+
+  for (INS ins = head; INS_Valid(ins); ins = INS_Next(ins)) {
+    if (!INS_IsRet(ins)) {
+      continue;
+    }
+    REG address = REG_GAX;
+    if (allocator.pointer_argument >= 0) {
+      INS_InsertIfCall(ins, IPOINT_BEFORE, (AFUNPTR) IsOutermostReturn,
+          IARG_FAST_ANALYSIS_CALL, IARG_REG_VALUE, frame_register,
+          IARG_REG_VALUE, REG_STACK_PTR, IARG_END);
+      INS_InsertThenCall(ins, IPOINT_BEFORE, (AFUNPTR) LoadObject,
+          IARG_REG_VALUE, address_register, IARG_REG_VALUE, REG_GAX,
+          IARG_RETURN_REGS, address_register, IARG_END);
+      address = address_register;
+    }
+    // The size and type fields are written at once.
+    INS_InsertIfCall(ins, IPOINT_BEFORE, (AFUNPTR) IsOutermostReturn,
+        IARG_FAST_ANALYSIS_CALL, IARG_REG_VALUE, frame_register,
+        IARG_REG_VALUE, REG_STACK_PTR, IARG_END);
+    INS_InsertFillBufferThen(ins, IPOINT_BEFORE, buffer,
+        IARG_REG_VALUE, address, offsetof(PinRecord, address),
+        IARG_REG_VALUE, site_register, offsetof(PinRecord, pc),
+        IARG_REG_VALUE, allocation_register, offsetof(PinRecord, size),
+        IARG_END);
+    INS_InsertIfCall(ins, IPOINT_BEFORE, (AFUNPTR) IsOutermostReturn,
+        IARG_FAST_ANALYSIS_CALL, IARG_REG_VALUE, frame_register,
+        IARG_REG_VALUE, REG_STACK_PTR, IARG_END);
+    INS_InsertThenCall(ins, IPOINT_BEFORE, (AFUNPTR) GetZero,
+        IARG_FAST_ANALYSIS_CALL, IARG_RETURN_REGS, frame_register, IARG_END);
+  }
+  RTN_Close(rtn);
+}
+
+/**
+ * Records the data objects of an image: its global variables now, and its
+ * heap objects as they are allocated if it is the C library.
+ */
+static VOID InstrumentObjects(IMG img) {
+  Symbolizer symbolizer;
+  try {
+    symbolizer.LoadElf(IMG_Name(img), IMG_LoadOffset(img));
+  } catch (const std::exception& error) {
+    std::cerr << "VCacheTool: " << error.what() << std::endl;
+  }
+  for (size_t i = 0; i < symbolizer.data_symbols.size(); i++) {
+    const DataSymbol& symbol = symbolizer.data_symbols[i];
+    cache->AddGlobal(symbol.address, symbol.size_B, symbol.name);
+  }
+
+  for (size_t i = 0; i < sizeof(ALLOCATORS) / sizeof(ALLOCATORS[0]); i++) {
+    const RTN allocator = RTN_FindByName(img, ALLOCATORS[i].name);
+    if (RTN_Valid(allocator)) {
+      InstrumentAllocator(allocator, ALLOCATORS[i]);
+    }
+  }
+  RTN rtn = RTN_FindByName(img, "free");
+  if (RTN_Valid(rtn)) {
+    RTN_Open(rtn);
+    INS_InsertFillBuffer(RTN_InsHead(rtn), IPOINT_BEFORE, buffer,
+        IARG_FUNCARG_ENTRYPOINT_VALUE, 0, offsetof(PinRecord, address),
+        IARG_INST_PTR, offsetof(PinRecord, pc),
+        IARG_UINT32, 0, offsetof(PinRecord, size),
+        IARG_UINT32, (UINT32) ACCESS_FREE, offsetof(PinRecord, type),
+        IARG_END);
+    RTN_Close(rtn);
+  }
+}
+
+static VOID ThreadStart(THREADID tid, CONTEXT* ctxt, INT32 flags, VOID* v) {
+  PIN_SetContextReg(ctxt, frame_register, 0);
+}
+
+static VOID Image(IMG img, VOID* v) {
+  images.push_back(std::make_pair(IMG_Name(img), IMG_LoadOffset(img)));
+  if (IMG_IsMainExecutable(img)) {
+    main_executable = IMG_Name(img);
+  }
+  if (KnobObjects.Value()) {
+    InstrumentObjects(img);
+  }
+  RTN rtn = RTN_FindByName(img, "VCacheBeginROI");
+  if (RTN_Valid(rtn)) {
+    RTN_Open(rtn);
+    RTN_InsertCall(rtn, IPOINT_BEFORE, (AFUNPTR) BeginROI, IARG_END);
+    RTN_Close(rtn);
+  }
+  rtn = RTN_FindByName(img, "VCacheEndROI");
+  if (RTN_Valid(rtn)) {
+    RTN_Open(rtn);
+    RTN_InsertCall(rtn, IPOINT_BEFORE, (AFUNPTR) EndROI, IARG_END);
+    RTN_Close(rtn);
+  }
+}
+
+static VOID Trace(TRACE trace, VOID* v) {
+  for (BBL bbl = TRACE_BblHead(trace); BBL_Valid(bbl); bbl = BBL_Next(bbl)) {
+    if (KnobFastForward.Value() != 0) {
+      BBL_InsertIfCall(bbl, IPOINT_BEFORE, (AFUNPTR) IsFastForwarding,
+          IARG_FAST_ANALYSIS_CALL, IARG_END);
+      BBL_InsertThenCall(bbl, IPOINT_BEFORE, (AFUNPTR) CountBlock,
+          IARG_FAST_ANALYSIS_CALL, IARG_UINT32, BBL_NumIns(bbl), IARG_END);
+    }
+
+    if (KnobIFetch.Value()) {
+      // One fetch record per basic block.
+      INS head = BBL_InsHead(bbl);
+      INS_InsertIfCall(head, IPOINT_BEFORE, (AFUNPTR) IsCapturing,
+          IARG_FAST_ANALYSIS_CALL, IARG_END);
+      INS_InsertFillBufferThen(head, IPOINT_BEFORE, buffer,
+          IARG_ADDRINT, BBL_Address(bbl), offsetof(PinRecord, address),
+          IARG_ADDRINT, BBL_Address(bbl), offsetof(PinRecord, pc),
+          IARG_UINT32, (UINT32) BBL_Size(bbl), offsetof(PinRecord, size),
+          IARG_UINT32, (UINT32) ACCESS_IFETCH, offsetof(PinRecord, type),
+          IARG_END);
+    }
+
+    for (INS ins = BBL_InsHead(bbl); INS_Valid(ins); ins = INS_Next(ins)) {
+      const UINT32 n_operands = INS_MemoryOperandCount(ins);
+      for (UINT32 op = 0; op < n_operands; op++) {
+        UINT32 type;
+        if (INS_MemoryOperandIsRead(ins, op)
+            && INS_MemoryOperandIsWritten(ins, op)) {
+          type = ACCESS_RMW;
+        } else if (INS_MemoryOperandIsWritten(ins, op)) {
+          type = ACCESS_STORE;
+        } else {
+          type = ACCESS_LOAD;
+        }
+        INS_InsertIfCall(ins, IPOINT_BEFORE, (AFUNPTR) IsCapturing,
+            IARG_FAST_ANALYSIS_CALL, IARG_END);
+        INS_InsertFillBufferThen(ins, IPOINT_BEFORE, buffer,
+            IARG_MEMORYOP_EA, op, offsetof(PinRecord, address),
+            IARG_INST_PTR, offsetof(PinRecord, pc),
+            IARG_UINT32, INS_MemoryOperandSize(ins, op),
+            offsetof(PinRecord, size),
+            IARG_UINT32, type, offsetof(PinRecord, type),
+            IARG_END);
+      }
+    }
+  }
+}
+
+/**
+ * Warns, once, about an address that will alias with those of other upper
+ * bits.
+ */
+static VOID CheckHighBits(const ADDRINT address) {
+  if (!Address::HasHighBits(address, high_bits)
+      && __sync_bool_compare_and_swap(&warned_high_bits, FALSE, TRUE)) {
+    std::cerr << "VCacheTool: the addresses differ above their low 32 bits, "
+        "the only ones simulated: some alias." << std::endl;
+  }
+}
+
+/**
+ * Simulates a full buffer of thread tid, and the last records of a thread
+ * that exits. Runs in the application thread.
+ */
+static VOID* BufferFull(BUFFER_ID id, THREADID tid, const CONTEXT* ctxt,
+    VOID* buf, UINT64 n_elements, VOID* v) {
+  const PinRecord* const records = (const PinRecord*) buf;
+  for (UINT64 i = 0; i < n_elements; i++) {
+    // VCache addresses are 32 bits wide.
+    CheckHighBits(records[i].address);
+    ADDRESS address = (ADDRESS) records[i].address;
+    if (records[i].type >= ACCESS_ALLOC) {
+      cache->Access(AccessRecord(address, records[i].size,
+          (AccessType) records[i].type, HINT_NONE, tid, 0,
+          (ADDRESS) records[i].pc));
+      continue;
+    }
+    UINT32 bytes_remaining = records[i].size;
+    // Basic blocks may exceed the size of a record: split them by line.
+    while (bytes_remaining > 0) {
+      const UINT32 bytes_to_end_of_line = line_size_B
+          - (address & (line_size_B - 1));
+      const UINT32 size =
+          bytes_remaining < bytes_to_end_of_line ?
+              bytes_remaining : bytes_to_end_of_line;
+      cache->Access(AccessRecord(address, size,
+          (AccessType) records[i].type, HINT_NONE, tid, 0,
+          (ADDRESS) records[i].pc));
+      address += size;
+      bytes_remaining -= size;
+    }
+  }
+  __sync_fetch_and_add(&n_records, n_elements);
+  return buf;
+}
+
+static VOID Fini(INT32 code, VOID* v) {
+  std::ofstream out(KnobOutputFile.Value().c_str());
+  cache->Finalize();
+  const std::vector<LevelCounters> level_counters =
+      cache->SumLevelCounters();
+  out << "Records: " << n_records << std::endl;
+  out << "Hits: " << cache->Sum(&MultilevelCache::hits) << ", Misses: "
+      << cache->Sum(&MultilevelCache::misses) << std::endl;
+  for (size_t i = 0; i < level_counters.size(); i++) {
+    const LevelCounters& counters = level_counters[i];
+    out << "Cache " << i << ": Hits: " << counters.hits << ", Misses: "
+        << counters.misses << ", Evictions: " << counters.GetEvictionCount()
+        << " (Capacity: " << counters.evictions[EVICTION_CAPACITY]
+        << ", Inclusion: " << counters.evictions[EVICTION_INCLUSION]
+        << ", Flush: " << counters.evictions[EVICTION_FLUSH]
+        << ", Coherence: " << counters.evictions[EVICTION_COHERENCE]
+        << "), BackInvals: " << counters.back_invalidations
+        << ", WriteBacks: " << counters.write_backs << ", Resident: "
+        << counters.resident_lines << std::endl;
+  }
+  if (KnobCores.Value() > 1) {
+    const std::vector<UINT64> coherence_misses = cache->Sum(
+        &MultilevelCache::coherence_misses);
+    const std::vector<UINT64> cache_to_cache_transfers = cache->Sum(
+        &MultilevelCache::cache_to_cache_transfers);
+    for (size_t core = 0; core < coherence_misses.size(); core++) {
+      out << "Core " << core << ": CohMisses: " << coherence_misses[core]
+          << ", C2C: " << cache_to_cache_transfers[core] << std::endl;
+    }
+  }
+  const FootprintHistogram footprints = cache->MergeFootprints();
+  if (footprints.n_lines) {
+    out << footprints;
+  }
+  if (KnobObjects.Value()) {
+    out << cache->MergeDataObjects();
+  }
+  if (KnobPcEntries.Value() != 0) {
+    const PcAttribution attribution = cache->MergePcAttribution(
+        KnobPcEntries.Value());
+    out << attribution;
+    // Symbolize from the binaries on disk: images without a file, eg. the
+    // vDSO, stay unknown.
+    Symbolizer symbolizer;
+    for (size_t i = 0; i < images.size(); i++) {
+      try {
+        symbolizer.LoadElf(images[i].first, images[i].second);
+      } catch (const std::exception& error) {
+        std::cerr << "VCacheTool: " << error.what() << std::endl;
+      }
+    }
+    std::ofstream cachegrind(KnobCachegrindFile.Value().c_str());
+    symbolizer.WriteCachegrind(cachegrind, attribution, main_executable);
+  }
+  out.close();
+  delete cache;
+}
+
+static INT32 Usage() {
+  std::cerr << "Simulates the application's accesses in a VCache hierarchy."
+      << std::endl << KNOB_BASE::StringKnobSummary() << std::endl;
+  return -1;
+}
+
+int main(int argc, char* argv[]) {
+  PIN_InitSymbols();
+  if (PIN_Init(argc, argv)) {
+    return Usage();
+  }
+
+  std::vector<uint64_t> capacities_B;
+  std::vector<uint16_t> associativities;
+  capacities_B.push_back(KnobL1Size.Value());
+  associativities.push_back(KnobL1Assoc.Value());
+  if (KnobL2Size.Value() != 0) {
+    capacities_B.push_back(KnobL2Size.Value());
+    associativities.push_back(KnobL2Assoc.Value());
+  }
+  if (KnobL3Size.Value() != 0) {
+    capacities_B.push_back(KnobL3Size.Value());
+    associativities.push_back(KnobL3Assoc.Value());
+  }
+  line_size_B = KnobLineSize.Value();
+  if (KnobL1ISize.Value() != 0) {
+    cache = new ConcurrentMultilevelCache(KnobCores.Value(), capacities_B,
+        associativities, KnobL1ISize.Value(), KnobL1IAssoc.Value(),
+        line_size_B);
+  } else {
+    cache = new ConcurrentMultilevelCache(KnobCores.Value(), capacities_B,
+        associativities, line_size_B);
+  }
+
+  if (KnobPcEntries.Value() != 0) {
+    cache->EnablePcAttribution(KnobPcEntries.Value());
+  }
+  if (KnobObjects.Value()) {
+    cache->EnableDataObjects();
+    allocation_register = PIN_ClaimToolRegister();
+    site_register = PIN_ClaimToolRegister();
+    address_register = PIN_ClaimToolRegister();
+    frame_register = PIN_ClaimToolRegister();
+    PIN_AddThreadStartFunction(ThreadStart, NULL);
+  }
+
+  fast_forward_remaining = KnobFastForward.Value();
+  in_roi = !KnobROI.Value();
+  UpdateCapturing();
+  n_records = 0;
+
+  buffer = PIN_DefineTraceBuffer(sizeof(PinRecord), KnobBufferPages.Value(),
+      BufferFull, NULL);
+  if (buffer == BUFFER_ID_INVALID) {
+    std::cerr << "Could not allocate the record buffers." << std::endl;
+    return 1;
+  }
+
+  IMG_AddInstrumentFunction(Image, NULL);
+  TRACE_AddInstrumentFunction(Trace, NULL);
+  PIN_AddFiniFunction(Fini, NULL);
+
+  // Never returns.
+  PIN_StartProgram();
+  return 0;
+}
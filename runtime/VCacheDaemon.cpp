@@ -0,0 +1,167 @@
+/*
+ * VCacheDaemon.cpp
+ *
+ *  Created on: Sep 2, 2016
+ *      Author: vance
+ */
+
+#include <fstream>
+#include <iostream>
+#include <pthread.h>
+#include <signal.h>
+#include <stdexcept>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "ConcurrentMultilevelCache.h"
+#include "SharedCaptureRegion.h"
+#include "SimulatorDaemon.h"
+
+/**
+ * vcached: simulates the processes that run with VCACHE_DAEMON set to its
+ * region against one hierarchy, until it is interrupted, then writes the
+ * report.
+ */
+
+namespace {
+
+void Usage(const char* const program) {
+  std::cerr << "Usage: " << program << " [options]" << std::endl
+      << "  -n name    shared-memory region, default /vcache" << std::endl
+      << "  -s slots   threads attached at once, default "
+      << DEFAULT_REGION_SLOTS << std::endl
+      << "  -r records capacity of each ring, default "
+      << DEFAULT_RING_CAPACITY << std::endl
+      << "  -c caches  capacity:associativity of each level, default "
+      << "32768:8,262144:8,8388608:16" << std::endl
+      << "  -l bytes   line size, default " << DEFAULT_LINE_SIZE << std::endl
+      << "  -k cores   cores, default 1" << std::endl
+      << "  -j threads simulator threads, default 1" << std::endl
+      << "  -m mode    sampling when behind: sets, time or none, default sets"
+      << std::endl
+      << "  -S period  longest sampling period, default "
+      << DEFAULT_MAX_SAMPLE_PERIOD << std::endl
+      << "  -p         simulate physical addresses" << std::endl
+      << "  -o file    report file, default vcached.out" << std::endl;
+  exit(1);
+}
+
+}
+
+int main(int argc, char* argv[]) {
+  std::string name = "/vcache";
+  std::string output_file = "vcached.out";
+  const char* levels = "32768:8,262144:8,8388608:16";
+  uint32_t n_slots = DEFAULT_REGION_SLOTS;
+  uint64_t capacity = DEFAULT_RING_CAPACITY;
+  uint16_t line_size_B = DEFAULT_LINE_SIZE;
+  uint8_t n_cores = 1;
+  uint32_t n_simulators = 1;
+  SamplingMode mode = SAMPLING_SETS;
+  uint32_t max_period = DEFAULT_MAX_SAMPLE_PERIOD;
+  bool physical = false;
+  int option;
+  while ((option = getopt(argc, argv, "n:s:r:c:l:k:j:m:S:po:")) != -1) {
+    switch (option) {
+    case 'n':
+      name = optarg;
+      break;
+    case 's':
+      n_slots = strtoul(optarg, NULL, 0);
+      break;
+    case 'r':
+      capacity = strtoull(optarg, NULL, 0);
+      break;
+    case 'c':
+      levels = optarg;
+      break;
+    case 'l':
+      line_size_B = strtoul(optarg, NULL, 0);
+      break;
+    case 'k':
+      n_cores = strtoul(optarg, NULL, 0);
+      break;
+    case 'j':
+      n_simulators = strtoul(optarg, NULL, 0);
+      break;
+    case 'm':
+      if (std::string(optarg) == "time") {
+        mode = SAMPLING_TIME;
+      } else if (std::string(optarg) == "none") {
+        max_period = 1;
+      } else if (std::string(optarg) != "sets") {
+        Usage(argv[0]);
+      }
+      break;
+    case 'S':
+      max_period = strtoul(optarg, NULL, 0);
+      break;
+    case 'p':
+      physical = true;
+      break;
+    case 'o':
+      output_file = optarg;
+      break;
+    default:
+      Usage(argv[0]);
+    }
+  }
+  std::vector<uint64_t> capacities_B;
+  std::vector<uint16_t> associativities;
+  try {
+    ConcurrentMultilevelCache::ParseLevels(levels, capacities_B,
+        associativities);
+  } catch (const std::invalid_argument& error) {
+    std::cerr << "vcached: " << error.what() << std::endl;
+    Usage(argv[0]);
+  }
+
+  // The simulator threads inherit the mask: only sigwait sees the signals.
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+  try {
+    ConcurrentMultilevelCache cache(n_cores, capacities_B, associativities,
+        line_size_B);
+    SharedCaptureRegion region(name, n_slots, capacity);
+    SimulatorDaemon daemon(region, cache, n_simulators, physical, mode,
+        max_period);
+    daemon.Start();
+    std::cerr << "vcached: simulating processes with VCACHE_DAEMON=" << name
+        << std::endl;
+    int signal;
+    sigwait(&signals, &signal);
+    daemon.Stop();
+    cache.Finalize();
+
+    std::ofstream out(output_file.c_str());
+    const double ratio = daemon.GetSamplingRatio();
+    out << daemon;
+    out << "Hits: " << cache.Sum(&MultilevelCache::hits) << ", Misses: "
+        << cache.Sum(&MultilevelCache::misses) << " (sampling ratio "
+        << ratio << ")" << std::endl;
+    const std::vector<LevelCounters> level_counters =
+        cache.SumLevelCounters();
+    for (size_t i = 0; i < level_counters.size(); i++) {
+      out << "Cache " << i << ": Hits: " << level_counters[i].hits
+          << ", Misses: " << level_counters[i].misses << ", Evictions: "
+          << level_counters[i].GetEvictionCount() << ", Resident: "
+          << level_counters[i].resident_lines << " (sampling ratio "
+          << ratio << ")" << std::endl;
+    }
+    const FootprintHistogram footprints = cache.MergeFootprints();
+    if (footprints.n_lines) {
+      out << footprints;
+    }
+  } catch (const std::exception& error) {
+    std::cerr << "vcached: " << error.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
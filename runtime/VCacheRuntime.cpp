@@ -0,0 +1,480 @@
+/*
+ * VCacheRuntime.cpp
+ *
+ *  Created on: Aug 29, 2016
+ *      Author: vance
+ */
+
+#include "VCacheRuntime.h"
+
+#include <fstream>
+#include <iostream>
+#include <link.h>
+#include <pthread.h>
+#include <stdexcept>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+#include "AccessRecord.h"
+#include "CapturePipeline.h"
+#include "CaptureRing.h"
+#include "ConcurrentMultilevelCache.h"
+#include "SharedCaptureRegion.h"
+#include "Symbolizer.h"
+
+namespace {
+
+enum RuntimeState {
+  STATE_STOPPED,
+  STATE_STARTING,
+  STATE_CAPTURING,
+  STATE_FINISHED
+};
+
+// Larger accesses are split into records of at most this many bytes.
+const size_t MAX_RECORD_SIZE = 128;
+
+ConcurrentMultilevelCache* cache;
+CapturePipeline* pipeline;
+// Set iff a daemon simulates the accesses instead.
+SharedCaptureRegion* region;
+// Not a std::string: it is used from a destructor function, which may run
+// after static objects are destroyed.
+const char* output_file;
+uint32_t n_threads_max;
+uint8_t n_cores;
+// Set iff the misses are charged to data objects.
+bool objects;
+volatile uint32_t n_threads;
+volatile int state = STATE_STOPPED;
+// The upper 32 bits of the addresses captured, which VCache drops, and
+// whether addresses with other upper bits were reported.
+volatile uint64_t high_bits = NO_HIGH_BITS;
+volatile int warned_high_bits;
+pthread_key_t exit_key;
+
+// The ring of the calling thread, or NULL before its first access.
+__thread CaptureRing* ring;
+__thread uint16_t thread_id;
+// Set iff the thread came after the first n_threads_max threads.
+__thread bool refused;
+// The daemon slot of the calling thread, or NULL before its first access.
+__thread SharedRing* shared_ring;
+
+uint64_t GetEnv(const char* const name, const uint64_t value) {
+  const char* const text = getenv(name);
+  return text != NULL ? strtoull(text, NULL, 0) : value;
+}
+
+/**
+ * Publishes the records of an exiting thread.
+ */
+void FlushRing(void* exiting_ring) {
+  ((CaptureRing*) exiting_ring)->Flush();
+}
+
+/**
+ * Leaves the daemon slot of an exiting thread.
+ */
+void DetachRing(void* exiting_ring) {
+  region->Detach((SharedRing*) exiting_ring);
+}
+
+/**
+ * In a forked child, the rings belong to the parent. With a daemon the
+ * child's threads attach their own slots; without one, nothing drains the
+ * child's rings, so it does not capture.
+ */
+void ForkChild() {
+  pthread_setspecific(exit_key, NULL);
+  if (region != NULL) {
+    shared_ring = NULL;
+    refused = false;
+  } else {
+    state = STATE_FINISHED;
+  }
+}
+
+/**
+ * Opens the region of the daemon named by VCACHE_DAEMON, if any. Returns
+ * whether the accesses go to a daemon.
+ */
+bool StartShared() {
+  const char* const name = getenv("VCACHE_DAEMON");
+  if (name == NULL) {
+    return false;
+  }
+  try {
+    region = new SharedCaptureRegion(name);
+  } catch (const std::runtime_error& error) {
+    // Before the standard streams are constructed, see Start.
+    fprintf(stderr, "VCache: %s Simulating in process.\n", error.what());
+    return false;
+  }
+  pthread_key_create(&exit_key, DetachRing);
+  return true;
+}
+
+int GetProgramBias(struct dl_phdr_info* info, size_t size, void* bias) {
+  // The program comes first.
+  *(uint64_t*) bias = info->dlpi_addr;
+  return 1;
+}
+
+/**
+ * Adds the global variables of the program to the data objects.
+ */
+void LoadGlobals() {
+  uint64_t bias = 0;
+  dl_iterate_phdr(GetProgramBias, &bias);
+  Symbolizer symbolizer;
+  try {
+    symbolizer.LoadElf("/proc/self/exe", bias);
+  } catch (const std::runtime_error& error) {
+    fprintf(stderr, "VCache: %s\n", error.what());
+  }
+  for (size_t i = 0; i < symbolizer.data_symbols.size(); i++) {
+    const DataSymbol& symbol = symbolizer.data_symbols[i];
+    cache->AddGlobal(symbol.address, symbol.size_B, symbol.name);
+  }
+}
+
+void Start() {
+  if (!__sync_bool_compare_and_swap(&state, STATE_STOPPED, STATE_STARTING)) {
+    return;
+  }
+  pthread_atfork(NULL, NULL, ForkChild);
+  if (StartShared()) {
+    __atomic_store_n(&state, STATE_CAPTURING, __ATOMIC_RELEASE);
+    return;
+  }
+  std::vector<uint64_t> capacities_B;
+  std::vector<uint16_t> associativities;
+  const char* levels = getenv("VCACHE_CACHES");
+  if (levels == NULL) {
+    levels = "32768:8,262144:8,8388608:16";
+  }
+  try {
+    ConcurrentMultilevelCache::ParseLevels(levels, capacities_B,
+        associativities);
+  } catch (const std::invalid_argument& error) {
+    // The program runs on without capturing. This may run before the
+    // standard streams are constructed.
+    fprintf(stderr, "VCache: %s\n", error.what());
+    state = STATE_FINISHED;
+    return;
+  }
+  const uint16_t line_size_B = GetEnv("VCACHE_LINE", DEFAULT_LINE_SIZE);
+  n_cores = GetEnv("VCACHE_CORES", 1);
+  n_threads_max = GetEnv("VCACHE_THREADS", 64);
+  output_file = getenv("VCACHE_OUTPUT");
+  if (output_file == NULL) {
+    output_file = "vcache.out";
+  }
+
+  cache = new ConcurrentMultilevelCache(n_cores, capacities_B,
+      associativities, line_size_B);
+  objects = GetEnv("VCACHE_OBJECTS", 0) != 0;
+  if (objects) {
+    cache->EnableDataObjects();
+    LoadGlobals();
+  }
+  const char* const sampling = getenv("VCACHE_SAMPLING");
+  const bool time = sampling != NULL && std::string(sampling) == "time";
+  const bool none = sampling != NULL && std::string(sampling) == "none";
+  pipeline = new CapturePipeline(*cache, n_threads_max,
+      GetEnv("VCACHE_SIMULATORS", 1), DEFAULT_RING_CAPACITY,
+      DEFAULT_RING_BATCH, time ? SAMPLING_TIME : SAMPLING_SETS,
+      none ? 1 : GetEnv("VCACHE_MAX_PERIOD", DEFAULT_MAX_SAMPLE_PERIOD));
+  pthread_key_create(&exit_key, FlushRing);
+  pipeline->Start();
+  __atomic_store_n(&state, STATE_CAPTURING, __ATOMIC_RELEASE);
+}
+
+/**
+ * Gives the calling thread a ring. Returns NULL if none is left.
+ */
+CaptureRing* Register() {
+  if (refused) {
+    return NULL;
+  }
+  const uint32_t id = __sync_fetch_and_add(&n_threads, 1);
+  if (id >= n_threads_max) {
+    refused = true;
+    return NULL;
+  }
+  thread_id = id;
+  ring = &pipeline->GetRing(id);
+  pthread_setspecific(exit_key, ring);
+  return ring;
+}
+
+/**
+ * Gives the calling thread a daemon slot. Returns NULL if none is free.
+ */
+SharedRing* RegisterShared() {
+  if (refused) {
+    return NULL;
+  }
+  shared_ring = region->Attach(getpid(), syscall(SYS_gettid));
+  if (shared_ring == NULL) {
+    refused = true;
+    return NULL;
+  }
+  pthread_setspecific(exit_key, shared_ring);
+  return shared_ring;
+}
+
+/**
+ * Sends an access to the daemon, whole: it translates the address.
+ */
+void CaptureShared(const void* const address, size_t size,
+    const AccessType type) {
+  SharedRing* capture_ring = shared_ring;
+  if (__builtin_expect(capture_ring == NULL, 0)) {
+    capture_ring = RegisterShared();
+    if (capture_ring == NULL) {
+      return;
+    }
+  }
+  SharedRecord record;
+  record.address = (uintptr_t) address;
+  record.type = type;
+  record.hints = HINT_NONE;
+  while (size > 0) {
+    record.size = size < MAX_RECORD_SIZE ? size : MAX_RECORD_SIZE;
+    capture_ring->Push(record);
+    record.address += record.size;
+    size -= record.size;
+  }
+}
+
+/**
+ * Warns, once, about an address that will alias with those of other upper
+ * bits.
+ */
+inline void CheckHighBits(const void* const address) {
+  if (!Address::HasHighBits((uintptr_t) address, high_bits)
+      && __sync_bool_compare_and_swap(&warned_high_bits, 0, 1)) {
+    fprintf(stderr, "VCache: the addresses differ above their low 32 bits, "
+        "the only ones simulated: some alias.\n");
+  }
+}
+
+inline void Capture(const void* const address, size_t size,
+    const AccessType type) {
+  if (__builtin_expect(state != STATE_CAPTURING, 0)) {
+    return;
+  }
+  if (region != NULL) {
+    CaptureShared(address, size, type);
+    return;
+  }
+  CaptureRing* capture_ring = ring;
+  if (__builtin_expect(capture_ring == NULL, 0)) {
+    capture_ring = Register();
+    if (capture_ring == NULL) {
+      return;
+    }
+  }
+  // VCache addresses are 32 bits wide.
+  CheckHighBits(address);
+  ADDRESS record_address = (ADDRESS) (uintptr_t) address;
+  while (size > 0) {
+    const size_t record_size =
+        size < MAX_RECORD_SIZE ? size : MAX_RECORD_SIZE;
+    capture_ring->Push(AccessRecord(record_address, record_size, type,
+        HINT_NONE, thread_id));
+    record_address += record_size;
+    size -= record_size;
+  }
+}
+
+/**
+ * Appends an allocation or a free, whole. The daemon does not take them.
+ */
+void CaptureEvent(const void* const address, const size_t size,
+    const AccessType type, const void* const site) {
+  if (state != STATE_CAPTURING || !objects) {
+    return;
+  }
+  CaptureRing* capture_ring = ring;
+  if (capture_ring == NULL) {
+    capture_ring = Register();
+    if (capture_ring == NULL) {
+      return;
+    }
+  }
+  CheckHighBits(address);
+  capture_ring->Push(AccessRecord((ADDRESS) (uintptr_t) address,
+      size < UINT32_MAX ? size : UINT32_MAX, type, HINT_NONE, thread_id, 0,
+      (ADDRESS) (uintptr_t) site));
+}
+
+/**
+ * Writes the statistics, each annotated with the sampling ratio that applied
+ * to it: the fraction of the records captured that were simulated.
+ */
+void WriteReport() {
+  std::ofstream out(output_file);
+  cache->Finalize();
+  const std::vector<LevelCounters> level_counters =
+      cache->SumLevelCounters();
+  const double ratio = pipeline->GetSamplingRatio();
+  out << "Records: " << pipeline->GetRecordCount() << ", Simulated: "
+      << pipeline->GetSimulatedCount() << ", Peak period: "
+      << pipeline->GetPeakPeriod() << ", Threads: "
+      << (n_threads < n_threads_max ? n_threads : n_threads_max)
+      << ", Uncaptured threads: "
+      << (n_threads > n_threads_max ? n_threads - n_threads_max : 0)
+      << std::endl;
+  out << "Hits: " << cache->Sum(&MultilevelCache::hits) << ", Misses: "
+      << cache->Sum(&MultilevelCache::misses) << " (sampling ratio " << ratio
+      << ")" << std::endl;
+  for (size_t i = 0; i < level_counters.size(); i++) {
+    out << "Cache " << i << ": Hits: " << level_counters[i].hits
+        << ", Misses: " << level_counters[i].misses << ", Evictions: "
+        << level_counters[i].GetEvictionCount() << ", Resident: "
+        << level_counters[i].resident_lines << " (sampling ratio " << ratio
+        << ")" << std::endl;
+  }
+  const FootprintHistogram footprints = cache->MergeFootprints();
+  if (footprints.n_lines) {
+    out << footprints;
+  }
+  if (objects) {
+    out << cache->MergeDataObjects();
+  }
+}
+
+__attribute__((constructor)) void Initialize() {
+  Start();
+}
+
+__attribute__((destructor)) void Finalize() {
+  __vcache_finish();
+}
+
+}
+
+extern "C" {
+
+void __vcache_load(const void* address, size_t size) {
+  Capture(address, size, ACCESS_LOAD);
+}
+
+void __vcache_store(const void* address, size_t size) {
+  Capture(address, size, ACCESS_STORE);
+}
+
+void __vcache_allocate(const void* address, size_t size, const void* site) {
+  CaptureEvent(address, size, ACCESS_ALLOC, site);
+}
+
+void __vcache_free(const void* address) {
+  CaptureEvent(address, 0, ACCESS_FREE, NULL);
+}
+
+void __vcache_finish(void) {
+  if (!__sync_bool_compare_and_swap(&state, STATE_CAPTURING,
+      STATE_FINISHED)) {
+    return;
+  }
+  if (region != NULL) {
+    // The daemon reports. Threads that are still running stay attached
+    // until the daemon sees the process exit.
+    if (shared_ring != NULL) {
+      region->Detach(shared_ring);
+      shared_ring = NULL;
+    }
+    return;
+  }
+  if (ring != NULL) {
+    ring->Flush();
+  }
+  // Threads that are still running lose the records they have not
+  // published. The pipeline is not destroyed: they may still push.
+  pipeline->Stop();
+  WriteReport();
+}
+
+/*
+ * ThreadSanitizer instrumentation: compile with -fsanitize=thread and link
+ * with this runtime instead of the ThreadSanitizer runtime.
+ */
+
+void __tsan_init(void) {
+  Start();
+}
+
+void __tsan_func_entry(void* call_pc) {
+}
+
+void __tsan_func_exit(void) {
+}
+
+void __tsan_vptr_update(void** vptr, void* new_value) {
+}
+
+void __tsan_vptr_read(void** vptr) {
+}
+
+void __tsan_read_range(void* address, unsigned long size) {
+  Capture(address, size, ACCESS_LOAD);
+}
+
+void __tsan_write_range(void* address, unsigned long size) {
+  Capture(address, size, ACCESS_STORE);
+}
+
+#define VCACHE_TSAN_ACCESS(size)                                               \
+  void __tsan_read##size(void* address) {                                      \
+    Capture(address, size, ACCESS_LOAD);                                       \
+  }                                                                            \
+  void __tsan_write##size(void* address) {                                     \
+    Capture(address, size, ACCESS_STORE);                                      \
+  }                                                                            \
+  void __tsan_unaligned_read##size(void* address) {                            \
+    Capture(address, size, ACCESS_LOAD);                                       \
+  }                                                                            \
+  void __tsan_unaligned_write##size(void* address) {                           \
+    Capture(address, size, ACCESS_STORE);                                      \
+  }                                                                            \
+  void __tsan_volatile_read##size(void* address) {                             \
+    Capture(address, size, ACCESS_LOAD);                                       \
+  }                                                                            \
+  void __tsan_volatile_write##size(void* address) {                            \
+    Capture(address, size, ACCESS_STORE);                                      \
+  }
+
+VCACHE_TSAN_ACCESS(1)
+VCACHE_TSAN_ACCESS(2)
+VCACHE_TSAN_ACCESS(4)
+VCACHE_TSAN_ACCESS(8)
+VCACHE_TSAN_ACCESS(16)
+
+/*
+ * SanitizerCoverage load and store tracing: compile with
+ * -fsanitize-coverage=trace-loads,trace-stores.
+ */
+
+#define VCACHE_SANCOV_ACCESS(size)                                             \
+  void __sanitizer_cov_load##size(void* address) {                             \
+    Capture(address, size, ACCESS_LOAD);                                       \
+  }                                                                            \
+  void __sanitizer_cov_store##size(void* address) {                            \
+    Capture(address, size, ACCESS_STORE);                                      \
+  }
+
+VCACHE_SANCOV_ACCESS(1)
+VCACHE_SANCOV_ACCESS(2)
+VCACHE_SANCOV_ACCESS(4)
+VCACHE_SANCOV_ACCESS(8)
+VCACHE_SANCOV_ACCESS(16)
+
+}
@@ -0,0 +1,64 @@
+/*
+ * VCacheRuntime.h
+ *
+ *  Created on: Aug 29, 2016
+ *      Author: vance
+ */
+
+#ifndef VCACHERUNTIME_H_
+#define VCACHERUNTIME_H_
+
+#include <stddef.h>
+
+/**
+ * Capture hooks of the VCache runtime, for programs that call them directly
+ * or through compiler instrumentation (see the README). Each thread appends
+ * its accesses to its own CaptureRing and simulator threads feed them to the
+ * hierarchy, so a hook costs little more than a store.
+ *
+ * The runtime is configured from the environment when it starts:
+ *   VCACHE_CACHES      capacity:associativity of each level, from the L1,
+ *                      eg. "32768:8,262144:8,8388608:16" (the default).
+ *   VCACHE_LINE        line size in bytes, default 64.
+ *   VCACHE_CORES       cores; thread i runs on core i modulo cores. Default 1.
+ *   VCACHE_THREADS     the most threads that capture, default 64. Accesses of
+ *                      later threads are not captured.
+ *   VCACHE_SIMULATORS  simulator threads, default 1.
+ *   VCACHE_OUTPUT      the report file, default vcache.out.
+ *   VCACHE_SAMPLING    how simulators that fall behind sample: "sets" (the
+ *                      default), "time" or "none". See BackpressureSampler.
+ *   VCACHE_MAX_PERIOD  the longest sampling period, default 16.
+ *   VCACHE_OBJECTS     1 to charge misses and unused bytes to the global
+ *                      variables of the program and to the allocation sites
+ *                      reported with __vcache_allocate. Default 0.
+ *   VCACHE_DAEMON      the region of a running vcached, eg. "/vcache". The
+ *                      accesses go to the daemon, which simulates and
+ *                      reports them, and the variables above are ignored.
+ */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void __vcache_load(const void* address, size_t size);
+void __vcache_store(const void* address, size_t size);
+
+/**
+ * Report that size bytes at address were allocated by the call at site, eg.
+ * __builtin_return_address(0) in a malloc wrapper, and that the allocation
+ * at address was freed. Ignored unless VCACHE_OBJECTS is set, and not sent
+ * to a daemon.
+ */
+void __vcache_allocate(const void* address, size_t size, const void* site);
+void __vcache_free(const void* address);
+
+/**
+ * Stops capturing, waits for the simulators and writes the report. Called
+ * at exit; later accesses are not captured.
+ */
+void __vcache_finish(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* VCACHERUNTIME_H_ */
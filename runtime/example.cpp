@@ -0,0 +1,44 @@
+/*
+ * example.cpp
+ *
+ *  Created on: Aug 29, 2016
+ *      Author: vance
+ */
+
+/*
+ * Two threads that each fill a private 1MB array and sum it twice into
+ * neighbouring slots of a shared array.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+
+#define N_ELEMENTS (1 << 18)
+
+static int arrays[2][N_ELEMENTS];
+static long sums[2];
+
+static void* Sum(void* argument) {
+  const long thread = (long) argument;
+  for (int i = 0; i < N_ELEMENTS; i++) {
+    arrays[thread][i] = i;
+  }
+  for (int pass = 0; pass < 2; pass++) {
+    for (int i = 0; i < N_ELEMENTS; i++) {
+      sums[thread] += arrays[thread][i];
+    }
+  }
+  return NULL;
+}
+
+int main() {
+  pthread_t threads[2];
+  for (long i = 0; i < 2; i++) {
+    pthread_create(&threads[i], NULL, Sum, (void*) i);
+  }
+  for (int i = 0; i < 2; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  printf("%ld\n", sums[0] + sums[1]);
+  return 0;
+}
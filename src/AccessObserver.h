@@ -0,0 +1,31 @@
+/*
+ * AccessObserver.h
+ *
+ *  Created on: Aug 16, 2016
+ *      Author: vance
+ */
+
+#ifndef ACCESSOBSERVER_H_
+#define ACCESSOBSERVER_H_
+
+#include "AccessRecord.h"
+#include "Address.h"
+
+/**
+ * An analysis that is told of every access a MultilevelCache simulates.
+ */
+class AccessObserver {
+public:
+  virtual ~AccessObserver() {
+  }
+
+  /**
+   * Called once for every line an access touches, after the hierarchy has
+   * served it. The address and size of access are those of the part of the
+   * access that falls in the line starting at line_address.
+   */
+  virtual void Observe(const AccessRecord& access,
+      const ADDRESS line_address) = 0;
+};
+
+#endif /* ACCESSOBSERVER_H_ */
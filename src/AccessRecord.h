@@ -0,0 +1,82 @@
+/*
+ * AccessRecord.h
+ *
+ *  Created on: Aug 2, 2016
+ *      Author: vance
+ */
+
+#ifndef ACCESSRECORD_H_
+#define ACCESSRECORD_H_
+
+#include <stdint.h>
+
+#include "Address.h"
+
+/**
+ * The kind of memory operation that caused an access.
+ */
+enum AccessType {
+  ACCESS_LOAD,
+  ACCESS_STORE,
+  // Read-modify-write: allocates like a load and modifies like a store.
+  ACCESS_RMW,
+  // Instruction fetch: a load through the L1 instruction cache.
+  ACCESS_IFETCH,
+  // Not accesses but events of the trace, for DataObjectMap. An allocation
+  // of size bytes at address by the call at pc, and the free of the
+  // allocation at address.
+  ACCESS_ALLOC,
+  ACCESS_FREE
+};
+
+/**
+ * Hints that change where an access is allocated. Combine with bitwise or.
+ */
+enum AccessHint {
+  HINT_NONE = 0,
+  // Non-temporal: a load is inserted at the LRU position of every level it
+  // fills; a store bypasses the hierarchy through the write-combining
+  // buffers.
+  HINT_NON_TEMPORAL = 1 << 0,
+  // Do not fill the line into the L1.
+  HINT_BYPASS_L1 = 1 << 1,
+  // Do not fill the line into the L2. Implies HINT_BYPASS_L1 to preserve
+  // inclusion.
+  HINT_BYPASS_L2 = 1 << 2,
+  // Insert the line at the LRU position of every level it fills.
+  HINT_INSERT_LRU = 1 << 3
+};
+
+/**
+ * A single memory access as recorded by a trace front-end.
+ */
+struct AccessRecord {
+  // Orders the accesses of different threads, eg. a cycle count.
+  uint64_t timestamp;
+  ADDRESS address;
+  // The address of the instruction that made the access, or 0 if unknown.
+  ADDRESS pc;
+  // Wide enough for the size of an allocation.
+  uint32_t size;
+  // The thread that made the access.
+  uint16_t thread_id;
+  // An AccessType.
+  uint8_t type;
+  // A combination of AccessHints.
+  uint8_t hints;
+
+  AccessRecord() :
+      timestamp(0), address(0), pc(0), size(0), thread_id(0),
+      type(ACCESS_LOAD), hints(HINT_NONE) {
+  }
+
+  AccessRecord(const ADDRESS address, const uint32_t size,
+      const AccessType type = ACCESS_LOAD, const uint8_t hints = HINT_NONE,
+      const uint16_t thread_id = 0, const uint64_t timestamp = 0,
+      const ADDRESS pc = 0) :
+      timestamp(timestamp), address(address), pc(pc), size(size),
+      thread_id(thread_id), type(type), hints(hints) {
+  }
+};
+
+#endif /* ACCESSRECORD_H_ */
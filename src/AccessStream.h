@@ -0,0 +1,53 @@
+/*
+ * AccessStream.h
+ *
+ *  Created on: Aug 9, 2016
+ *      Author: vance
+ */
+
+#ifndef ACCESSSTREAM_H_
+#define ACCESSSTREAM_H_
+
+#include <stddef.h>
+#include <vector>
+
+#include "AccessRecord.h"
+
+/**
+ * A source of AccessRecords, eg. the trace of one thread.
+ */
+class AccessStream {
+public:
+  virtual ~AccessStream() {
+  }
+
+  /**
+   * Stores the next record of the stream in record. Returns false iff the
+   * stream is exhausted.
+   */
+  virtual bool Next(AccessRecord& record) = 0;
+};
+
+/**
+ * An AccessStream over records held in memory.
+ */
+class VectorAccessStream: public AccessStream {
+private:
+  const std::vector<AccessRecord> records;
+  size_t position;
+
+public:
+  VectorAccessStream(const std::vector<AccessRecord>& records) :
+      records(records), position(0) {
+  }
+
+  bool Next(AccessRecord& record) {
+    if (position == records.size()) {
+      return false;
+    }
+    record = records[position++];
+    return true;
+  }
+};
+
+#endif /* ACCESSSTREAM_H_ */
@@ -17,6 +17,8 @@ typedef uint32_t SET_INDEX;
 typedef uint32_t LINE_OFFSET;
 
 #define BITS_IN_BYTE 8
+#define CACHE_LINE_B 64   // of the host, to keep what threads write apart
+#define NO_HIGH_BITS (1ull << 32)   // before an address was checked
 
 class Address {
 public:
@@ -60,6 +62,22 @@ public:
   static const uint64_t GetAddressMask() {
     return (((uint64_t) 1) << (sizeof(ADDRESS) * BITS_IN_BYTE)) - 1;
   }
+
+  /**
+   * Returns whether address, of the 64-bit host, has the bits above an
+   * ADDRESS of the first address checked against high_bits, which starts
+   * NO_HIGH_BITS. VCache drops those bits, so addresses that differ in them
+   * alias. Safe to call from several threads.
+   */
+  static bool HasHighBits(const uint64_t address,
+      volatile uint64_t& high_bits) {
+    const uint64_t high = address >> (sizeof(ADDRESS) * BITS_IN_BYTE);
+    if (__builtin_expect(high == high_bits, 1)) {
+      return true;
+    }
+    __sync_bool_compare_and_swap(&high_bits, NO_HIGH_BITS, high);
+    return high == high_bits;
+  }
 };
 
 #endif /* ADDRESS_H_ */
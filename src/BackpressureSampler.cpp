@@ -0,0 +1,33 @@
+/*
+ * BackpressureSampler.cpp
+ *
+ *  Created on: Sep 6, 2016
+ *      Author: vance
+ */
+
+#include "BackpressureSampler.h"
+
+#include <stdexcept>
+
+BackpressureSampler::BackpressureSampler(const uint64_t capacity,
+    const uint16_t line_size_B, const SamplingMode mode,
+    const uint32_t max_period, const uint32_t n_shards) :
+    mode(mode), high_water(capacity / 2), low_water(capacity / 8),
+        max_period(max_period),
+        n_bits_skipped(
+            (line_size_B ? __builtin_ctz(line_size_B) : 0)
+                + (n_shards ? __builtin_ctz(n_shards) : 0)), period(1),
+        n_records(0), n_simulated(0), peak_period(1) {
+  if (max_period == 0 || (max_period & (max_period - 1))) {
+    throw std::invalid_argument("The sample period must be a power of two.");
+  }
+  if (line_size_B == 0 || (line_size_B & (line_size_B - 1))) {
+    throw std::invalid_argument("Line size must be a power of two.");
+  }
+  if (n_shards == 0 || (n_shards & (n_shards - 1))) {
+    throw std::invalid_argument("The shard count must be a power of two.");
+  }
+}
+
+BackpressureSampler::~BackpressureSampler() {
+}
@@ -0,0 +1,120 @@
+/*
+ * BackpressureSampler.h
+ *
+ *  Created on: Sep 6, 2016
+ *      Author: vance
+ */
+
+#ifndef BACKPRESSURESAMPLER_H_
+#define BACKPRESSURESAMPLER_H_
+
+#include <stdint.h>
+
+#include "Address.h"
+
+#define DEFAULT_MAX_SAMPLE_PERIOD 16   // at most one in 16 simulated
+#define SAMPLE_WINDOW 1024   // records per window of time sampling
+
+/**
+ * How a simulator that falls behind thins the records of a ring.
+ */
+enum SamplingMode {
+  // Simulate the lines of one set in every period: the sampled sets of every
+  // cache with at least n_shards * period sets see all their accesses, so
+  // their statistics are exact and scale by the period to the whole cache.
+  // The sets are chosen by the line index bits above those of the shards,
+  // so every shard of a ConcurrentMultilevelCache stays busy.
+  SAMPLING_SETS,
+  // Simulate one window of SAMPLE_WINDOW records in every period.
+  SAMPLING_TIME
+};
+
+/**
+ * Decides which records of a ring a simulator simulates, from the depth of
+ * the ring's queue.
+ *
+ * While the ring is more than half full the simulator is behind: each
+ * update doubles the sampling period, up to max_period. Once the ring is
+ * less than an eighth full it has caught up: each update halves the period,
+ * back to 1, ie. full detail. Periods are powers of two, so the sets sampled
+ * at a longer period are a subset of those at a shorter one.
+ *
+ * The records seen and simulated are counted, so every statistic of the
+ * simulation can be annotated with the ratio that applied to it.
+ */
+class BackpressureSampler {
+private:
+  const SamplingMode mode;
+  const uint64_t high_water;
+  const uint64_t low_water;
+  const uint32_t max_period;
+  // The address bits below those that select the sampled sets.
+  const uint8_t n_bits_skipped;
+  uint32_t period;
+
+public:
+  uint64_t n_records;
+  uint64_t n_simulated;
+  // The longest period that applied.
+  uint32_t peak_period;
+
+public:
+  /**
+   * Constructs a BackpressureSampler at full detail.
+   *
+   * @param capacity the capacity of the ring, in records.
+   * @param line_size_B the line size of the simulated hierarchy.
+   * @param mode how to sample when behind.
+   * @param max_period the longest sampling period, a power of two. 1 never
+   *        samples.
+   * @param n_shards the shards of the simulated ConcurrentMultilevelCache,
+   *        a power of two.
+   */
+  BackpressureSampler(const uint64_t capacity, const uint16_t line_size_B,
+      const SamplingMode mode = SAMPLING_SETS, const uint32_t max_period =
+          DEFAULT_MAX_SAMPLE_PERIOD, const uint32_t n_shards = 1);
+  virtual ~BackpressureSampler();
+
+  /**
+   * Adapts the period to backlog, the number of records waiting in the
+   * ring. Called before each batch is popped.
+   */
+  void Update(const uint64_t backlog) {
+    if (backlog > high_water && period < max_period) {
+      period <<= 1;
+      if (period > peak_period) {
+        peak_period = period;
+      }
+    } else if (backlog < low_water && period > 1) {
+      period >>= 1;
+    }
+  }
+
+  /**
+   * Counts a record at address and returns whether to simulate it.
+   */
+  bool Sample(const ADDRESS address) {
+    bool simulate;
+    if (mode == SAMPLING_SETS) {
+      simulate = ((address >> n_bits_skipped) & (period - 1)) == 0;
+    } else {
+      simulate = ((n_records / SAMPLE_WINDOW) & (period - 1)) == 0;
+    }
+    n_records++;
+    n_simulated += simulate;
+    return simulate;
+  }
+
+  uint32_t GetPeriod() const {
+    return period;
+  }
+
+  /**
+   * Returns the fraction of the records that were simulated.
+   */
+  double GetRatio() const {
+    return n_records ? (double) n_simulated / n_records : 1.0;
+  }
+};
+
+#endif /* BACKPRESSURESAMPLER_H_ */
@@ -30,14 +30,14 @@ Cache::~Cache() {
   }
 }
 
-bool Cache::Insert(CacheLine& line) {
+bool Cache::Insert(CacheLine& line, const bool lru) {
   SET_INDEX set_index = GetSetIndex(line.address);
   CacheSet* set = sets.at(set_index);
   if (set == NULL) {
     sets[set_index] = new CacheSet(this);
     set = sets[set_index];
   }
-  return set->Insert(line);
+  return set->Insert(line, lru);
 }
 
 CacheLine* const Cache::EvictLRU(const ADDRESS address) {
@@ -49,6 +49,25 @@ CacheLine* const Cache::EvictLRU(const ADDRESS address) {
   }
 }
 
+CacheLine* const Cache::EvictLRU(const ADDRESS address,
+    const LEVEL_MASK levels, const uint32_t max_queries) {
+  CacheSet* set = sets.at(GetSetIndex(address));
+  if (set != NULL) {
+    return set->EvictLRU(levels, max_queries);
+  } else {
+    return NULL;
+  }
+}
+
+CacheLine* const Cache::GetLRU(const ADDRESS address) const {
+  CacheSet* set = sets.at(GetSetIndex(address));
+  if (set != NULL) {
+    return set->GetLRU();
+  } else {
+    return NULL;
+  }
+}
+
 bool Cache::Contains(const ADDRESS address) const {
   SET_INDEX set_index = GetSetIndex(address);
   CacheSet* set = sets.at(set_index);
@@ -78,6 +97,15 @@ void Cache::RemoveLine(const ADDRESS address) {
   }
 }
 
+void Cache::Drain(std::vector<CacheLine*>& lines) {
+  for (std::vector<CacheSet*>::iterator cacheSet = sets.begin();
+      cacheSet != sets.end(); cacheSet++) {
+    if (*cacheSet != NULL) {
+      (*cacheSet)->Drain(lines);
+    }
+  }
+}
+
 const SET_INDEX Cache::GetSetIndex(const ADDRESS address) const {
   return ((address << n_bits_tag) & address_mask)
       >> (n_bits_tag + n_bits_offset);
@@ -58,8 +58,9 @@ public:
    * Returns true iff the line was successfully inserted into the cache.
    * A failure occurs when there is no space available in the cache. To
    * handle failures, call Evict(line.address) to make space for the line.
+   * If lru is true, the line is inserted at the LRU position of its set.
    */
-  bool Insert(CacheLine& line);
+  bool Insert(CacheLine& line, const bool lru = false);
 
   /**
    * Evicts the least recently used line mapped to by address.
@@ -68,6 +69,21 @@ public:
    */
   CacheLine* const EvictLRU(const ADDRESS address);
 
+  /**
+   * Evicts the least recently used line mapped to by address that is not
+   * held by any level in levels, examining at most max_queries lines.
+   * See CacheSet::EvictLRU(levels, max_queries).
+   * Examines only the SET portion of the address.
+   */
+  CacheLine* const EvictLRU(const ADDRESS address, const LEVEL_MASK levels,
+      const uint32_t max_queries);
+
+  /**
+   * Returns the line that EvictLRU(address) would evict, without evicting it.
+   * Examines only the SET portion of the address.
+   */
+  CacheLine* const GetLRU(const ADDRESS address) const;
+
   /**
    * Returns true iff the cache contains a line matching address.
    * Examines the SET and TAG portions of the address.
@@ -87,6 +103,12 @@ public:
    */
   void RemoveLine(const ADDRESS address);
 
+  /**
+   * Removes every line from the cache and appends them to lines, set by set
+   * in the order of the set indexes.
+   */
+  void Drain(std::vector<CacheLine*>& lines);
+
   /**
    * Given an address, returns the tag portion of the address.
    */
@@ -8,12 +8,18 @@
 #include "CacheLine.h"
 
 CacheLine::CacheLine(const uint8_t line_size, const ADDRESS address) :
+    levels(0), flags(0), prefetch_cache(0), first_offset(0), fill_pc(0),
+    sharers(0),
+    coherence_victims(0),
+    dirty_bytes(NULL), level_accessed_words(NULL), n_accessed_levels(0),
     address(address) {
   accessed_bytes = new boost::dynamic_bitset<>(line_size, false);
 }
 
 CacheLine::~CacheLine() {
   delete accessed_bytes;
+  delete dirty_bytes;
+  delete[] level_accessed_words;
 }
 
 void CacheLine::Access(const LINE_OFFSET address, const uint8_t size) {
@@ -24,7 +30,102 @@ const boost::dynamic_bitset<>& CacheLine::getAccessedBytes() const {
   return *accessed_bytes;
 }
 
+void CacheLine::AccessLevels(const LEVEL_MASK levels, const ADDRESS address,
+    const uint8_t size) {
+  if (levels == 0 || size == 0) {
+    return;
+  }
+  const size_t n_words = GetWordCount();
+  const uint8_t n_levels = MAX_LEVELS - __builtin_clzll(levels);
+  if (n_accessed_levels < n_levels) {
+    uint64_t* const words = new uint64_t[n_levels * n_words]();
+    for (size_t i = 0; i < n_accessed_levels * n_words; i++) {
+      words[i] = level_accessed_words[i];
+    }
+    delete[] level_accessed_words;
+    level_accessed_words = words;
+    n_accessed_levels = n_levels;
+  }
+
+  const uint32_t first = address - this->address;
+  const uint32_t last = first + size - 1;
+  for (size_t word = first / 64; word <= last / 64; word++) {
+    // The bits of the access that fall in this word.
+    const uint32_t low = word == first / 64 ? first % 64 : 0;
+    const uint32_t high = word == last / 64 ? last % 64 : 63;
+    const uint64_t mask = (~(uint64_t) 0 >> (63 - high + low)) << low;
+    LEVEL_MASK level_mask = levels;
+    while (level_mask) {
+      level_accessed_words[__builtin_ctzll(level_mask) * n_words + word] |=
+          mask;
+      level_mask &= level_mask - 1;
+    }
+  }
+}
+
+size_t CacheLine::ClearLevelAccesses(const uint8_t level) {
+  if (level >= n_accessed_levels) {
+    return 0;
+  }
+  const size_t n_words = GetWordCount();
+  uint64_t* const words = &level_accessed_words[level * n_words];
+  size_t n_accessed = 0;
+  for (size_t i = 0; i < n_words; i++) {
+    n_accessed += __builtin_popcountll(words[i]);
+    words[i] = 0;
+  }
+  return n_accessed;
+}
+
+void CacheLine::Write(const uint8_t level, const ADDRESS address,
+    const uint8_t size) {
+  if (dirty_bytes == NULL) {
+    dirty_bytes = new std::vector<boost::dynamic_bitset<> >();
+  }
+  if (dirty_bytes->size() <= level) {
+    dirty_bytes->resize(level + 1,
+        boost::dynamic_bitset<>(accessed_bytes->size(), false));
+  }
+  boost::dynamic_bitset<>& dirty = (*dirty_bytes)[level];
+  for (uint32_t i = address - this->address; i < address - this->address + size;
+      i++) {
+    dirty[i] = true;
+  }
+}
+
+size_t CacheLine::CountDirtyBytes(const uint8_t level) const {
+  if (dirty_bytes == NULL || dirty_bytes->size() <= level) {
+    return 0;
+  }
+  return (*dirty_bytes)[level].count();
+}
+
+size_t CacheLine::WriteBack(const uint8_t level, const uint8_t lower_level) {
+  const size_t n_dirty = CountDirtyBytes(level);
+  if (n_dirty) {
+    if (dirty_bytes->size() <= lower_level) {
+      dirty_bytes->resize(lower_level + 1,
+          boost::dynamic_bitset<>(accessed_bytes->size(), false));
+    }
+    (*dirty_bytes)[lower_level] |= (*dirty_bytes)[level];
+    (*dirty_bytes)[level].reset();
+  }
+  return n_dirty;
+}
+
+size_t CacheLine::Clean(const uint8_t level) {
+  const size_t n_dirty = CountDirtyBytes(level);
+  if (n_dirty) {
+    (*dirty_bytes)[level].reset();
+  }
+  return n_dirty;
+}
+
 void CacheLine::AccessBytes(const ADDRESS address, const uint8_t size) {
+  if (!HasFlag(LINE_FLAG_ACCESSED) && size) {
+    first_offset = address - this->address;
+    SetFlag(LINE_FLAG_ACCESSED);
+  }
   for (uint32_t i = address - this->address; i < address - this->address + size;
       i++) {
     (*accessed_bytes)[i] = true;
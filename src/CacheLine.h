@@ -10,18 +10,90 @@
 
 #include <boost/dynamic_bitset.hpp>
 #include <iostream>
+#include <vector>
 
 #include "Address.h"
 
+// Bit i of a LEVEL_MASK is set iff cache level i holds the line. In a
+// hierarchy with split or private caches, i is the index of the cache.
+typedef uint64_t LEVEL_MASK;
+
+#define MAX_LEVELS (sizeof(LEVEL_MASK) * BITS_IN_BYTE)
+
+// Bit i of a CORE_MASK is set iff core i is concerned, eg. core i's private
+// caches hold the line.
+typedef uint64_t CORE_MASK;
+
+enum LineFlag {
+  // The line was invalidated from the upper levels by early core invalidation.
+  LINE_FLAG_EARLY_INVALIDATED = 1 << 0,
+  // The only sharer of the line holds it in the exclusive or modified state.
+  LINE_FLAG_EXCLUSIVE = 1 << 1,
+  // The only sharer of the line has modified it.
+  LINE_FLAG_MODIFIED = 1 << 2,
+  // A prefetcher filled the line into a cache, and no demand access has used
+  // it since.
+  LINE_FLAG_PREFETCHED = 1 << 3,
+  // The line entered the hierarchy through a prefetch rather than a demand
+  // miss.
+  LINE_FLAG_PREFETCH_FILLED = 1 << 4,
+  // An access has touched a byte of the line.
+  LINE_FLAG_ACCESSED = 1 << 5
+};
+
+/**
+ * The MESI state of a core's private copy of a line.
+ */
+enum CoherenceState {
+  COHERENCE_INVALID,
+  COHERENCE_SHARED,
+  COHERENCE_EXCLUSIVE,
+  COHERENCE_MODIFIED
+};
+
 class CacheLine {
 private:
   // A vector<bool> is a bit vector and will use accessed_bytes bits of storage.
   boost::dynamic_bitset<> *accessed_bytes;
+  // The cache levels that currently hold this line.
+  LEVEL_MASK levels;
+  // A combination of LineFlags.
+  uint8_t flags;
+  // The cache the line was last prefetched into.
+  uint8_t prefetch_cache;
+  // The offset of the first byte accessed in the line, once
+  // LINE_FLAG_ACCESSED is set.
+  uint8_t first_offset;
+  // The instruction whose miss brought the line into the hierarchy, or 0.
+  ADDRESS fill_pc;
+  // The directory entry of the line: the cores whose private caches hold it.
+  // Together with LINE_FLAG_EXCLUSIVE and LINE_FLAG_MODIFIED this gives the
+  // MESI state of every core's copy.
+  CORE_MASK sharers;
+  // The cores whose copy was invalidated by another core's store and that
+  // have not missed on the line since.
+  CORE_MASK coherence_victims;
+  // Entry i holds the bytes modified in level i's copy of the line. Allocated
+  // on the first write so clean lines pay only for the pointer.
+  std::vector<boost::dynamic_bitset<> > *dirty_bytes;
+  // The bytes accessed since each level last filled the line: bit j of word
+  // i * GetWordCount() + j / 64 is set iff byte j was accessed in level i's
+  // copy. Allocated on the first access for the levels that held the line,
+  // as a single block since it is updated on every access.
+  uint64_t *level_accessed_words;
+  uint8_t n_accessed_levels;
 
 public:
   const ADDRESS address;
 
 private:
+  /**
+   * Returns the number of 64-bit words that hold a bit per byte of the line.
+   */
+  size_t GetWordCount() const {
+    return (accessed_bytes->size() + 63) / 64;
+  }
+
   /**
    * Marks bytes as accessed in the accessed_bytes vector.
    *
@@ -55,6 +127,173 @@ public:
    */
   const boost::dynamic_bitset<>& getAccessedBytes() const;
 
+  /**
+   * Returns the offset in the line at which the first access started, or 0
+   * if the line was not accessed.
+   */
+  uint8_t GetFirstOffset() const {
+    return first_offset;
+  }
+
+  /**
+   * Returns the instruction whose miss brought the line into the hierarchy,
+   * or 0 if unknown.
+   */
+  ADDRESS GetFillPc() const {
+    return fill_pc;
+  }
+
+  void SetFillPc(const ADDRESS pc) {
+    fill_pc = pc;
+  }
+
+  /**
+   * Marks size bytes starting at address as accessed in the copy of the line
+   * of each level in levels.
+   */
+  void AccessLevels(const LEVEL_MASK levels, const ADDRESS address,
+      const uint8_t size);
+
+  /**
+   * Returns the number of bytes accessed in level's copy of the line since
+   * level filled it, and forgets them, eg. as level evicts the line.
+   */
+  size_t ClearLevelAccesses(const uint8_t level);
+
+  /**
+   * Marks size bytes starting at address as modified in level's copy of the
+   * line.
+   */
+  void Write(const uint8_t level, const ADDRESS address, const uint8_t size);
+
+  /**
+   * Returns the number of modified bytes in level's copy of the line.
+   */
+  size_t CountDirtyBytes(const uint8_t level) const;
+
+  /**
+   * Writes level's modified bytes back into lower_level's copy of the line
+   * and cleans level's copy. Returns the number of bytes that were modified.
+   */
+  size_t WriteBack(const uint8_t level, const uint8_t lower_level);
+
+  /**
+   * Cleans level's copy of the line, eg. after writing it back to memory.
+   * Returns the number of bytes that were modified.
+   */
+  size_t Clean(const uint8_t level);
+
+  /**
+   * Returns a mask of the cache levels that currently hold this line.
+   */
+  const LEVEL_MASK GetLevels() const {
+    return levels;
+  }
+
+  /**
+   * Returns true iff cache level holds this line.
+   */
+  bool IsPresent(const uint8_t level) const {
+    return (levels >> level) & 1;
+  }
+
+  /**
+   * Records that cache level holds this line.
+   */
+  void SetPresent(const uint8_t level) {
+    levels |= ((LEVEL_MASK) 1) << level;
+  }
+
+  /**
+   * Records that cache level no longer holds this line.
+   */
+  void ClearPresent(const uint8_t level) {
+    levels &= ~(((LEVEL_MASK) 1) << level);
+  }
+
+  /**
+   * Returns true iff flag is set on this line.
+   */
+  bool HasFlag(const LineFlag flag) const {
+    return flags & flag;
+  }
+
+  void SetFlag(const LineFlag flag) {
+    flags |= flag;
+  }
+
+  void ClearFlag(const LineFlag flag) {
+    flags &= ~flag;
+  }
+
+  /**
+   * Records that a prefetcher filled the line into cache.
+   */
+  void SetPrefetched(const uint8_t cache) {
+    flags |= LINE_FLAG_PREFETCHED;
+    prefetch_cache = cache;
+  }
+
+  /**
+   * Returns the cache the line was last prefetched into.
+   */
+  uint8_t GetPrefetchCache() const {
+    return prefetch_cache;
+  }
+
+  /**
+   * Returns a mask of the cores whose private caches hold this line.
+   */
+  const CORE_MASK GetSharers() const {
+    return sharers;
+  }
+
+  void AddSharer(const uint8_t core) {
+    sharers |= ((CORE_MASK) 1) << core;
+  }
+
+  /**
+   * Records that core's private caches no longer hold this line. The line
+   * loses its owner when its last sharer leaves.
+   */
+  void RemoveSharer(const uint8_t core) {
+    sharers &= ~(((CORE_MASK) 1) << core);
+    if (sharers == 0) {
+      ClearFlag(LINE_FLAG_EXCLUSIVE);
+      ClearFlag(LINE_FLAG_MODIFIED);
+    }
+  }
+
+  /**
+   * Returns the MESI state of core's copy of this line.
+   */
+  CoherenceState GetCoherenceState(const uint8_t core) const {
+    if (!((sharers >> core) & 1)) {
+      return COHERENCE_INVALID;
+    } else if (!HasFlag(LINE_FLAG_EXCLUSIVE)) {
+      return COHERENCE_SHARED;
+    }
+    return HasFlag(LINE_FLAG_MODIFIED) ?
+        COHERENCE_MODIFIED : COHERENCE_EXCLUSIVE;
+  }
+
+  /**
+   * Records that core's copy of this line was invalidated by coherence.
+   */
+  void SetCoherenceVictim(const uint8_t core) {
+    coherence_victims |= ((CORE_MASK) 1) << core;
+  }
+
+  /**
+   * Returns true iff core's copy of this line was invalidated by coherence
+   * since core last missed on it, and forgets the invalidation.
+   */
+  bool ClearCoherenceVictim(const uint8_t core) {
+    const bool victim = (coherence_victims >> core) & 1;
+    coherence_victims &= ~(((CORE_MASK) 1) << core);
+    return victim;
+  }
+
   friend std::ostream& operator<<(std::ostream& stream, const CacheLine& line) {
     stream << "Address: " << std::hex << line.address << std::dec;
     stream << ", Utilization: ";
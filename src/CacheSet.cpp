@@ -18,13 +18,17 @@ CacheSet::CacheSet(const Cache* const cache) :
 CacheSet::~CacheSet() {
 }
 
-bool CacheSet::Insert(CacheLine& line) {
+bool CacheSet::Insert(CacheLine& line, const bool lru) {
   boost::unordered_map<TAG, CacheLine*>::const_iterator it = lines_map.find(
       cache->GetTag(line.address));
   if (it != lines_map.end() && it->second == &line) {
     // Line was already mapped. Move it to front of LRU list.
     lines_list.remove(&line);
-    lines_list.push_front(&line);
+    if (lru) {
+      lines_list.push_back(&line);
+    } else {
+      lines_list.push_front(&line);
+    }
     return true;
   }
   if (lines_list.size() == cache->associativity) {
@@ -33,7 +37,11 @@ bool CacheSet::Insert(CacheLine& line) {
   }
   lines_map.insert(
       std::pair<TAG, CacheLine*>(cache->GetTag(line.address), &line));
-  lines_list.push_front(&line);
+  if (lru) {
+    lines_list.push_back(&line);
+  } else {
+    lines_list.push_front(&line);
+  }
   return true;
 }
 
@@ -49,6 +57,31 @@ CacheLine* const CacheSet::EvictLRU() {
   return line;
 }
 
+CacheLine* const CacheSet::EvictLRU(const LEVEL_MASK levels,
+    const uint32_t max_queries) {
+  if (lines_list.size() != cache->associativity) {
+    return NULL;
+  }
+  for (uint32_t query = 0; query < max_queries && query < lines_list.size();
+      query++) {
+    CacheLine* const line = lines_list.back();
+    if (!(line->GetLevels() & levels)) {
+      break;
+    }
+    // The line is still in use above: promote it instead of evicting it.
+    lines_list.pop_back();
+    lines_list.push_front(line);
+  }
+  return EvictLRU();
+}
+
+CacheLine* const CacheSet::GetLRU() const {
+  if (lines_list.size() == cache->associativity) {
+    return lines_list.back();
+  }
+  return NULL;
+}
+
 bool CacheSet::Contains(const ADDRESS address) const {
   TAG tag = cache->GetTag(address);
   boost::unordered_map<TAG, CacheLine*>::const_iterator it = lines_map.find(
@@ -78,3 +111,8 @@ void CacheSet::RemoveLine(const ADDRESS address) {
   }
 }
 
+void CacheSet::Drain(std::vector<CacheLine*>& lines) {
+  lines.insert(lines.end(), lines_list.begin(), lines_list.end());
+  lines_list.clear();
+  lines_map.clear();
+}
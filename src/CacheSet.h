@@ -34,14 +34,33 @@ public:
    *
    * If the CacheLine is already be mapped in the CacheSet, moves line
    * to the LRU position and returns true.
+   *
+   * If lru is true, the line is placed at the least recently used position
+   * instead, making it the next line to be evicted.
    */
-  bool Insert(CacheLine& line);
+  bool Insert(CacheLine& line, const bool lru = false);
 
   /**
    * Evicts the least recently used line.
    */
   CacheLine* const EvictLRU();
 
+  /**
+   * Evicts the least recently used line that is not held by any level in
+   * levels. At most max_queries lines are examined starting from the LRU
+   * position; each examined line that is held is moved to the MRU position.
+   * If every examined line is held, the line then at the LRU position is
+   * evicted. Returns NULL if the set is not full.
+   */
+  CacheLine* const EvictLRU(const LEVEL_MASK levels,
+      const uint32_t max_queries);
+
+  /**
+   * Returns the line that EvictLRU() would evict without evicting it, or
+   * NULL if the set is not full.
+   */
+  CacheLine* const GetLRU() const;
+
   /**
    * Returns true iff the cache set contains a line for address.
    * Only examines the TAG field of the address.
@@ -60,6 +79,12 @@ public:
    * Only examines the TAG field of the address.
    */
   void RemoveLine(const ADDRESS address);
+
+  /**
+   * Removes every line from the cache set and appends them to lines, from
+   * the MRU to the LRU position.
+   */
+  void Drain(std::vector<CacheLine*>& lines);
 };
 
 #endif /* CACHESET_H_ */
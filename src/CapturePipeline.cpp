@@ -0,0 +1,139 @@
+/*
+ * CapturePipeline.cpp
+ *
+ *  Created on: Aug 23, 2016
+ *      Author: vance
+ */
+
+#include "CapturePipeline.h"
+
+#include <sched.h>
+#include <stdexcept>
+
+CapturePipeline::CapturePipeline(ConcurrentMultilevelCache& cache,
+    const uint32_t n_rings, const uint32_t n_simulators,
+    const uint64_t ring_capacity, const uint32_t batch,
+    const SamplingMode mode, const uint32_t max_period) :
+    cache(cache), stopping(false), running(false) {
+  if (n_simulators == 0) {
+    throw std::invalid_argument("A pipeline needs a simulator.");
+  }
+  for (uint32_t i = 0; i < n_rings; i++) {
+    rings.push_back(new CaptureRing(ring_capacity, batch));
+    samplers.push_back(new BackpressureSampler(ring_capacity,
+        cache.line_size_B, mode, max_period, cache.GetShardCount()));
+  }
+  simulators.resize(n_simulators);
+  for (uint32_t i = 0; i < n_simulators; i++) {
+    simulators[i].pipeline = this;
+    simulators[i].index = i;
+    simulators[i].n_records = 0;
+  }
+}
+
+CapturePipeline::~CapturePipeline() {
+  Stop();
+  for (std::vector<CaptureRing*>::iterator it = rings.begin();
+      it < rings.end(); it++) {
+    delete (*it);
+  }
+  for (std::vector<BackpressureSampler*>::iterator it = samplers.begin();
+      it < samplers.end(); it++) {
+    delete (*it);
+  }
+}
+
+void CapturePipeline::Start() {
+  if (running) {
+    return;
+  }
+  __atomic_store_n(&stopping, false, __ATOMIC_RELEASE);
+  for (size_t i = 0; i < simulators.size(); i++) {
+    if (pthread_create(&simulators[i].thread, NULL, Simulate,
+        &simulators[i])) {
+      throw std::runtime_error("Could not start a simulator thread.");
+    }
+  }
+  running = true;
+}
+
+void CapturePipeline::Stop() {
+  if (!running) {
+    return;
+  }
+  __atomic_store_n(&stopping, true, __ATOMIC_RELEASE);
+  for (size_t i = 0; i < simulators.size(); i++) {
+    pthread_join(simulators[i].thread, NULL);
+  }
+  running = false;
+}
+
+uint64_t CapturePipeline::GetRecordCount() const {
+  uint64_t n_records = 0;
+  for (size_t i = 0; i < simulators.size(); i++) {
+    n_records += simulators[i].n_records;
+  }
+  return n_records;
+}
+
+uint64_t CapturePipeline::GetSimulatedCount() const {
+  uint64_t n_simulated = 0;
+  for (size_t i = 0; i < samplers.size(); i++) {
+    n_simulated += samplers[i]->n_simulated;
+  }
+  return n_simulated;
+}
+
+double CapturePipeline::GetSamplingRatio() const {
+  const uint64_t n_records = GetRecordCount();
+  return n_records ? (double) GetSimulatedCount() / n_records : 1.0;
+}
+
+uint32_t CapturePipeline::GetPeakPeriod() const {
+  uint32_t peak_period = 1;
+  for (size_t i = 0; i < samplers.size(); i++) {
+    if (samplers[i]->peak_period > peak_period) {
+      peak_period = samplers[i]->peak_period;
+    }
+  }
+  return peak_period;
+}
+
+void* CapturePipeline::Simulate(void* argument) {
+  Simulator* const simulator = (Simulator*) argument;
+  CapturePipeline* const pipeline = simulator->pipeline;
+  AccessRecord records[DEFAULT_DRAIN_BATCH];
+  while (true) {
+    // Read the flag before draining: a pass that finds every ring empty
+    // after the flag was set has seen all the records published before it.
+    const bool stopping = __atomic_load_n(&pipeline->stopping,
+        __ATOMIC_ACQUIRE);
+    size_t n_drained = 0;
+    size_t n_events = 0;
+    for (size_t ring = simulator->index; ring < pipeline->rings.size(); ring +=
+        pipeline->simulators.size()) {
+      BackpressureSampler& sampler = *pipeline->samplers[ring];
+      sampler.Update(pipeline->rings[ring]->GetSize());
+      const size_t n = pipeline->rings[ring]->Pop(records, DEFAULT_DRAIN_BATCH);
+      for (size_t i = 0; i < n; i++) {
+        // Allocations and frees are not accesses: they are never sampled
+        // out, and count neither as records nor as simulated.
+        if (records[i].type >= ACCESS_ALLOC) {
+          pipeline->cache.Access(records[i]);
+          n_events++;
+        } else if (sampler.Sample(records[i].address)) {
+          pipeline->cache.Access(records[i]);
+        }
+      }
+      n_drained += n;
+    }
+    simulator->n_records += n_drained - n_events;
+    if (n_drained == 0) {
+      if (stopping) {
+        break;
+      }
+      sched_yield();
+    }
+  }
+  return NULL;
+}
@@ -0,0 +1,115 @@
+/*
+ * CapturePipeline.h
+ *
+ *  Created on: Aug 23, 2016
+ *      Author: vance
+ */
+
+#ifndef CAPTUREPIPELINE_H_
+#define CAPTUREPIPELINE_H_
+
+#include <pthread.h>
+#include <stdint.h>
+#include <vector>
+
+#include "BackpressureSampler.h"
+#include "CaptureRing.h"
+#include "ConcurrentMultilevelCache.h"
+
+#define DEFAULT_DRAIN_BATCH 1024   // records popped at once
+
+/**
+ * Moves the accesses of instrumented threads to simulator threads. Each
+ * instrumented thread pushes its records into its own CaptureRing, and each
+ * simulator thread drains a share of the rings into the cache, so the
+ * application pays only for the push and simulation proceeds in parallel.
+ *
+ * A simulator that falls behind a ring samples it rather than stall the
+ * application, see BackpressureSampler. The statistics of the cache then
+ * cover the simulated records only: scale them by GetSamplingRatio().
+ */
+class CapturePipeline {
+private:
+  struct Simulator {
+    pthread_t thread;
+    CapturePipeline* pipeline;
+    uint32_t index;
+    uint64_t n_records;
+  };
+
+  ConcurrentMultilevelCache& cache;
+  std::vector<CaptureRing*> rings;
+  // One per ring, used by the simulator that drains the ring.
+  std::vector<BackpressureSampler*> samplers;
+  std::vector<Simulator> simulators;
+  bool stopping;
+  bool running;
+
+private:
+  /**
+   * The body of a simulator thread: drains rings index, index + n_simulators
+   * and so on until the pipeline stops and they are empty.
+   */
+  static void* Simulate(void* simulator);
+
+public:
+  /**
+   * Constructs a stopped CapturePipeline.
+   *
+   * @param cache the hierarchy the simulators feed. Not owned.
+   * @param n_rings the number of instrumented threads.
+   * @param n_simulators the number of simulator threads.
+   * @param ring_capacity the capacity of each ring, see CaptureRing.
+   * @param batch the publication batch of each ring, see CaptureRing.
+   * @param mode how to sample a ring the simulators fall behind.
+   * @param max_period the longest sampling period, see BackpressureSampler.
+   *        By default every record is simulated.
+   */
+  CapturePipeline(ConcurrentMultilevelCache& cache, const uint32_t n_rings,
+      const uint32_t n_simulators, const uint64_t ring_capacity =
+          DEFAULT_RING_CAPACITY, const uint32_t batch = DEFAULT_RING_BATCH,
+      const SamplingMode mode = SAMPLING_SETS, const uint32_t max_period = 1);
+  virtual ~CapturePipeline();
+
+  /**
+   * Returns the ring of instrumented thread thread_id.
+   */
+  CaptureRing& GetRing(const uint32_t thread_id) {
+    return *rings.at(thread_id);
+  }
+
+  /**
+   * Starts the simulator threads.
+   */
+  void Start();
+
+  /**
+   * Waits for the simulators to drain every record published so far, then
+   * stops them. Producers must flush their rings first.
+   */
+  void Stop();
+
+  /**
+   * Returns the number of access records drained by stopped simulators,
+   * without the allocations and frees.
+   */
+  uint64_t GetRecordCount() const;
+
+  /**
+   * Returns the number of those records that were simulated.
+   */
+  uint64_t GetSimulatedCount() const;
+
+  /**
+   * Returns the fraction of the records drained that were simulated, the
+   * ratio that applies to every statistic of the cache.
+   */
+  double GetSamplingRatio() const;
+
+  /**
+   * Returns the longest sampling period any ring needed.
+   */
+  uint32_t GetPeakPeriod() const;
+};
+
+#endif /* CAPTUREPIPELINE_H_ */
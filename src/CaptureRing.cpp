@@ -0,0 +1,46 @@
+/*
+ * CaptureRing.cpp
+ *
+ *  Created on: Aug 23, 2016
+ *      Author: vance
+ */
+
+#include "CaptureRing.h"
+
+#include <sched.h>
+#include <stdexcept>
+
+CaptureRing::CaptureRing(const uint64_t capacity, const uint32_t batch) :
+    head(0), tail(0), unpublished_tail(0), cached_head(0),
+    records(new AccessRecord[capacity]), mask(capacity - 1), batch(batch) {
+  if (capacity == 0 || (capacity & (capacity - 1))) {
+    delete[] records;
+    throw std::invalid_argument("Ring capacity must be a power of two.");
+  }
+  if (batch == 0 || batch > capacity) {
+    delete[] records;
+    throw std::invalid_argument("Ring batch must be within the capacity.");
+  }
+}
+
+CaptureRing::~CaptureRing() {
+  delete[] records;
+}
+
+void CaptureRing::Push(const AccessRecord& record) {
+  while (!TryPush(record)) {
+    sched_yield();
+  }
+}
+
+size_t CaptureRing::Pop(AccessRecord* const out, const size_t max) {
+  const uint64_t first = head;
+  const uint64_t available = __atomic_load_n(&tail, __ATOMIC_ACQUIRE) - first;
+  const size_t n = available < max ? available : max;
+  for (size_t i = 0; i < n; i++) {
+    out[i] = records[(first + i) & mask];
+  }
+  // Hands the slots back to the producer only after they were read.
+  __atomic_store_n(&head, first + n, __ATOMIC_RELEASE);
+  return n;
+}
@@ -0,0 +1,112 @@
+/*
+ * CaptureRing.h
+ *
+ *  Created on: Aug 23, 2016
+ *      Author: vance
+ */
+
+#ifndef CAPTURERING_H_
+#define CAPTURERING_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "AccessRecord.h"
+#include "Address.h"
+
+#define DEFAULT_RING_CAPACITY (1 << 16)   // records
+#define DEFAULT_RING_BATCH 256   // records per publication
+
+/**
+ * A lock-free single-producer single-consumer ring of AccessRecords, from an
+ * instrumented thread to a simulator thread.
+ *
+ * The producer publishes its records in batches: a record costs it one store
+ * into the ring, and every batch one release store of the tail. It only
+ * reads the head the consumer writes when its stale copy says the ring is
+ * full. Each index lives on its own host cache line so the two threads do not
+ * falsely share them.
+ */
+class CaptureRing {
+private:
+  // Written by the consumer.
+  uint64_t head;
+  char head_padding[CACHE_LINE_B - sizeof(uint64_t)];
+  // Written by the producer: the records visible to the consumer.
+  uint64_t tail;
+  char tail_padding[CACHE_LINE_B - sizeof(uint64_t)];
+  // Private to the producer: the records written, and the head it last read.
+  uint64_t unpublished_tail;
+  uint64_t cached_head;
+  char producer_padding[CACHE_LINE_B - 2 * sizeof(uint64_t)];
+  AccessRecord* const records;
+  const uint64_t mask;
+  const uint32_t batch;
+
+public:
+  /**
+   * Constructs an empty CaptureRing.
+   *
+   * @param capacity the number of records the ring holds, a power of two.
+   * @param batch the number of records the producer writes before it
+   *        publishes them.
+   */
+  CaptureRing(const uint64_t capacity = DEFAULT_RING_CAPACITY,
+      const uint32_t batch = DEFAULT_RING_BATCH);
+  virtual ~CaptureRing();
+
+  /**
+   * Appends record to the ring. Returns false, without appending it, if the
+   * ring is full. Producer only.
+   */
+  bool TryPush(const AccessRecord& record) {
+    if (unpublished_tail - cached_head == mask + 1) {
+      cached_head = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+      if (unpublished_tail - cached_head == mask + 1) {
+        // The consumer may be waiting for the records we hold back.
+        Flush();
+        return false;
+      }
+    }
+    records[unpublished_tail & mask] = record;
+    unpublished_tail++;
+    if (unpublished_tail - tail >= batch) {
+      Flush();
+    }
+    return true;
+  }
+
+  /**
+   * Appends record to the ring, waiting for the consumer while the ring is
+   * full. Producer only.
+   */
+  void Push(const AccessRecord& record);
+
+  /**
+   * Publishes the records appended since the last publication, eg. before
+   * the producing thread exits. Producer only.
+   */
+  void Flush() {
+    __atomic_store_n(&tail, unpublished_tail, __ATOMIC_RELEASE);
+  }
+
+  /**
+   * Moves up to max published records into out and returns how many it
+   * moved. Consumer only.
+   */
+  size_t Pop(AccessRecord* const out, const size_t max);
+
+  /**
+   * Returns the number of published records the consumer has not popped.
+   */
+  uint64_t GetSize() const {
+    return __atomic_load_n(&tail, __ATOMIC_ACQUIRE)
+        - __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+  }
+
+  uint64_t GetCapacity() const {
+    return mask + 1;
+  }
+};
+
+#endif /* CAPTURERING_H_ */
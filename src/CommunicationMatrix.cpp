@@ -0,0 +1,132 @@
+/*
+ * CommunicationMatrix.cpp
+ *
+ *  Created on: Aug 17, 2016
+ *      Author: vance
+ */
+
+#include "CommunicationMatrix.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <stdexcept>
+
+CommunicationMatrix::CommunicationMatrix(const uint16_t line_size_B,
+    const uint64_t interval, std::ostream* const export_stream) :
+    line_size_B(line_size_B), bytes_per_bit((line_size_B + 63) / 64),
+    interval(interval), export_stream(export_stream), n_accesses(0),
+    n_intervals(0) {
+  if (interval != 0 && export_stream == NULL) {
+    throw std::invalid_argument("Interval exports need a stream.");
+  }
+}
+
+CommunicationMatrix::~CommunicationMatrix() {
+}
+
+uint64_t CommunicationMatrix::GetMask(const uint32_t offset,
+    const uint32_t size) const {
+  if (size == 0) {
+    return 0;
+  }
+  const uint32_t first = offset / bytes_per_bit;
+  const uint32_t last = (offset + size - 1) / bytes_per_bit;
+  const uint64_t high = last == 63 ? ~(uint64_t) 0 : (2ull << last) - 1;
+  return high & ~((1ull << first) - 1);
+}
+
+void CommunicationMatrix::Add(const uint16_t producer,
+    const uint16_t consumer, const uint64_t bytes) {
+  const size_t n_threads = std::max(producer, consumer) + 1;
+  if (n_threads > matrix.size()) {
+    matrix.resize(n_threads);
+    interval_matrix.resize(n_threads);
+    for (size_t i = 0; i < n_threads; i++) {
+      matrix[i].resize(n_threads, 0);
+      interval_matrix[i].resize(n_threads, 0);
+    }
+  }
+  matrix[producer][consumer] += bytes;
+  interval_matrix[producer][consumer] += bytes;
+}
+
+void CommunicationMatrix::Observe(const AccessRecord& access,
+    const ADDRESS line_address) {
+  const uint64_t mask = GetMask(access.address - line_address, access.size);
+  boost::unordered_map<ADDRESS, LastWriter>::iterator found = writers.find(
+      line_address);
+
+  if (access.type != ACCESS_STORE && found != writers.end()
+      && found->second.thread_id != access.thread_id) {
+    const uint64_t shared = found->second.written & mask;
+    if (shared) {
+      // Only the bytes of the access the producer wrote are communicated.
+      uint64_t bytes = __builtin_popcountll(shared) * bytes_per_bit;
+      Add(found->second.thread_id, access.thread_id,
+          bytes < access.size ? bytes : access.size);
+    }
+  }
+
+  // An empty store writes no byte, and leaves the line to its writer.
+  if ((access.type == ACCESS_STORE || access.type == ACCESS_RMW) && mask) {
+    if (found == writers.end()) {
+      LastWriter writer;
+      writer.written = mask;
+      writer.thread_id = access.thread_id;
+      writers.insert(std::make_pair(line_address, writer));
+    } else if (found->second.thread_id != access.thread_id) {
+      found->second.written = mask;
+      found->second.thread_id = access.thread_id;
+    } else {
+      found->second.written |= mask;
+    }
+  }
+
+  n_accesses++;
+  if (interval != 0 && n_accesses % interval == 0) {
+    Export();
+  }
+}
+
+void CommunicationMatrix::Export() {
+  if (export_stream != NULL) {
+    for (size_t producer = 0; producer < interval_matrix.size(); producer++) {
+      for (size_t consumer = 0; consumer < interval_matrix.size(); consumer++) {
+        if (interval_matrix[producer][consumer]) {
+          *export_stream << n_intervals << "," << producer << "," << consumer
+              << "," << interval_matrix[producer][consumer] << std::endl;
+        }
+      }
+    }
+  }
+  for (size_t producer = 0; producer < interval_matrix.size(); producer++) {
+    std::fill(interval_matrix[producer].begin(),
+        interval_matrix[producer].end(), 0);
+  }
+  n_intervals++;
+}
+
+uint64_t CommunicationMatrix::Get(const uint16_t producer,
+    const uint16_t consumer) const {
+  if (producer >= matrix.size() || consumer >= matrix.size()) {
+    return 0;
+  }
+  return matrix[producer][consumer];
+}
+
+std::ostream& operator<<(std::ostream& stream,
+    const CommunicationMatrix& matrix) {
+  stream << std::setw(8) << "P\\C";
+  for (size_t consumer = 0; consumer < matrix.GetThreadCount(); consumer++) {
+    stream << std::setw(12) << consumer;
+  }
+  stream << std::endl;
+  for (size_t producer = 0; producer < matrix.GetThreadCount(); producer++) {
+    stream << std::setw(8) << producer;
+    for (size_t consumer = 0; consumer < matrix.GetThreadCount(); consumer++) {
+      stream << std::setw(12) << matrix.matrix[producer][consumer];
+    }
+    stream << std::endl;
+  }
+  return stream;
+}
@@ -0,0 +1,101 @@
+/*
+ * CommunicationMatrix.h
+ *
+ *  Created on: Aug 17, 2016
+ *      Author: vance
+ */
+
+#ifndef COMMUNICATIONMATRIX_H_
+#define COMMUNICATIONMATRIX_H_
+
+#include <boost/unordered_map.hpp>
+#include <iostream>
+#include <vector>
+
+#include "AccessObserver.h"
+#include "AccessRecord.h"
+#include "Address.h"
+
+/**
+ * Counts the bytes each thread reads that another thread wrote last, as a
+ * producer to consumer matrix. Entry [p][c] of the matrix is the number of
+ * bytes thread c read that thread p wrote.
+ *
+ * Each line keeps only its last writer and a 64 bit mask of the bytes that
+ * writer wrote, so a line costs the same however many threads touch it. In
+ * lines longer than 64 bytes a bit covers several bytes.
+ */
+class CommunicationMatrix: public AccessObserver {
+private:
+  struct LastWriter {
+    uint64_t written;
+    uint16_t thread_id;
+  };
+
+  boost::unordered_map<ADDRESS, LastWriter> writers;
+  // Cumulative, and since the last export.
+  std::vector<std::vector<uint64_t> > matrix;
+  std::vector<std::vector<uint64_t> > interval_matrix;
+  const uint16_t line_size_B;
+  const uint16_t bytes_per_bit;
+  const uint64_t interval;
+  std::ostream* const export_stream;
+  uint64_t n_accesses;
+  uint64_t n_intervals;
+
+private:
+  /**
+   * Returns the mask of the bits covering size bytes at offset in a line,
+   * empty if size is 0.
+   */
+  uint64_t GetMask(const uint32_t offset, const uint32_t size) const;
+
+  /**
+   * Adds bytes to the cells [producer][consumer], growing the matrices to
+   * fit the threads.
+   */
+  void Add(const uint16_t producer, const uint16_t consumer,
+      const uint64_t bytes);
+
+public:
+  /**
+   * Constructs a CommunicationMatrix for lines of line_size_B bytes.
+   *
+   * @param interval the number of accesses after which the cells counted
+   *        since the last export are written to export_stream, or 0 to never
+   *        export.
+   * @param export_stream where to export, one "interval,producer,consumer,
+   *        bytes" row per nonzero cell. Not owned.
+   */
+  CommunicationMatrix(const uint16_t line_size_B, const uint64_t interval = 0,
+      std::ostream* const export_stream = NULL);
+  virtual ~CommunicationMatrix();
+
+  void Observe(const AccessRecord& access, const ADDRESS line_address);
+
+  /**
+   * Exports the cells counted since the last export, eg. at the end of the
+   * trace.
+   */
+  void Export();
+
+  /**
+   * Returns the bytes consumer read that producer wrote.
+   */
+  uint64_t Get(const uint16_t producer, const uint16_t consumer) const;
+
+  /**
+   * Returns the number of threads in the matrix.
+   */
+  size_t GetThreadCount() const {
+    return matrix.size();
+  }
+
+  /**
+   * Writes the cumulative matrix, one row per producer.
+   */
+  friend std::ostream& operator<<(std::ostream& stream,
+      const CommunicationMatrix& matrix);
+};
+
+#endif /* COMMUNICATIONMATRIX_H_ */
@@ -0,0 +1,276 @@
+/*
+ * ConcurrentMultilevelCache.cpp
+ *
+ *  Created on: Aug 19, 2016
+ *      Author: vance
+ */
+
+#include "ConcurrentMultilevelCache.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <stdlib.h>
+
+ConcurrentMultilevelCache::ConcurrentMultilevelCache(const uint8_t n_cores,
+    const std::vector<uint64_t>& capacities_B,
+    const std::vector<uint16_t>& associativities, const uint16_t line_size_B) :
+    line_size_B(line_size_B) {
+  Build(n_cores, capacities_B, associativities, 0, 0);
+}
+
+ConcurrentMultilevelCache::ConcurrentMultilevelCache(const uint8_t n_cores,
+    const std::vector<uint64_t>& capacities_B,
+    const std::vector<uint16_t>& associativities,
+    const uint64_t l1i_capacity_B, const uint16_t l1i_associativity,
+    const uint16_t line_size_B) :
+    line_size_B(line_size_B) {
+  if (l1i_capacity_B == 0) {
+    throw std::invalid_argument("The L1 instruction cache must have capacity.");
+  }
+  Build(n_cores, capacities_B, associativities, l1i_capacity_B,
+      l1i_associativity);
+}
+
+void ConcurrentMultilevelCache::ParseLevels(const char* levels,
+    std::vector<uint64_t>& capacities_B,
+    std::vector<uint16_t>& associativities) {
+  const std::string text(levels);
+  while (*levels != '\0') {
+    char* end;
+    const uint64_t capacity_B = strtoull(levels, &end, 0);
+    uint64_t associativity = 1;
+    if (end != levels && *end == ':') {
+      levels = end + 1;
+      associativity = strtoul(levels, &end, 0);
+    }
+    if (end == levels || (*end != ',' && *end != '\0')) {
+      throw std::invalid_argument("The caches \"" + text
+          + "\" are not capacity:associativity,...");
+    }
+    capacities_B.push_back(capacity_B);
+    associativities.push_back(associativity);
+    levels = *end == ',' ? end + 1 : end;
+  }
+}
+
+void ConcurrentMultilevelCache::Build(const uint8_t n_cores,
+    const std::vector<uint64_t>& capacities_B,
+    const std::vector<uint16_t>& associativities,
+    const uint64_t l1i_capacity_B, const uint16_t l1i_associativity) {
+  if (capacities_B.size() != associativities.size()) {
+    throw std::invalid_argument(
+        "Capacity and associativity arguments must be the same length.");
+  }
+  if (capacities_B.empty()) {
+    throw std::invalid_argument("A cache needs at least one level.");
+  }
+  // The cache with the fewest sets bounds the number of shards.
+  uint32_t n_shards = UINT32_MAX;
+  for (size_t level = 0; level < capacities_B.size(); level++) {
+    n_shards = std::min(n_shards,
+        Address::GetSetCount(capacities_B[level], associativities[level],
+            line_size_B));
+  }
+  if (l1i_capacity_B != 0) {
+    n_shards = std::min(n_shards,
+        Address::GetSetCount(l1i_capacity_B, l1i_associativity, line_size_B));
+  }
+  n_bits_offset = Address::GetOffsetBitCount(line_size_B);
+  n_bits_shard = Address::GetSetBitCount(n_shards);
+
+  std::vector<uint64_t> shard_capacities_B;
+  for (size_t level = 0; level < capacities_B.size(); level++) {
+    shard_capacities_B.push_back(capacities_B[level] >> n_bits_shard);
+  }
+  for (uint32_t i = 0; i < (1u << n_bits_shard); i++) {
+    Shard* const shard = new Shard;
+    pthread_mutex_init(&shard->lock, NULL);
+    shard->pc_attribution = NULL;
+    shard->data_objects = NULL;
+    if (l1i_capacity_B != 0) {
+      shard->cache = new MultilevelCache(n_cores, shard_capacities_B,
+          associativities, l1i_capacity_B >> n_bits_shard, l1i_associativity,
+          line_size_B);
+    } else {
+      shard->cache = new MultilevelCache(n_cores, shard_capacities_B,
+          associativities, line_size_B);
+    }
+    shards.push_back(shard);
+  }
+}
+
+ConcurrentMultilevelCache::~ConcurrentMultilevelCache() {
+  for (std::vector<Shard*>::iterator it = shards.begin(); it < shards.end();
+      it++) {
+    pthread_mutex_destroy(&(*it)->lock);
+    delete (*it)->cache;
+    delete (*it)->pc_attribution;
+    delete (*it)->data_objects;
+    delete (*it);
+  }
+}
+
+void ConcurrentMultilevelCache::SetInclusionPolicy(
+    const InclusionPolicy policy, const uint32_t max_queries) {
+  for (size_t i = 0; i < shards.size(); i++) {
+    shards[i]->cache->SetInclusionPolicy(policy, max_queries);
+  }
+}
+
+void ConcurrentMultilevelCache::SetWritePolicy(const uint8_t cache,
+    const WriteHitPolicy hit, const WriteMissPolicy miss) {
+  for (size_t i = 0; i < shards.size(); i++) {
+    shards[i]->cache->SetWritePolicy(cache, hit, miss);
+  }
+}
+
+void ConcurrentMultilevelCache::EnablePcAttribution(const size_t n_entries) {
+  for (size_t i = 0; i < shards.size(); i++) {
+    if (shards[i]->pc_attribution == NULL) {
+      shards[i]->pc_attribution = new PcAttribution(line_size_B, n_entries);
+      shards[i]->cache->SetPcAttribution(shards[i]->pc_attribution);
+    }
+  }
+}
+
+void ConcurrentMultilevelCache::EnableDataObjects() {
+  for (size_t i = 0; i < shards.size(); i++) {
+    if (shards[i]->data_objects == NULL) {
+      shards[i]->data_objects = new DataObjectMap(line_size_B, i,
+          n_bits_shard);
+      shards[i]->cache->SetDataObjects(shards[i]->data_objects);
+    }
+  }
+}
+
+void ConcurrentMultilevelCache::AddGlobal(const ADDRESS address,
+    const uint64_t size_B, const std::string& name) {
+  for (size_t i = 0; i < shards.size(); i++) {
+    pthread_mutex_lock(&shards[i]->lock);
+    if (shards[i]->data_objects != NULL) {
+      shards[i]->data_objects->AddGlobal(address, size_B, name);
+    }
+    pthread_mutex_unlock(&shards[i]->lock);
+  }
+}
+
+void ConcurrentMultilevelCache::Access(const AccessRecord& record) {
+  if (record.type >= ACCESS_ALLOC) {
+    if (shards[0]->data_objects == NULL) {
+      return;
+    }
+    // Each shard keeps the objects with lines in it. The addresses of the
+    // events are not translated: the maps take those of the application.
+    for (size_t i = 0; i < shards.size(); i++) {
+      pthread_mutex_lock(&shards[i]->lock);
+      shards[i]->cache->Simulate(record);
+      pthread_mutex_unlock(&shards[i]->lock);
+    }
+    return;
+  }
+  AccessRecord access = record;
+  ADDRESS address = record.address;
+  uint32_t bytes_remaining = record.size;
+  // The lines of an access may belong to different shards: each line is
+  // accessed under the lock of its own shard.
+  do {
+    const uint32_t bytes_to_end_of_line = line_size_B
+        - (address & (line_size_B - 1));
+    access.address = GetShardAddress(address);
+    access.size =
+        bytes_remaining < bytes_to_end_of_line ?
+            bytes_remaining : bytes_to_end_of_line;
+
+    Shard* const shard = shards[GetShard(address)];
+    pthread_mutex_lock(&shard->lock);
+    shard->cache->Simulate(access);
+    pthread_mutex_unlock(&shard->lock);
+
+    address += access.size;
+    bytes_remaining -= access.size;
+  } while (bytes_remaining > 0);
+}
+
+void ConcurrentMultilevelCache::Finalize() {
+  for (size_t i = 0; i < shards.size(); i++) {
+    pthread_mutex_lock(&shards[i]->lock);
+    shards[i]->cache->Finalize();
+    pthread_mutex_unlock(&shards[i]->lock);
+  }
+}
+
+uint64_t ConcurrentMultilevelCache::Sum(
+    uint64_t MultilevelCache::* const counter) const {
+  uint64_t sum = 0;
+  for (size_t i = 0; i < shards.size(); i++) {
+    pthread_mutex_lock(&shards[i]->lock);
+    sum += shards[i]->cache->*counter;
+    pthread_mutex_unlock(&shards[i]->lock);
+  }
+  return sum;
+}
+
+std::vector<uint64_t> ConcurrentMultilevelCache::Sum(
+    std::vector<uint64_t> MultilevelCache::* const counters) const {
+  std::vector<uint64_t> sum;
+  for (size_t i = 0; i < shards.size(); i++) {
+    pthread_mutex_lock(&shards[i]->lock);
+    const std::vector<uint64_t>& shard_counters = shards[i]->cache->*counters;
+    sum.resize(shard_counters.size(), 0);
+    for (size_t j = 0; j < shard_counters.size(); j++) {
+      sum[j] += shard_counters[j];
+    }
+    pthread_mutex_unlock(&shards[i]->lock);
+  }
+  return sum;
+}
+
+std::vector<LevelCounters> ConcurrentMultilevelCache::SumLevelCounters() const {
+  std::vector<LevelCounters> sum;
+  for (size_t i = 0; i < shards.size(); i++) {
+    pthread_mutex_lock(&shards[i]->lock);
+    const std::vector<LevelCounters>& shard_counters =
+        shards[i]->cache->level_counters;
+    sum.resize(shard_counters.size(), LevelCounters());
+    for (size_t j = 0; j < shard_counters.size(); j++) {
+      sum[j].Add(shard_counters[j]);
+    }
+    pthread_mutex_unlock(&shards[i]->lock);
+  }
+  return sum;
+}
+
+FootprintHistogram ConcurrentMultilevelCache::MergeFootprints() const {
+  FootprintHistogram merged(shards[0]->cache->line_size_B);
+  for (size_t i = 0; i < shards.size(); i++) {
+    pthread_mutex_lock(&shards[i]->lock);
+    merged.Merge(shards[i]->cache->footprints);
+    pthread_mutex_unlock(&shards[i]->lock);
+  }
+  return merged;
+}
+
+PcAttribution ConcurrentMultilevelCache::MergePcAttribution(
+    const size_t n_entries) const {
+  PcAttribution merged(line_size_B, n_entries);
+  for (size_t i = 0; i < shards.size(); i++) {
+    pthread_mutex_lock(&shards[i]->lock);
+    if (shards[i]->pc_attribution != NULL) {
+      merged.Merge(*shards[i]->pc_attribution);
+    }
+    pthread_mutex_unlock(&shards[i]->lock);
+  }
+  return merged;
+}
+
+DataObjectMap ConcurrentMultilevelCache::MergeDataObjects() const {
+  DataObjectMap merged(line_size_B);
+  for (size_t i = 0; i < shards.size(); i++) {
+    pthread_mutex_lock(&shards[i]->lock);
+    if (shards[i]->data_objects != NULL) {
+      merged.Merge(*shards[i]->data_objects);
+    }
+    pthread_mutex_unlock(&shards[i]->lock);
+  }
+  return merged;
+}
@@ -0,0 +1,195 @@
+/*
+ * ConcurrentMultilevelCache.h
+ *
+ *  Created on: Aug 19, 2016
+ *      Author: vance
+ */
+
+#ifndef CONCURRENTMULTILEVELCACHE_H_
+#define CONCURRENTMULTILEVELCACHE_H_
+
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+#include "AccessRecord.h"
+#include "Address.h"
+#include "MultilevelCache.h"
+
+/**
+ * A MultilevelCache that many threads may access at once, eg. the
+ * application threads of a Pintool.
+ *
+ * Every cache indexes its sets with the address bits just above the line
+ * offset, so the lowest set bits of the cache with the fewest sets select the
+ * same slice of sets in every cache. An access, the victims it evicts, their
+ * back-invalidations and the coherence actions on its line all stay within
+ * the slice of its line. The hierarchy is therefore split into one shard per
+ * slice: a MultilevelCache holding that slice of every cache, behind its own
+ * lock. Threads accessing different slices never contend, and each shard's
+ * statistics are written only under its lock and summed when read.
+ *
+ * The shards model the whole hierarchy exactly, except that each shard has
+ * its own write-combining buffers.
+ */
+class ConcurrentMultilevelCache {
+private:
+  struct Shard {
+    pthread_mutex_t lock;
+    MultilevelCache* cache;
+    PcAttribution* pc_attribution;
+    DataObjectMap* data_objects;
+    char padding[CACHE_LINE_B];
+  };
+
+  std::vector<Shard*> shards;
+  uint8_t n_bits_offset;
+  uint8_t n_bits_shard;
+
+private:
+  void Build(const uint8_t n_cores, const std::vector<uint64_t>& capacities_B,
+      const std::vector<uint16_t>& associativities,
+      const uint64_t l1i_capacity_B, const uint16_t l1i_associativity);
+
+  /**
+   * Returns the shard of address.
+   */
+  uint32_t GetShard(const ADDRESS address) const {
+    return (address >> n_bits_offset) & ((1u << n_bits_shard) - 1);
+  }
+
+  /**
+   * Returns the address of address within its shard, ie. without the bits
+   * that select the shard.
+   */
+  ADDRESS GetShardAddress(const ADDRESS address) const {
+    return ((address >> (n_bits_offset + n_bits_shard)) << n_bits_offset)
+        | (address & ((1u << n_bits_offset) - 1));
+  }
+
+public:
+  const uint16_t line_size_B;
+
+public:
+  /**
+   * Constructs a concurrent multicore hierarchy. The arguments are those of
+   * the equivalent MultilevelCache.
+   */
+  ConcurrentMultilevelCache(const uint8_t n_cores,
+      const std::vector<uint64_t>& capacities_B,
+      const std::vector<uint16_t>& associativities,
+      const uint16_t line_size_B = DEFAULT_LINE_SIZE);
+
+  /**
+   * Constructs a concurrent multicore hierarchy with split private L1 caches.
+   */
+  ConcurrentMultilevelCache(const uint8_t n_cores,
+      const std::vector<uint64_t>& capacities_B,
+      const std::vector<uint16_t>& associativities,
+      const uint64_t l1i_capacity_B, const uint16_t l1i_associativity,
+      const uint16_t line_size_B = DEFAULT_LINE_SIZE);
+  virtual ~ConcurrentMultilevelCache();
+
+  /**
+   * Appends the levels of levels, written "capacity:associativity,...", to
+   * capacities_B and associativities. An associativity may be left out for
+   * a direct-mapped level. Throws std::invalid_argument if levels is not
+   * in that form.
+   */
+  static void ParseLevels(const char* levels,
+      std::vector<uint64_t>& capacities_B,
+      std::vector<uint16_t>& associativities);
+
+  /**
+   * Returns the number of shards, ie. of threads that can access the
+   * hierarchy without contending.
+   */
+  size_t GetShardCount() const {
+    return shards.size();
+  }
+
+  /**
+   * Selects the LLC replacement policy of every shard. Not thread-safe.
+   */
+  void SetInclusionPolicy(const InclusionPolicy policy,
+      const uint32_t max_queries = UINT32_MAX);
+
+  /**
+   * Selects the write policies of cache in every shard. Not thread-safe.
+   */
+  void SetWritePolicy(const uint8_t cache, const WriteHitPolicy hit,
+      const WriteMissPolicy miss);
+
+  /**
+   * Charges misses and unused bytes to instructions, see
+   * MultilevelCache::SetPcAttribution, in a table of n_entries per shard.
+   * Not thread-safe.
+   */
+  void EnablePcAttribution(const size_t n_entries = DEFAULT_PC_ENTRIES);
+
+  /**
+   * Charges misses and unused bytes to data objects, see
+   * MultilevelCache::SetDataObjects, in a map per shard holding the objects
+   * with lines in the shard. Not thread-safe.
+   */
+  void EnableDataObjects();
+
+  /**
+   * Adds a global variable to the data objects, eg. one of
+   * Symbolizer::data_symbols. Thread-safe.
+   */
+  void AddGlobal(const ADDRESS address, const uint64_t size_B,
+      const std::string& name);
+
+  /**
+   * Access the cache for the operation described by record. Thread-safe.
+   * ACCESS_ALLOC and ACCESS_FREE records go to every shard.
+   */
+  void Access(const AccessRecord& record);
+
+  /**
+   * Finalizes every shard, see MultilevelCache::Finalize. Call once the
+   * accesses are done, before reading the counters.
+   */
+  void Finalize();
+
+  /**
+   * Returns a counter of MultilevelCache summed over the shards, eg.
+   * Sum(&MultilevelCache::hits). Thread-safe.
+   */
+  uint64_t Sum(uint64_t MultilevelCache::* const counter) const;
+
+  /**
+   * Returns a vector of counters of MultilevelCache summed entry by entry
+   * over the shards, eg. Sum(&MultilevelCache::inclusion_victims).
+   * Thread-safe.
+   */
+  std::vector<uint64_t> Sum(
+      std::vector<uint64_t> MultilevelCache::* const counters) const;
+
+  /**
+   * Returns the counters of each cache summed over the shards. Thread-safe.
+   */
+  std::vector<LevelCounters> SumLevelCounters() const;
+
+  /**
+   * Returns the footprints of the shards merged into one histogram.
+   * Thread-safe.
+   */
+  FootprintHistogram MergeFootprints() const;
+
+  /**
+   * Returns the instruction charges of the shards merged into one table of
+   * n_entries. Thread-safe.
+   */
+  PcAttribution MergePcAttribution(
+      const size_t n_entries = DEFAULT_PC_ENTRIES) const;
+
+  /**
+   * Returns the data object charges of the shards merged into one map, which
+   * holds no objects. Thread-safe.
+   */
+  DataObjectMap MergeDataObjects() const;
+};
+
+#endif /* CONCURRENTMULTILEVELCACHE_H_ */
@@ -0,0 +1,274 @@
+/*
+ * DataObjectMap.cpp
+ *
+ *  Created on: Sep 18, 2016
+ *      Author: vance
+ */
+
+#include "DataObjectMap.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <stdexcept>
+
+namespace {
+
+uint64_t GetMisses(const ObjectSite& site) {
+  return site.misses;
+}
+
+uint64_t GetWastedBytes(const ObjectSite& site) {
+  return site.GetWastedBytes() + site.GetResidentWastedBytes();
+}
+
+/**
+ * Orders sites by a counter, the most first.
+ */
+class MoreOf {
+private:
+  uint64_t (*counter)(const ObjectSite&);
+
+public:
+  MoreOf(uint64_t (*counter)(const ObjectSite&)) :
+      counter(counter) {
+  }
+
+  bool operator()(const ObjectSite& a, const ObjectSite& b) const {
+    if (counter(a) != counter(b)) {
+      return counter(a) > counter(b);
+    }
+    if (a.heap != b.heap) {
+      return a.heap;
+    }
+    if (a.heap || a.name == b.name) {
+      return a.address < b.address;
+    }
+    return a.name < b.name;
+  }
+};
+
+void Add(ObjectSite& site, const ObjectSite& other) {
+  site.objects += other.objects;
+  site.misses += other.misses;
+  site.evictions += other.evictions;
+  site.used_bytes += other.used_bytes;
+  for (size_t i = 0; i < site.byte_utilizations.size(); i++) {
+    site.byte_utilizations[i] += other.byte_utilizations[i];
+  }
+  site.resident += other.resident;
+  site.resident_used_bytes += other.resident_used_bytes;
+}
+
+void WriteRows(std::ostream& stream, const std::vector<ObjectSite>& rows) {
+  stream << std::setw(18) << "Site" << std::setw(10) << "Objects"
+      << std::setw(12) << "Misses" << std::setw(12) << "Evictions"
+      << std::setw(14) << "WastedBytes" << std::setw(12) << "Resident"
+      << std::setw(16) << "ResWastedBytes" << "  Global" << std::endl;
+  for (size_t i = 0; i < rows.size(); i++) {
+    stream << std::setw(18) << std::hex << std::showbase << rows[i].address
+        << std::dec << std::noshowbase << std::setw(10) << rows[i].objects
+        << std::setw(12) << rows[i].misses << std::setw(12)
+        << rows[i].evictions << std::setw(14) << rows[i].GetWastedBytes()
+        << std::setw(12) << rows[i].resident << std::setw(16)
+        << rows[i].GetResidentWastedBytes() << "  " << rows[i].name
+        << std::endl;
+  }
+}
+
+}
+
+DataObjectMap::DataObjectMap(const uint16_t line_size_B,
+    const uint32_t shard, const uint8_t n_bits_shard) :
+    line_size_B(line_size_B),
+        n_bits_offset(Address::GetOffsetBitCount(line_size_B)), shard(shard),
+        n_bits_shard(n_bits_shard), unknown(), n_lookups(0), n_last_hits(0) {
+  last_start = 0;
+  last.end = 0;
+  last.site = 0;
+  if (shard >> n_bits_shard) {
+    throw std::invalid_argument("The shard is not one of the shards.");
+  }
+  unknown.byte_utilizations.resize(line_size_B, 0);
+}
+
+DataObjectMap::~DataObjectMap() {
+}
+
+uint32_t DataObjectMap::AddSite(const std::string& name,
+    const ADDRESS address, const bool heap) {
+  ObjectSite site = ObjectSite();
+  site.name = name;
+  site.address = address;
+  site.heap = heap;
+  site.byte_utilizations.resize(line_size_B, 0);
+  sites.push_back(site);
+  return sites.size() - 1;
+}
+
+uint32_t DataObjectMap::GetHeapSite(const ADDRESS site) {
+  const boost::unordered_map<ADDRESS, uint32_t>::const_iterator found =
+      heap_sites.find(site);
+  if (found != heap_sites.end()) {
+    return found->second;
+  }
+  const uint32_t index = AddSite("", site, true);
+  heap_sites[site] = index;
+  return index;
+}
+
+uint32_t DataObjectMap::GetGlobalSite(const std::string& name,
+    const ADDRESS address) {
+  const std::pair<std::string, ADDRESS> key(name, address);
+  const std::map<std::pair<std::string, ADDRESS>, uint32_t>::const_iterator
+      found = global_sites.find(key);
+  if (found != global_sites.end()) {
+    return found->second;
+  }
+  const uint32_t index = AddSite(name, address, false);
+  global_sites[key] = index;
+  return index;
+}
+
+bool DataObjectMap::IsInShard(const ADDRESS start, const uint64_t end) const {
+  if (n_bits_shard == 0) {
+    return true;
+  }
+  const uint64_t first_line = start >> n_bits_offset;
+  const uint64_t n_lines = ((end - 1) >> n_bits_offset) - first_line + 1;
+  const uint64_t n_shards = 1ull << n_bits_shard;
+  // The lines of the shard are every n_shards-th line.
+  return n_lines >= n_shards
+      || ((shard - first_line) & (n_shards - 1)) < n_lines;
+}
+
+void DataObjectMap::Insert(const ADDRESS start, const uint64_t size_B,
+    const uint32_t site) {
+  const uint64_t end = (uint64_t) start + size_B;
+  ObjectIntervals::iterator it = objects.lower_bound(start);
+  while (it != objects.end() && it->first < end) {
+    objects.erase(it++);
+  }
+  const Object object = { end, site };
+  objects.insert(it, std::make_pair(start, object));
+  last.end = 0;
+}
+
+ObjectSite& DataObjectMap::Find(const ADDRESS shard_address) {
+  const ADDRESS offset_mask = (1u << n_bits_offset) - 1;
+  const ADDRESS address = ((shard_address >> n_bits_offset)
+      << (n_bits_offset + n_bits_shard)) | (shard << n_bits_offset)
+      | (shard_address & offset_mask);
+  n_lookups++;
+  if (last_start <= address && address < last.end) {
+    n_last_hits++;
+    return sites[last.site];
+  }
+  ObjectIntervals::const_iterator it = objects.upper_bound(address);
+  if (it != objects.begin()) {
+    --it;
+    if (address < it->second.end) {
+      last_start = it->first;
+      last = it->second;
+      return sites[it->second.site];
+    }
+  }
+  return unknown;
+}
+
+void DataObjectMap::Allocate(const ADDRESS address, const uint64_t size_B,
+    const ADDRESS site) {
+  const uint32_t index = GetHeapSite(site);
+  // Every shard sees every allocation: the first counts it.
+  if (shard == 0) {
+    sites[index].objects++;
+  }
+  // An empty allocation still has an address of its own.
+  const uint64_t size = size_B ? size_B : 1;
+  if (IsInShard(address, (uint64_t) address + size)) {
+    Insert(address, size, index);
+  }
+}
+
+void DataObjectMap::Free(const ADDRESS address) {
+  const ObjectIntervals::iterator it = objects.find(address);
+  if (it != objects.end() && sites[it->second.site].heap) {
+    objects.erase(it);
+    last.end = 0;
+  }
+}
+
+void DataObjectMap::AddGlobal(const ADDRESS address, const uint64_t size_B,
+    const std::string& name) {
+  if (size_B == 0) {
+    return;
+  }
+  const uint32_t index = GetGlobalSite(name, address);
+  if (shard == 0) {
+    sites[index].objects++;
+  }
+  if (IsInShard(address, (uint64_t) address + size_B)) {
+    Insert(address, size_B, index);
+  }
+}
+
+void DataObjectMap::Evict(const ADDRESS address, const size_t used_B) {
+  ObjectSite& site = Find(address);
+  site.evictions++;
+  site.used_bytes += used_B;
+  if (used_B) {
+    site.byte_utilizations.at(used_B - 1)++;
+  }
+}
+
+void DataObjectMap::Merge(const DataObjectMap& other) {
+  if (other.line_size_B != line_size_B) {
+    throw std::invalid_argument("The maps' line sizes differ.");
+  }
+  for (size_t i = 0; i < other.sites.size(); i++) {
+    const ObjectSite& site = other.sites[i];
+    const uint32_t index =
+        site.heap ?
+            GetHeapSite(site.address) : GetGlobalSite(site.name, site.address);
+    Add(sites[index], site);
+  }
+  Add(unknown, other.unknown);
+  n_lookups += other.n_lookups;
+  n_last_hits += other.n_last_hits;
+}
+
+std::vector<ObjectSite> DataObjectMap::GetTop(
+    uint64_t (*counter)(const ObjectSite&), const size_t n) const {
+  std::vector<ObjectSite> top;
+  for (size_t i = 0; i < sites.size(); i++) {
+    if (counter(sites[i])) {
+      top.push_back(sites[i]);
+    }
+  }
+  const size_t n_top = std::min(n, top.size());
+  std::partial_sort(top.begin(), top.begin() + n_top, top.end(),
+      MoreOf(counter));
+  top.resize(n_top);
+  return top;
+}
+
+std::vector<ObjectSite> DataObjectMap::GetTopMisses(const size_t n) const {
+  return GetTop(GetMisses, n);
+}
+
+std::vector<ObjectSite> DataObjectMap::GetTopWastedBytes(
+    const size_t n) const {
+  return GetTop(GetWastedBytes, n);
+}
+
+std::ostream& operator<<(std::ostream& stream, const DataObjectMap& map) {
+  stream << "Top data objects by misses" << std::endl;
+  WriteRows(stream, map.GetTopMisses(DEFAULT_OBJECT_REPORT_ROWS));
+  stream << "Top data objects by wasted bytes" << std::endl;
+  WriteRows(stream, map.GetTopWastedBytes(DEFAULT_OBJECT_REPORT_ROWS));
+  stream << "Unknown: Misses: " << map.unknown.misses << ", Evictions: "
+      << map.unknown.evictions << ", WastedBytes: "
+      << map.unknown.GetWastedBytes() << ", Resident: " << map.unknown.resident
+      << ", ResWastedBytes: " << map.unknown.GetResidentWastedBytes()
+      << std::endl;
+  return stream;
+}
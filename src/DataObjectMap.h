@@ -0,0 +1,241 @@
+/*
+ * DataObjectMap.h
+ *
+ *  Created on: Sep 18, 2016
+ *      Author: vance
+ */
+
+#ifndef DATAOBJECTMAP_H_
+#define DATAOBJECTMAP_H_
+
+#include <boost/unordered_map.hpp>
+#include <iostream>
+#include <map>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Address.h"
+
+#define DEFAULT_OBJECT_REPORT_ROWS 20
+
+/**
+ * What the objects of one origin cost the hierarchy: a global variable, or
+ * the heap objects allocated at one call site.
+ */
+struct ObjectSite {
+  // The symbol of a global variable, empty for an allocation site.
+  std::string name;
+  // The call site of the allocations, or the address of the global.
+  ADDRESS address;
+  bool heap;
+  // The objects allocated at the site, 1 for a global.
+  uint64_t objects;
+  // The accesses to the objects that missed in every level.
+  uint64_t misses;
+  // The lines of the objects that left the hierarchy, and how many of their
+  // bytes were accessed.
+  uint64_t evictions;
+  uint64_t used_bytes;
+  // Entry i counts the lines that left with i + 1 bytes accessed.
+  std::vector<uint64_t> byte_utilizations;
+  // The lines of the objects still in the hierarchy when it was finalized,
+  // and how many of their bytes were accessed.
+  uint64_t resident;
+  uint64_t resident_used_bytes;
+
+  /**
+   * Returns the bytes of the lines evicted that were never accessed.
+   */
+  uint64_t GetWastedBytes() const {
+    return evictions * byte_utilizations.size() - used_bytes;
+  }
+
+  /**
+   * Returns the bytes of the resident lines that were never accessed.
+   */
+  uint64_t GetResidentWastedBytes() const {
+    return resident * byte_utilizations.size() - resident_used_bytes;
+  }
+};
+
+/**
+ * Charges the misses of the hierarchy, and the bytes of the lines that left
+ * it unused, to data objects: the global variables of the binaries, and the
+ * heap objects, summed per allocation site. The trace carries the
+ * allocations and frees (ACCESS_ALLOC and ACCESS_FREE records), so that the
+ * objects are known when their accesses are simulated.
+ *
+ * The live objects are kept as intervals ordered by address, so finding the
+ * object of an address is a binary search. Consecutive accesses mostly fall
+ * in the same object, so the last object found is tried first. A line is
+ * charged, when it leaves, to the object of the first byte accessed in it.
+ * Addresses in no object are charged to the unknown site.
+ *
+ * A map may serve one shard of a ConcurrentMultilevelCache: it then holds
+ * only the objects with lines in the shard, and translates the addresses
+ * of the shard back into those of the application.
+ */
+class DataObjectMap {
+private:
+  struct Object {
+    // One past the last byte, which may be past the last ADDRESS.
+    uint64_t end;
+    uint32_t site;
+  };
+
+  typedef std::map<ADDRESS, Object> ObjectIntervals;
+
+  ObjectIntervals objects;
+  // The object found last, kept by value so that the map stays copyable.
+  // Empty once it may have been removed.
+  ADDRESS last_start;
+  Object last;
+  std::vector<ObjectSite> sites;
+  // Map an allocation site or a global to its index in sites. Globals are
+  // keyed by name and address, as the binaries may share a symbol name.
+  boost::unordered_map<ADDRESS, uint32_t> heap_sites;
+  std::map<std::pair<std::string, ADDRESS>, uint32_t> global_sites;
+  const uint16_t line_size_B;
+  const uint8_t n_bits_offset;
+  const uint32_t shard;
+  const uint8_t n_bits_shard;
+
+private:
+  /**
+   * Returns the index of a new site.
+   */
+  uint32_t AddSite(const std::string& name, const ADDRESS address,
+      const bool heap);
+
+  /**
+   * Returns the index of the allocation site at site, adding it if new.
+   */
+  uint32_t GetHeapSite(const ADDRESS site);
+
+  /**
+   * Returns the index of the global name at address, adding it if new.
+   */
+  uint32_t GetGlobalSite(const std::string& name, const ADDRESS address);
+
+  /**
+   * Returns whether [start, end) has a line in the shard of the map.
+   */
+  bool IsInShard(const ADDRESS start, const uint64_t end) const;
+
+  /**
+   * Adds the object at [start, start + size_B) to site, replacing the
+   * objects that started within it, which must have been freed.
+   */
+  void Insert(const ADDRESS start, const uint64_t size_B,
+      const uint32_t site);
+
+  /**
+   * Returns the site of the object holding address, in the shard, or the
+   * unknown site.
+   */
+  ObjectSite& Find(const ADDRESS address);
+
+  /**
+   * Returns the n sites counted with the most of counter.
+   */
+  std::vector<ObjectSite> GetTop(uint64_t (*counter)(const ObjectSite&),
+      const size_t n) const;
+
+public:
+  // The charges of the addresses in no object.
+  ObjectSite unknown;
+  // The lookups, and those the last object found answered.
+  uint64_t n_lookups;
+  uint64_t n_last_hits;
+
+  /**
+   * Constructs a DataObjectMap for lines of line_size_B bytes. A map for
+   * shard of the 2^n_bits_shard shards of a ConcurrentMultilevelCache is
+   * charged with the addresses of the shard.
+   */
+  DataObjectMap(const uint16_t line_size_B, const uint32_t shard = 0,
+      const uint8_t n_bits_shard = 0);
+  virtual ~DataObjectMap();
+
+  /**
+   * Adds a heap object of size_B bytes at address, allocated by the call at
+   * site.
+   */
+  void Allocate(const ADDRESS address, const uint64_t size_B,
+      const ADDRESS site);
+
+  /**
+   * Removes the heap object at address, if any.
+   */
+  void Free(const ADDRESS address);
+
+  /**
+   * Adds the global variable name of size_B bytes at address.
+   */
+  void AddGlobal(const ADDRESS address, const uint64_t size_B,
+      const std::string& name);
+
+  /**
+   * Charges a miss at address.
+   */
+  void Miss(const ADDRESS address) {
+    Find(address).misses++;
+  }
+
+  /**
+   * Charges a line that left the hierarchy with used_B bytes accessed, the
+   * first at address.
+   */
+  void Evict(const ADDRESS address, const size_t used_B);
+
+  /**
+   * Charges a line still in the hierarchy when it was finalized with used_B
+   * bytes accessed, the first at address, see MultilevelCache::Finalize.
+   */
+  void Resident(const ADDRESS address, const size_t used_B) {
+    ObjectSite& site = Find(address);
+    site.resident++;
+    site.resident_used_bytes += used_B;
+  }
+
+  /**
+   * Returns the number of live objects in the map.
+   */
+  size_t GetObjectCount() const {
+    return objects.size();
+  }
+
+  /**
+   * Adds the charges counted by other, eg. by another shard, to these.
+   */
+  void Merge(const DataObjectMap& other);
+
+  /**
+   * Returns every site, in no order, without the unknown site.
+   */
+  const std::vector<ObjectSite>& GetSites() const {
+    return sites;
+  }
+
+  /**
+   * Returns the n sites with the most misses, the most first.
+   */
+  std::vector<ObjectSite> GetTopMisses(const size_t n) const;
+
+  /**
+   * Returns the n sites with the most wasted bytes, evicted and resident,
+   * the most first.
+   */
+  std::vector<ObjectSite> GetTopWastedBytes(const size_t n) const;
+
+  /**
+   * Writes the DEFAULT_OBJECT_REPORT_ROWS sites with the most misses, then
+   * those with the most wasted bytes.
+   */
+  friend std::ostream& operator<<(std::ostream& stream,
+      const DataObjectMap& map);
+};
+
+#endif /* DATAOBJECTMAP_H_ */
@@ -0,0 +1,197 @@
+/*
+ * FalseSharingDetector.cpp
+ *
+ *  Created on: Aug 16, 2016
+ *      Author: vance
+ */
+
+#include "FalseSharingDetector.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+namespace {
+
+bool MorePingPongs(const FalseSharingReport& a, const FalseSharingReport& b) {
+  if (a.ping_pongs != b.ping_pongs) {
+    return a.ping_pongs > b.ping_pongs;
+  }
+  return a.address < b.address;
+}
+
+/**
+ * Writes the set bits of bytes as ranges, eg. "0-3,8".
+ */
+void WriteRanges(std::ostream& stream, const boost::dynamic_bitset<>& bytes) {
+  bool first = true;
+  size_t start = bytes.find_first();
+  while (start != boost::dynamic_bitset<>::npos) {
+    size_t end = start;
+    while (end + 1 < bytes.size() && bytes[end + 1]) {
+      end++;
+    }
+    stream << (first ? "" : ",") << start;
+    if (end != start) {
+      stream << "-" << end;
+    }
+    first = false;
+    start = bytes.find_next(end);
+  }
+}
+
+}
+
+FalseSharingDetector::FalseSharingDetector(const uint16_t line_size_B) :
+    line_size_B(line_size_B) {
+}
+
+FalseSharingDetector::~FalseSharingDetector() {
+}
+
+FalseSharingDetector::ThreadBytes FalseSharingDetector::NewThreadBytes(
+    const uint16_t thread_id, const uint64_t n_writes) const {
+  ThreadBytes bytes;
+  bytes.thread_id = thread_id;
+  bytes.read_bytes.resize(line_size_B, false);
+  bytes.written_bytes.resize(line_size_B, false);
+  // The first access of a thread is a cold miss, not a transfer.
+  bytes.last_seen = n_writes;
+  return bytes;
+}
+
+FalseSharingDetector::ThreadBytes& FalseSharingDetector::GetThreadBytes(
+    SharedLine& line, const uint16_t thread_id) {
+  for (std::vector<ThreadBytes>::iterator it = line.threads.begin();
+      it != line.threads.end(); it++) {
+    if (it->thread_id == thread_id) {
+      return *it;
+    }
+  }
+  line.threads.push_back(NewThreadBytes(thread_id, line.n_writes));
+  return line.threads.back();
+}
+
+bool FalseSharingDetector::AddBytes(ThreadBytes& bytes,
+    const AccessRecord& access, const uint32_t start, const uint32_t end) {
+  const bool write = access.type == ACCESS_STORE || access.type == ACCESS_RMW;
+  for (uint32_t i = start; i < end; i++) {
+    if (write) {
+      bytes.written_bytes[i] = true;
+    }
+    if (access.type != ACCESS_STORE) {
+      bytes.read_bytes[i] = true;
+    }
+  }
+  return write;
+}
+
+void FalseSharingDetector::Observe(const AccessRecord& access,
+    const ADDRESS line_address) {
+  const uint32_t start = access.address - line_address;
+  const uint32_t end = start + access.size;
+  boost::unordered_map<ADDRESS, SharedLine>::iterator found = lines.find(
+      line_address);
+  if (found == lines.end()) {
+    boost::unordered_map<ADDRESS, ThreadBytes>::iterator owned =
+        private_lines.find(line_address);
+    if (owned == private_lines.end()) {
+      owned = private_lines.insert(std::make_pair(line_address,
+          NewThreadBytes(access.thread_id, 0))).first;
+    }
+    ThreadBytes& owner = owned->second;
+    if (owner.thread_id == access.thread_id) {
+      if (AddBytes(owner, access, start, end)) {
+        owner.last_seen++;
+      }
+      return;
+    }
+    // A second thread: the line is shared from now on.
+    SharedLine shared;
+    shared.n_writes = owner.last_seen;
+    shared.last_writer = owner.thread_id;
+    shared.threads.push_back(owner);
+    private_lines.erase(owned);
+    found = lines.insert(std::make_pair(line_address, shared)).first;
+  }
+  SharedLine& line = found->second;
+
+  if (line.n_writes > GetThreadBytes(line, access.thread_id).last_seen
+      && line.last_writer != access.thread_id) {
+    // Another thread wrote the line since this thread last accessed it: the
+    // line moves from the writer to this thread.
+    const ThreadBytes& writer = GetThreadBytes(line, line.last_writer);
+    bool overlaps = false;
+    for (uint32_t i = start; i < end && !overlaps; i++) {
+      overlaps = writer.written_bytes[i];
+    }
+    Transfers& transfers = line.transfers[std::make_pair(
+        std::min(access.thread_id, line.last_writer),
+        std::max(access.thread_id, line.last_writer))];
+    if (overlaps) {
+      transfers.true_sharing++;
+    } else {
+      transfers.false_sharing++;
+    }
+  }
+
+  // The writer lookup may have grown the vector: look the thread up again.
+  ThreadBytes& bytes = GetThreadBytes(line, access.thread_id);
+  if (AddBytes(bytes, access, start, end)) {
+    line.n_writes++;
+    line.last_writer = access.thread_id;
+  }
+  bytes.last_seen = line.n_writes;
+}
+
+std::vector<FalseSharingReport> FalseSharingDetector::GetFalseSharing() const {
+  std::vector<FalseSharingReport> reports;
+  for (boost::unordered_map<ADDRESS, SharedLine>::const_iterator line =
+      lines.begin(); line != lines.end(); line++) {
+    const SharedLine& shared = line->second;
+    for (std::map<std::pair<uint16_t, uint16_t>, Transfers>::const_iterator it =
+        shared.transfers.begin(); it != shared.transfers.end(); it++) {
+      if (it->second.false_sharing == 0) {
+        continue;
+      }
+      FalseSharingReport report;
+      report.address = line->first;
+      report.thread_a = it->first.first;
+      report.thread_b = it->first.second;
+      for (size_t i = 0; i < shared.threads.size(); i++) {
+        const ThreadBytes& bytes = shared.threads[i];
+        if (bytes.thread_id == report.thread_a) {
+          report.bytes_a = bytes.read_bytes | bytes.written_bytes;
+        } else if (bytes.thread_id == report.thread_b) {
+          report.bytes_b = bytes.read_bytes | bytes.written_bytes;
+        }
+      }
+      report.ping_pongs = it->second.false_sharing;
+      report.true_sharing_transfers = it->second.true_sharing;
+      reports.push_back(report);
+    }
+  }
+  std::sort(reports.begin(), reports.end(), MorePingPongs);
+  return reports;
+}
+
+std::ostream& operator<<(std::ostream& stream,
+    const FalseSharingDetector& detector) {
+  const std::vector<FalseSharingReport> reports = detector.GetFalseSharing();
+  stream << std::setw(18) << "Line" << std::setw(10) << "Thread"
+      << std::setw(16) << "Bytes" << std::setw(10) << "Thread"
+      << std::setw(16) << "Bytes" << std::setw(12) << "PingPongs"
+      << std::setw(12) << "TrueShared" << std::endl;
+  for (size_t i = 0; i < reports.size(); i++) {
+    const FalseSharingReport& report = reports[i];
+    std::ostringstream bytes_a, bytes_b;
+    WriteRanges(bytes_a, report.bytes_a);
+    WriteRanges(bytes_b, report.bytes_b);
+    stream << std::setw(18) << std::hex << std::showbase << report.address
+        << std::dec << std::noshowbase << std::setw(10) << report.thread_a
+        << std::setw(16) << bytes_a.str() << std::setw(10) << report.thread_b
+        << std::setw(16) << bytes_b.str() << std::setw(12) << report.ping_pongs
+        << std::setw(12) << report.true_sharing_transfers << std::endl;
+  }
+  return stream;
+}
@@ -0,0 +1,131 @@
+/*
+ * FalseSharingDetector.h
+ *
+ *  Created on: Aug 16, 2016
+ *      Author: vance
+ */
+
+#ifndef FALSESHARINGDETECTOR_H_
+#define FALSESHARINGDETECTOR_H_
+
+#include <boost/dynamic_bitset.hpp>
+#include <boost/unordered_map.hpp>
+#include <iostream>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "AccessObserver.h"
+#include "AccessRecord.h"
+#include "Address.h"
+
+/**
+ * A pair of threads that falsely share a line.
+ */
+struct FalseSharingReport {
+  ADDRESS address;
+  uint16_t thread_a;
+  uint16_t thread_b;
+  // The bytes of the line each thread accessed.
+  boost::dynamic_bitset<> bytes_a;
+  boost::dynamic_bitset<> bytes_b;
+  // The number of times the line moved from one thread to the other although
+  // the thread receiving it did not access the bytes the other had written.
+  uint64_t ping_pongs;
+  // The number of times the line moved between the threads for bytes that
+  // the other had written.
+  uint64_t true_sharing_transfers;
+};
+
+/**
+ * Detects false sharing from per-thread byte masks of each line.
+ *
+ * A line moves between threads when a thread accesses it after another
+ * thread wrote it. If the bytes accessed do not overlap the bytes the last
+ * writer wrote, the move is caused by false sharing.
+ *
+ * Most lines are only ever accessed by one thread, so a line keeps just the
+ * bytes of that thread until a second thread accesses it.
+ */
+class FalseSharingDetector: public AccessObserver {
+private:
+  struct ThreadBytes {
+    uint16_t thread_id;
+    boost::dynamic_bitset<> read_bytes;
+    boost::dynamic_bitset<> written_bytes;
+    // The write count of the line when the thread last accessed it: the
+    // write count of a line only this thread accessed.
+    uint64_t last_seen;
+  };
+
+  struct Transfers {
+    uint64_t false_sharing;
+    uint64_t true_sharing;
+  };
+
+  struct SharedLine {
+    // One entry per thread that accessed the line. Few threads touch a line,
+    // so a vector is searched.
+    std::vector<ThreadBytes> threads;
+    uint64_t n_writes;
+    uint16_t last_writer;
+    // Keyed by the pair of threads, the smaller id first.
+    std::map<std::pair<uint16_t, uint16_t>, Transfers> transfers;
+  };
+
+  boost::unordered_map<ADDRESS, SharedLine> lines;
+  // The lines one thread accessed, not in lines.
+  boost::unordered_map<ADDRESS, ThreadBytes> private_lines;
+  const uint16_t line_size_B;
+
+private:
+  /**
+   * Returns the bytes of a thread that has not accessed a line of n_writes
+   * writes.
+   */
+  ThreadBytes NewThreadBytes(const uint16_t thread_id,
+      const uint64_t n_writes) const;
+
+  /**
+   * Adds the bytes of access, from start to end in the line, to bytes.
+   * Returns whether the access writes them.
+   */
+  static bool AddBytes(ThreadBytes& bytes, const AccessRecord& access,
+      const uint32_t start, const uint32_t end);
+
+  /**
+   * Returns the bytes of line accessed by thread_id, adding an entry for the
+   * thread if it has not accessed the line before.
+   */
+  ThreadBytes& GetThreadBytes(SharedLine& line, const uint16_t thread_id);
+
+public:
+  /**
+   * Constructs a FalseSharingDetector for lines of line_size_B bytes.
+   */
+  FalseSharingDetector(const uint16_t line_size_B);
+  virtual ~FalseSharingDetector();
+
+  void Observe(const AccessRecord& access, const ADDRESS line_address);
+
+  /**
+   * Returns every pair of threads that falsely shared a line, the pair with
+   * the most ping-pongs first.
+   */
+  std::vector<FalseSharingReport> GetFalseSharing() const;
+
+  /**
+   * Returns the number of lines accessed by more than one thread.
+   */
+  size_t GetSharedLineCount() const {
+    return lines.size();
+  }
+
+  /**
+   * Writes one row per falsely shared line and pair of threads.
+   */
+  friend std::ostream& operator<<(std::ostream& stream,
+      const FalseSharingDetector& detector);
+};
+
+#endif /* FALSESHARINGDETECTOR_H_ */
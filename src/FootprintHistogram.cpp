@@ -0,0 +1,164 @@
+/*
+ * FootprintHistogram.cpp
+ *
+ *  Created on: Sep 15, 2016
+ *      Author: vance
+ */
+
+#include "FootprintHistogram.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+bool MoreLines(const FootprintCount& a, const FootprintCount& b) {
+  if (a.count != b.count) {
+    return a.count > b.count;
+  }
+  return a.footprint < b.footprint;
+}
+
+}
+
+FootprintHistogram::FootprintHistogram(const uint16_t line_size_B,
+    const size_t n_entries) :
+    n_entries(n_entries), line_size_B(line_size_B),
+    granule_B((line_size_B + 63) / 64), n_lines(0) {
+  if (n_entries == 0) {
+    throw std::invalid_argument("A footprint histogram needs entries.");
+  }
+  entries.reserve(n_entries);
+  run_lengths.resize(line_size_B, 0);
+  run_counts.resize(line_size_B / 2 + 2, 0);
+  first_offsets.resize(line_size_B, 0);
+}
+
+FootprintHistogram::~FootprintHistogram() {
+}
+
+void FootprintHistogram::Count(const uint64_t footprint, const uint64_t count,
+    const uint64_t error) {
+  boost::unordered_map<uint64_t, size_t>::iterator index = indexes.find(
+      footprint);
+  if (index != indexes.end()) {
+    entries[index->second].count += count;
+    entries[index->second].error += error;
+    return;
+  }
+  if (entries.size() < n_entries) {
+    FootprintCount entry = { footprint, count, error };
+    indexes[footprint] = entries.size();
+    entries.push_back(entry);
+    return;
+  }
+  // The new footprint takes over the least counted one, which it may have
+  // been every time.
+  size_t min = 0;
+  for (size_t i = 1; i < entries.size(); i++) {
+    if (entries[i].count < entries[min].count) {
+      min = i;
+    }
+  }
+  FootprintCount& entry = entries[min];
+  indexes.erase(entry.footprint);
+  indexes[footprint] = min;
+  entry.footprint = footprint;
+  entry.error = entry.count + error;
+  entry.count += count;
+}
+
+void FootprintHistogram::Record(const boost::dynamic_bitset<>& accessed_bytes,
+    const uint8_t first_offset) {
+  size_t start = accessed_bytes.find_first();
+  if (start == boost::dynamic_bitset<>::npos) {
+    return;
+  }
+  uint64_t footprint = 0;
+  size_t n_runs = 0;
+  while (start != boost::dynamic_bitset<>::npos) {
+    size_t end = start;
+    while (end + 1 < accessed_bytes.size() && accessed_bytes[end + 1]) {
+      end++;
+    }
+    for (size_t granule = start / granule_B; granule <= end / granule_B;
+        granule++) {
+      footprint |= ((uint64_t) 1) << granule;
+    }
+    run_lengths[end - start]++;
+    n_runs++;
+    start = accessed_bytes.find_next(end);
+  }
+  run_counts[n_runs]++;
+  first_offsets[first_offset]++;
+  n_lines++;
+  Count(footprint, 1, 0);
+}
+
+void FootprintHistogram::Merge(const FootprintHistogram& other) {
+  if (other.line_size_B != line_size_B) {
+    throw std::invalid_argument("The histograms' line sizes differ.");
+  }
+  for (size_t i = 0; i < other.entries.size(); i++) {
+    Count(other.entries[i].footprint, other.entries[i].count,
+        other.entries[i].error);
+  }
+  n_lines += other.n_lines;
+  for (size_t i = 0; i < run_lengths.size(); i++) {
+    run_lengths[i] += other.run_lengths[i];
+    first_offsets[i] += other.first_offsets[i];
+  }
+  for (size_t i = 0; i < run_counts.size(); i++) {
+    run_counts[i] += other.run_counts[i];
+  }
+}
+
+std::vector<FootprintCount> FootprintHistogram::GetTop() const {
+  std::vector<FootprintCount> top(entries);
+  std::sort(top.begin(), top.end(), MoreLines);
+  return top;
+}
+
+std::ostream& operator<<(std::ostream& stream,
+    const FootprintHistogram& histogram) {
+  const std::vector<FootprintCount> top = histogram.GetTop();
+  const uint16_t n_granules = (histogram.line_size_B
+      + histogram.granule_B - 1) / histogram.granule_B;
+  const int width = std::max<int>(n_granules, 10);
+  stream << "Footprints of " << histogram.n_lines << " lines, "
+      << histogram.granule_B << " B per granule" << std::endl;
+  stream << std::left << std::setw(width) << "Footprint" << std::right
+      << std::setw(12) << "Lines"
+      << std::setw(12) << "Error" << std::setw(12) << "Share" << std::endl;
+  for (size_t i = 0; i < top.size(); i++) {
+    for (uint16_t granule = 0; granule < n_granules; granule++) {
+      stream << ((top[i].footprint >> granule) & 1 ? 'x' : '.');
+    }
+    stream << std::string(width - n_granules, ' ') << std::setw(12)
+        << top[i].count << std::setw(12) << top[i].error
+        << std::setw(12) << (double) top[i].count / histogram.n_lines
+        << std::endl;
+  }
+
+  uint64_t n_runs = 0;
+  uint64_t run_B = 0;
+  for (size_t i = 0; i < histogram.run_lengths.size(); i++) {
+    n_runs += histogram.run_lengths[i];
+    run_B += histogram.run_lengths[i] * (i + 1);
+  }
+  stream << "Runs per line: "
+      << (histogram.n_lines ? (double) n_runs / histogram.n_lines : 0)
+      << ", Run length: " << (n_runs ? (double) run_B / n_runs : 0)
+      << " B, Single run lines: " << histogram.run_counts[1] << std::endl;
+  stream << std::setw(12) << "FirstOffset" << std::setw(12) << "Lines"
+      << std::endl;
+  for (size_t i = 0; i < histogram.first_offsets.size(); i++) {
+    if (histogram.first_offsets[i]) {
+      stream << std::setw(12) << i << std::setw(12)
+          << histogram.first_offsets[i] << std::endl;
+    }
+  }
+  return stream;
+}
@@ -0,0 +1,112 @@
+/*
+ * FootprintHistogram.h
+ *
+ *  Created on: Sep 15, 2016
+ *      Author: vance
+ */
+
+#ifndef FOOTPRINTHISTOGRAM_H_
+#define FOOTPRINTHISTOGRAM_H_
+
+#include <boost/dynamic_bitset.hpp>
+#include <boost/unordered_map.hpp>
+#include <iostream>
+#include <stdint.h>
+#include <vector>
+
+#define DEFAULT_FOOTPRINT_ENTRIES 64
+
+/**
+ * A footprint and the number of lines that left the hierarchy with it.
+ */
+struct FootprintCount {
+  // Bit i is set iff granule i of the line was accessed.
+  uint64_t footprint;
+  // An overestimate of the lines with the footprint, by at most error.
+  uint64_t count;
+  uint64_t error;
+};
+
+/**
+ * Counts which bytes of the evicted lines were accessed, not only how many:
+ * 8 bytes at the start of a line and 8 bytes scattered across it call for
+ * different fixes, eg. splitting a struct or reordering its fields.
+ *
+ * The footprint of a line is a mask of its accessed granules, a granule
+ * being a byte in lines of up to 64 bytes. There are too many footprints to
+ * count them all, so the most frequent ones are kept in a space-saving
+ * summary of n_entries counters: a footprint that is not counted replaces
+ * the least counted one and inherits its count as error. Any footprint seen
+ * more than n_lines / n_entries times is counted.
+ *
+ * The run lengths, run counts and first offsets are exact and counted in
+ * bytes whatever the granule.
+ */
+class FootprintHistogram {
+private:
+  std::vector<FootprintCount> entries;
+  // Maps a footprint to its index in entries.
+  boost::unordered_map<uint64_t, size_t> indexes;
+  const size_t n_entries;
+  const uint16_t line_size_B;
+  const uint16_t granule_B;
+
+private:
+  /**
+   * Adds count lines with footprint, count - error of which are certain.
+   */
+  void Count(const uint64_t footprint, const uint64_t count,
+      const uint64_t error);
+
+public:
+  // The lines recorded.
+  uint64_t n_lines;
+  // Entry i counts the runs of i + 1 contiguous accessed bytes.
+  std::vector<uint64_t> run_lengths;
+  // Entry i counts the lines with i runs of accessed bytes.
+  std::vector<uint64_t> run_counts;
+  // Entry i counts the lines whose first access started at byte i.
+  std::vector<uint64_t> first_offsets;
+
+  /**
+   * Constructs a FootprintHistogram for lines of line_size_B bytes, at most
+   * 64 granules, that counts the n_entries most frequent footprints.
+   */
+  FootprintHistogram(const uint16_t line_size_B,
+      const size_t n_entries = DEFAULT_FOOTPRINT_ENTRIES);
+  virtual ~FootprintHistogram();
+
+  /**
+   * Returns the number of bytes of a line each bit of a footprint stands for.
+   */
+  uint16_t GetGranuleSize() const {
+    return granule_B;
+  }
+
+  /**
+   * Records a line with accessed_bytes accessed, the first access starting
+   * at first_offset. Lines with no byte accessed are not recorded.
+   */
+  void Record(const boost::dynamic_bitset<>& accessed_bytes,
+      const uint8_t first_offset);
+
+  /**
+   * Adds the lines recorded by other, eg. by another shard, to these. The
+   * footprints other did not count stay uncounted.
+   */
+  void Merge(const FootprintHistogram& other);
+
+  /**
+   * Returns the footprints counted, the most frequent first.
+   */
+  std::vector<FootprintCount> GetTop() const;
+
+  /**
+   * Writes one row per footprint counted, with 'x' for an accessed granule
+   * and '.' for another, followed by the run and first offset statistics.
+   */
+  friend std::ostream& operator<<(std::ostream& stream,
+      const FootprintHistogram& histogram);
+};
+
+#endif /* FOOTPRINTHISTOGRAM_H_ */
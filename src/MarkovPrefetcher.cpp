@@ -0,0 +1,129 @@
+/*
+ * MarkovPrefetcher.cpp
+ *
+ *  Created on: Sep 14, 2016
+ *      Author: vance
+ */
+
+#include "MarkovPrefetcher.h"
+
+#include <stdexcept>
+
+MarkovPrefetcher::MarkovPrefetcher(const uint16_t line_size_B,
+    const uint32_t n_entries, const uint32_t associativity,
+    const uint32_t width, const uint32_t depth) :
+    n_bits_offset(line_size_B ? __builtin_ctz(line_size_B) : 0),
+        associativity(associativity), width(width), depth(depth), n_sets(
+        associativity ? n_entries / associativity : 0), has_last_line(false),
+        last_line(0), n_accesses(0), n_lookups(0), n_table_hits(0) {
+  if (associativity == 0 || n_sets == 0 || n_entries % associativity
+      || n_sets & (n_sets - 1)) {
+    throw std::invalid_argument(
+        "A Markov table needs a power of two number of sets.");
+  }
+  if (width == 0 || width > UINT8_MAX) {
+    throw std::invalid_argument(
+        "A Markov entry keeps between 1 and 255 successors.");
+  }
+  Entry empty;
+  empty.line = 0;
+  empty.last_use = 0;
+  empty.n_successors = 0;
+  empty.valid = false;
+  entries.resize(n_entries, empty);
+  successors.resize((size_t) n_entries * width, 0);
+}
+
+MarkovPrefetcher::~MarkovPrefetcher() {
+}
+
+int64_t MarkovPrefetcher::Find(const ADDRESS line) const {
+  const size_t first = (size_t) (line & (n_sets - 1)) * associativity;
+  for (size_t i = first; i < first + associativity; i++) {
+    if (entries[i].valid && entries[i].line == line) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+void MarkovPrefetcher::Record(const ADDRESS line, const ADDRESS successor) {
+  int64_t index = Find(line);
+  if (index < 0) {
+    const size_t first = (size_t) (line & (n_sets - 1)) * associativity;
+    index = first;
+    for (size_t i = first + 1;
+        i < first + associativity && entries[index].valid; i++) {
+      if (!entries[i].valid || entries[i].last_use < entries[index].last_use) {
+        index = i;
+      }
+    }
+    entries[index].line = line;
+    entries[index].n_successors = 0;
+    entries[index].valid = true;
+  }
+  Entry& entry = entries[index];
+  entry.last_use = n_accesses;
+
+  // Move the successor to the front, dropping the oldest if it is new.
+  ADDRESS* const lines = &successors[index * width];
+  uint32_t position = 0;
+  while (position < entry.n_successors && lines[position] != successor) {
+    position++;
+  }
+  if (position == entry.n_successors) {
+    if (entry.n_successors < width) {
+      entry.n_successors++;
+    } else {
+      position--;
+    }
+  }
+  for (; position > 0; position--) {
+    lines[position] = lines[position - 1];
+  }
+  lines[0] = successor;
+}
+
+void MarkovPrefetcher::Train(const ADDRESS address, const ADDRESS pc,
+    const bool miss, std::vector<ADDRESS>& prefetches) {
+  if (!miss) {
+    return;
+  }
+  const ADDRESS line = address >> n_bits_offset;
+  n_accesses++;
+  if (has_last_line && last_line != line) {
+    Record(last_line, line);
+  }
+  has_last_line = true;
+  last_line = line;
+
+  n_lookups++;
+  int64_t index = Find(line);
+  if (index < 0) {
+    return;
+  }
+  n_table_hits++;
+  entries[index].last_use = n_accesses;
+  const Entry& entry = entries[index];
+  for (uint32_t i = 0; i < entry.n_successors; i++) {
+    prefetches.push_back(successors[index * width + i] << n_bits_offset);
+  }
+  for (uint32_t step = 1; step < depth; step++) {
+    index = Find(successors[index * width]);
+    if (index < 0) {
+      break;
+    }
+    prefetches.push_back(successors[index * width] << n_bits_offset);
+  }
+}
+
+uint64_t MarkovPrefetcher::GetStorageBytes() const {
+  const uint32_t line_bits = sizeof(ADDRESS) * 8 - n_bits_offset;
+  const uint32_t tag_bits = line_bits - __builtin_ctz(n_sets);
+  const uint32_t lru_bits = associativity > 1 ?
+      32 - __builtin_clz(associativity - 1) : 0;
+  // A valid bit, the tag, the LRU state and the successors with their count.
+  const uint64_t entry_bits = 1 + tag_bits + lru_bits
+      + (32 - __builtin_clz(width)) + (uint64_t) width * line_bits;
+  return (entry_bits * entries.size() + 7) / 8;
+}
@@ -0,0 +1,93 @@
+/*
+ * MarkovPrefetcher.h
+ *
+ *  Created on: Sep 14, 2016
+ *      Author: vance
+ */
+
+#ifndef MARKOVPREFETCHER_H_
+#define MARKOVPREFETCHER_H_
+
+#include <stdint.h>
+#include <vector>
+
+#include "Address.h"
+#include "Prefetcher.h"
+
+#define DEFAULT_MARKOV_ENTRIES 4096
+#define DEFAULT_MARKOV_ASSOCIATIVITY 8
+#define DEFAULT_MARKOV_WIDTH 2
+
+/**
+ * A Markov correlation prefetcher: learns which line misses after which, and
+ * prefetches the lines that followed the last time a line missed. Unlike a
+ * stride, the correlation holds for pointer chains, eg. the nodes of a tree
+ * or the buckets of a hash table, as long as they are walked in the same
+ * order again.
+ *
+ * The table is set associative with LRU replacement. Each entry is tagged
+ * with a line and holds its most recent successors, most recent first. Only
+ * misses and first uses of prefetched lines train the table, so that a
+ * covered chain keeps training it.
+ */
+class MarkovPrefetcher: public Prefetcher {
+private:
+  struct Entry {
+    ADDRESS line;
+    uint64_t last_use;
+    uint8_t n_successors;
+    bool valid;
+  };
+
+  const uint8_t n_bits_offset;
+  const uint32_t associativity;
+  const uint32_t width;
+  const uint32_t depth;
+  const uint32_t n_sets;
+  std::vector<Entry> entries;
+  // The successors of entry i are at i * width.
+  std::vector<ADDRESS> successors;
+  bool has_last_line;
+  ADDRESS last_line;
+  uint64_t n_accesses;
+
+private:
+  /**
+   * Returns the index of the entry of line, or -1.
+   */
+  int64_t Find(const ADDRESS line) const;
+
+  /**
+   * Records that successor missed after line.
+   */
+  void Record(const ADDRESS line, const ADDRESS successor);
+
+public:
+  // The misses the table was looked up for.
+  uint64_t n_lookups;
+  // Of those, the misses that found an entry.
+  uint64_t n_table_hits;
+
+  /**
+   * Constructs a MarkovPrefetcher for lines of line_size_B bytes.
+   *
+   * @param n_entries the lines the table correlates, a power of two multiple
+   *     of the associativity.
+   * @param associativity the ways of the table.
+   * @param width the successors kept per line, all of which are prefetched.
+   * @param depth the steps the prefetcher follows the most recent successor,
+   *     prefetching one line per further step.
+   */
+  MarkovPrefetcher(const uint16_t line_size_B, const uint32_t n_entries =
+      DEFAULT_MARKOV_ENTRIES, const uint32_t associativity =
+      DEFAULT_MARKOV_ASSOCIATIVITY, const uint32_t width =
+      DEFAULT_MARKOV_WIDTH, const uint32_t depth = 1);
+  virtual ~MarkovPrefetcher();
+
+  void Train(const ADDRESS address, const ADDRESS pc, const bool miss,
+      std::vector<ADDRESS>& prefetches);
+
+  uint64_t GetStorageBytes() const;
+};
+
+#endif /* MARKOVPREFETCHER_H_ */
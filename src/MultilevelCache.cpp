@@ -9,136 +9,1019 @@
 
 #include <algorithm>
 #include <boost/dynamic_bitset.hpp>
+#include <iomanip>
 #include <math.h>
+#include <sstream>
 #include <stdexcept>
 #include <stddef.h>
 
 MultilevelCache::MultilevelCache(const std::vector<uint64_t>& capacities_B,
     const std::vector<uint16_t>& associativities, const uint16_t line_size_B) :
-    n_levels(capacities_B.size()), line_size_B(line_size_B) {
+    footprints(line_size_B), n_levels(capacities_B.size()), n_cores(1),
+    line_size_B(line_size_B) {
+  Build(capacities_B, associativities, 0, 0);
+}
+
+MultilevelCache::MultilevelCache(const std::vector<uint64_t>& capacities_B,
+    const std::vector<uint16_t>& associativities,
+    const uint64_t l1i_capacity_B, const uint16_t l1i_associativity,
+    const uint16_t line_size_B) :
+    footprints(line_size_B), n_levels(capacities_B.size()), n_cores(1),
+    line_size_B(line_size_B) {
+  if (l1i_capacity_B == 0) {
+    throw std::invalid_argument("The L1 instruction cache must have capacity.");
+  }
+  Build(capacities_B, associativities, l1i_capacity_B, l1i_associativity);
+}
+
+MultilevelCache::MultilevelCache(const uint8_t n_cores,
+    const std::vector<uint64_t>& capacities_B,
+    const std::vector<uint16_t>& associativities, const uint16_t line_size_B) :
+    footprints(line_size_B), n_levels(capacities_B.size()),
+    n_cores(n_cores), line_size_B(line_size_B) {
+  Build(capacities_B, associativities, 0, 0);
+}
+
+MultilevelCache::MultilevelCache(const uint8_t n_cores,
+    const std::vector<uint64_t>& capacities_B,
+    const std::vector<uint16_t>& associativities,
+    const uint64_t l1i_capacity_B, const uint16_t l1i_associativity,
+    const uint16_t line_size_B) :
+    footprints(line_size_B), n_levels(capacities_B.size()),
+    n_cores(n_cores), line_size_B(line_size_B) {
+  if (l1i_capacity_B == 0) {
+    throw std::invalid_argument("The L1 instruction cache must have capacity.");
+  }
+  Build(capacities_B, associativities, l1i_capacity_B, l1i_associativity);
+}
+
+uint8_t MultilevelCache::AddCache(const uint64_t capacity_B,
+    const uint16_t associativity, const uint8_t level, const uint8_t core) {
+  const uint8_t index = caches.size();
+  caches.push_back(Cache::Create(capacity_B, associativity, line_size_B));
+  cache_cores.push_back(core);
+  level_caches[level] |= ((LEVEL_MASK) 1) << index;
+  return index;
+}
+
+void MultilevelCache::Build(const std::vector<uint64_t>& capacities_B,
+    const std::vector<uint16_t>& associativities,
+    const uint64_t l1i_capacity_B, const uint16_t l1i_associativity) {
   if (capacities_B.size() != associativities.size()) {
     throw std::invalid_argument(
         "Capacity and associativity arguments must be the same length.");
   }
+  if (capacities_B.empty()) {
+    throw std::invalid_argument("A cache needs at least one level.");
+  }
+  if (n_cores == 0) {
+    throw std::invalid_argument("A cache needs at least one core.");
+  }
+  split_l1 = l1i_capacity_B != 0;
+  if ((split_l1 || n_cores > 1) && capacities_B.size() < 2) {
+    throw std::invalid_argument(
+        "Split or private caches require a shared last level.");
+  }
+  if (n_cores * (capacities_B.size() - 1 + split_l1) + 1 > MAX_LEVELS) {
+    throw std::invalid_argument("Too many caches.");
+  }
+  inclusion_policy = INCLUSION_POLICY_LRU;
+  max_queries = UINT32_MAX;
+  n_write_combining_buffers = DEFAULT_WRITE_COMBINING_BUFFERS;
   hits = 0;
   misses = 0;
-  std::vector<uint64_t>::const_iterator cap = capacities_B.begin();
-  std::vector<uint16_t>::const_iterator ass = associativities.begin();
-  int level = 1;
-  while (cap != capacities_B.end()) {
-    caches.push_back(Cache::Create(*cap, *ass, line_size_B));
-    cap++;
-    ass++;
-    level++;
+  inclusion_victims_avoided = 0;
+  temporal_locality_hints = 0;
+  write_combining_flushes = 0;
+  write_combining_partial_flushes = 0;
+  write_combining_bytes = 0;
+  has_prefetchers = false;
+  prefetch_latency = DEFAULT_PREFETCH_LATENCY;
+  prefetching = false;
+  pc_attribution = NULL;
+  data_objects = NULL;
+
+  // Core 0's data path takes the indexes 0 to n_levels - 1, the LLC
+  // included, so the caches of a single-core hierarchy are indexed by level.
+  level_caches.resize(n_levels, 0);
+  data_paths.resize(n_cores);
+  for (uint8_t core = 0; core < n_cores; core++) {
+    for (uint8_t level = 0; level < n_levels; level++) {
+      if (level < n_levels - 1) {
+        data_paths[core].push_back(
+            AddCache(capacities_B[level], associativities[level], level,
+                core));
+      } else if (core == 0) {
+        llc = AddCache(capacities_B[level], associativities[level], level,
+            NO_CORE);
+        data_paths[core].push_back(llc);
+      } else {
+        data_paths[core].push_back(llc);
+      }
+    }
+  }
+  instruction_paths = data_paths;
+  if (split_l1) {
+    for (uint8_t core = 0; core < n_cores; core++) {
+      instruction_paths[core][0] = AddCache(l1i_capacity_B, l1i_associativity,
+          0, core);
+    }
+  }
+
+  lower_caches.resize(caches.size(), NO_CACHE);
+  for (uint8_t core = 0; core < n_cores; core++) {
+    for (uint8_t level = 0; level < n_levels - 1; level++) {
+      lower_caches[data_paths[core][level]] = data_paths[core][level + 1];
+      lower_caches[instruction_paths[core][level]] =
+          instruction_paths[core][level + 1];
+    }
+  }
+  core_caches.resize(n_cores, 0);
+  for (uint8_t cache = 0; cache < caches.size(); cache++) {
+    if (cache_cores[cache] != NO_CORE) {
+      core_caches[cache_cores[cache]] |= ((LEVEL_MASK) 1) << cache;
+    }
+  }
+  upper_caches.resize(caches.size(), 0);
+  for (uint8_t cache = 0; cache < caches.size(); cache++) {
+    for (uint8_t lower = lower_caches[cache]; lower != NO_CACHE; lower =
+        lower_caches[lower]) {
+      upper_caches[lower] |= ((LEVEL_MASK) 1) << cache;
+    }
   }
 
   byte_utilizations.resize(line_size_B, 0);
+  prefetched_byte_utilizations.resize(line_size_B, 0);
+  resident_byte_utilizations.resize(line_size_B, 0);
+  level_byte_utilizations.resize(caches.size(),
+      std::vector<uint64_t>(line_size_B + 1, 0));
+  inclusion_victims.resize(caches.size(), 0);
+  LevelCounters empty_counters = LevelCounters();
+  level_counters.resize(caches.size(), empty_counters);
+  prefetches.resize(caches.size(), 0);
+  useful_prefetches.resize(caches.size(), 0);
+  late_prefetches.resize(caches.size(), 0);
+  useless_prefetches.resize(caches.size(), 0);
+  prefetch_pollution.resize(caches.size(), 0);
+  prefetchers.resize(caches.size());
+  in_flight_prefetches.resize(caches.size());
+  prefetch_victims.resize(caches.size());
+  early_invalidations.resize(caches.size(), 0);
+  write_back_bytes.resize(caches.size(), 0);
+  write_back_dirty_bytes.resize(caches.size(), 0);
+  write_through_bytes.resize(caches.size(), 0);
+  non_temporal_invalidations.resize(caches.size(), 0);
+  coherence_invalidations.resize(caches.size(), 0);
+  core_hits.resize(n_cores, 0);
+  core_misses.resize(n_cores, 0);
+  private_misses.resize(n_cores, 0);
+  coherence_misses.resize(n_cores, 0);
+  core_invalidations.resize(n_cores, 0);
+  core_downgrades.resize(n_cores, 0);
+  core_upgrades.resize(n_cores, 0);
+  cache_to_cache_transfers.resize(n_cores, 0);
+
+  WritePolicy write_policy;
+  write_policy.hit = WRITE_BACK;
+  write_policy.miss = WRITE_ALLOCATE;
+  write_policies.resize(caches.size(), write_policy);
 }
 
 MultilevelCache::~MultilevelCache() {
+  Finalize();
   for (std::vector<Cache*>::iterator it = caches.begin(); it < caches.end();
       it++) {
     delete (*it);
   }
 }
 
+const uint8_t MultilevelCache::GetCacheLevel(const uint8_t cache) const {
+  uint8_t level = 0;
+  while (!((level_caches.at(level) >> cache) & 1)) {
+    level++;
+  }
+  return level;
+}
+
+const std::string MultilevelCache::GetCacheName(const uint8_t cache) const {
+  std::ostringstream name;
+  if (n_cores > 1 && cache_cores[cache] != NO_CORE) {
+    name << "C" << (int) cache_cores[cache] << ".";
+  }
+  name << "L" << 1 + (int) GetCacheLevel(cache);
+  if (split_l1 && GetCacheLevel(cache) == 0) {
+    name << (cache == instruction_paths[cache_cores[cache]][0] ? "I" : "D");
+  }
+  return name.str();
+}
+
+void MultilevelCache::SetInclusionPolicy(const InclusionPolicy policy,
+    const uint32_t max_queries) {
+  inclusion_policy = policy;
+  this->max_queries = max_queries;
+}
+
+void MultilevelCache::SetWritePolicy(const uint8_t cache,
+    const WriteHitPolicy hit, const WriteMissPolicy miss) {
+  write_policies.at(cache).hit = hit;
+  write_policies.at(cache).miss = miss;
+}
+
+void MultilevelCache::SetWriteCombiningBuffers(const uint32_t n_buffers) {
+  n_write_combining_buffers = n_buffers;
+  while (write_combining_buffers.size() > n_write_combining_buffers) {
+    FlushWriteCombiningBuffer(write_combining_buffers.front());
+    write_combining_buffers.pop_front();
+  }
+}
+
+void MultilevelCache::FlushWriteCombiningBuffers() {
+  while (!write_combining_buffers.empty()) {
+    FlushWriteCombiningBuffer(write_combining_buffers.front());
+    write_combining_buffers.pop_front();
+  }
+}
+
+void MultilevelCache::Finalize() {
+  FlushWriteCombiningBuffers();
+  prefetch_requests.clear();
+  for (uint8_t cache = 0; cache < caches.size(); cache++) {
+    in_flight_prefetches[cache].clear();
+    prefetch_victims[cache].clear();
+  }
+
+  // Drain the upper levels first: the lines are destroyed with the LLC's.
+  std::vector<CacheLine*> lines;
+  for (uint8_t level = 0; level < n_levels; level++) {
+    LEVEL_MASK level_mask = level_caches[level];
+    while (level_mask) {
+      const uint8_t cache = __builtin_ctzll(level_mask);
+      LevelCounters& counters = level_counters[cache];
+      caches[cache]->Drain(lines);
+      counters.resident_lines += lines.size();
+      for (size_t i = 0; i < lines.size(); i++) {
+        CacheLine* const line = lines[i];
+        counters.resident_used_bytes += line->ClearLevelAccesses(cache);
+        line->ClearPresent(cache);
+        if (lower_caches[cache] == NO_CACHE) {
+          const size_t utilization = line->getAccessedBytes().count();
+          if (pc_attribution != NULL
+              && !line->HasFlag(LINE_FLAG_PREFETCH_FILLED)) {
+            pc_attribution->Resident(line->GetFillPc(), utilization);
+          }
+          if (data_objects != NULL && utilization
+              && !line->HasFlag(LINE_FLAG_PREFETCH_FILLED)) {
+            data_objects->Resident(line->address + line->GetFirstOffset(),
+                utilization);
+          }
+          if (utilization) {
+            resident_byte_utilizations.at(utilization - 1)++;
+          }
+          delete line;
+        }
+      }
+      lines.clear();
+      level_mask &= level_mask - 1;
+    }
+  }
+}
+
+void MultilevelCache::AddObserver(AccessObserver* const observer) {
+  observers.push_back(observer);
+}
+
+void MultilevelCache::AddPrefetcher(const uint8_t cache,
+    Prefetcher* const prefetcher) {
+  prefetchers.at(cache).push_back(prefetcher);
+  has_prefetchers = true;
+}
+
+void MultilevelCache::SetPrefetchLatency(const uint32_t n_accesses) {
+  prefetch_latency = n_accesses;
+}
+
+void MultilevelCache::SetPcAttribution(PcAttribution* const attribution) {
+  pc_attribution = attribution;
+}
+
+void MultilevelCache::SetDataObjects(DataObjectMap* const objects) {
+  data_objects = objects;
+}
+
 std::vector<CacheLine*>& MultilevelCache::Access(const ADDRESS address,
-    const uint8_t n_bytes) {
-  return SplitAccess(address, n_bytes);
+    const uint8_t n_bytes, const AccessType type) {
+  return Access(AccessRecord(address, n_bytes, type));
 }
 
-std::vector<CacheLine*>& MultilevelCache::SplitAccess(const ADDRESS address,
-    const uint8_t size) {
+std::vector<CacheLine*>& MultilevelCache::Access(const AccessRecord& record) {
   std::vector<CacheLine*>* accessed_lines = new std::vector<CacheLine*>;
+  SplitAccess(record, accessed_lines);
+  return *accessed_lines;
+}
+
+uint64_t MultilevelCache::Simulate(AccessStream& stream) {
+  uint64_t n_records = 0;
+  AccessRecord record;
+  while (stream.Next(record)) {
+    SplitAccess(record, NULL);
+    n_records++;
+  }
+  return n_records;
+}
+
+void MultilevelCache::Simulate(const AccessRecord& record) {
+  SplitAccess(record, NULL);
+}
+
+void MultilevelCache::FetchBlock(const ADDRESS address,
+    const uint32_t n_bytes, const uint16_t thread_id) {
+  ADDRESS fetch_address = address;
+  uint32_t bytes_remaining = n_bytes;
+  while (bytes_remaining > 0) {
+    const uint32_t bytes_to_end_of_line = line_size_B
+        - caches.front()->GetLineOffset(fetch_address);
+    const uint8_t fetch_size =
+        bytes_remaining < bytes_to_end_of_line ?
+            bytes_remaining : bytes_to_end_of_line;
+    InclusiveAccess(fetch_address, fetch_size, ACCESS_IFETCH, HINT_NONE,
+        thread_id % n_cores, fetch_address);
+    if (!observers.empty()) {
+      Notify(AccessRecord(fetch_address, fetch_size, ACCESS_IFETCH, HINT_NONE,
+          thread_id), fetch_address, fetch_size);
+    }
+    fetch_address += fetch_size;
+    bytes_remaining -= fetch_size;
+  }
+}
+
+void MultilevelCache::SplitAccess(const AccessRecord& record,
+    std::vector<CacheLine*>* const accessed_lines) {
+  if (record.type >= ACCESS_ALLOC) {
+    // An event of the trace: no line is accessed.
+    if (data_objects != NULL) {
+      if (record.type == ACCESS_ALLOC) {
+        data_objects->Allocate(record.address, record.size, record.pc);
+      } else {
+        data_objects->Free(record.address);
+      }
+    }
+    return;
+  }
+  const ADDRESS address = record.address;
+  const uint8_t core = record.thread_id % n_cores;
+  const uint32_t size = record.size;
 
   // We need to compute the line offset for the access address. This is computable
   // via a Cache object. The line offset for an address is the same across all caches
   // because the line size is fixed, so we can choose any cache for this. Choose L1.
   const Cache* const L1 = caches.at(0);
   uint32_t bytes_to_end_of_line = line_size_B - L1->GetLineOffset(address);
-  uint8_t bytes_accessed = 0;
-  uint8_t bytes_remaining = size;
+  uint32_t bytes_accessed = 0;
+  uint32_t bytes_remaining = size;
 
   do {
-    uint8_t access_size = (
+    // At most a line.
+    const uint32_t access_size = (
         bytes_remaining < bytes_to_end_of_line ?
             bytes_remaining : bytes_to_end_of_line);
 
-    accessed_lines->push_back(
-        &InclusiveAccess(address + bytes_accessed, access_size));
+    CacheLine* line = NULL;
+    if (record.type == ACCESS_STORE && (record.hints & HINT_NON_TEMPORAL)) {
+      NonTemporalStore(address + bytes_accessed, access_size);
+    } else {
+      line = InclusiveAccess(address + bytes_accessed, access_size,
+          (AccessType) record.type, record.hints, core, record.pc);
+    }
+    if (accessed_lines != NULL) {
+      accessed_lines->push_back(line);
+    }
+    if (!observers.empty()) {
+      Notify(record, address + bytes_accessed, access_size);
+    }
 
     bytes_accessed += access_size;
     bytes_remaining -= access_size;
     bytes_to_end_of_line =
         bytes_remaining < line_size_B ? bytes_remaining : line_size_B;
   } while (bytes_remaining > 0);
-  return *accessed_lines;
 }
 
-CacheLine& MultilevelCache::InclusiveAccess(const ADDRESS address,
-    const uint8_t size_B) {
+void MultilevelCache::Notify(const AccessRecord& record,
+    const ADDRESS address, const uint32_t size_B) {
+  AccessRecord access = record;
+  access.address = address;
+  access.size = size_B;
+  const ADDRESS line_address = address - caches.front()->GetLineOffset(
+      address);
+  for (size_t i = 0; i < observers.size(); i++) {
+    observers[i]->Observe(access, line_address);
+  }
+}
+
+CacheLine* MultilevelCache::InclusiveAccess(const ADDRESS address,
+    const uint8_t size_B, const AccessType type, const uint8_t hints,
+    const uint8_t core, const ADDRESS pc) {
   CacheLine* requested = NULL;
+  const std::vector<uint8_t>& path =
+      type == ACCESS_IFETCH ? instruction_paths[core] : data_paths[core];
+  const ADDRESS line_address = address
+      - caches.front()->GetLineOffset(address);
+
+  if (!prefetch_requests.empty()) {
+    IssuePrefetches();
+  }
 
-  std::vector<Cache*>::iterator cache = caches.begin();
+  if (!write_combining_buffers.empty()) {
+    // Pending non-temporal stores to the line must reach memory first.
+    FlushWriteCombiningBuffer(line_address);
+  }
 
-  // First, search the L1 for the line
-  requested = (*cache)->AccessLine(address, size_B);
+  // Search the hierarchy from the L1 down for the line.
+  uint8_t level = 0;
+  while (level < n_levels
+      && (requested = caches[path[level]]->AccessLine(address, size_B))
+          == NULL) {
+    level_counters[path[level]].misses++;
+    if (!prefetch_victims[path[level]].empty()
+        && prefetch_victims[path[level]].erase(line_address)) {
+      prefetch_pollution[path[level]]++;
+    }
+    level++;
+  }
+  const uint8_t served_level = level;
 
-  CacheLine* evicted = NULL;
-  // If the line was not found in L1, evict a line if the cache is full
+  bool first_use = false;
   if (requested == NULL) {
-    // Evict returns NULL if there is space available.
-    evicted = (*cache)->EvictLRU(address);
+    // Line was not mapped in cache. Create it (ie. fetch from main memory).
+    requested = new CacheLine(line_size_B, line_address);
+    requested->Access(address, size_B);
+    requested->SetFillPc(pc);
+    if (pc_attribution != NULL) {
+      pc_attribution->Miss(pc);
+    }
+    if (data_objects != NULL) {
+      data_objects->Miss(address);
+    }
+    misses++;
+    core_misses[core]++;
+  } else {
+    // Reinserting a mapped line moves it to the MRU position.
+    caches[path[level]]->Insert(*requested);
+    hits++;
+    core_hits[core]++;
+    level_counters[path[level]].hits++;
+
+    const uint8_t prefetch_cache = requested->GetPrefetchCache();
+    if (requested->HasFlag(LINE_FLAG_PREFETCHED)
+        && (cache_cores[prefetch_cache] == core
+            || cache_cores[prefetch_cache] == NO_CORE)) {
+      requested->ClearFlag(LINE_FLAG_PREFETCHED);
+      useful_prefetches[prefetch_cache]++;
+      if (IsInFlight(prefetch_cache, line_address)) {
+        late_prefetches[prefetch_cache]++;
+      }
+      first_use = true;
+    }
+
+    if (path[level] == llc) {
+      if (requested->HasFlag(LINE_FLAG_EARLY_INVALIDATED)) {
+        // The line was hot: ECI gave it the chance to be rescued here.
+        requested->ClearFlag(LINE_FLAG_EARLY_INVALIDATED);
+        inclusion_victims_avoided++;
+      }
+    } else if (inclusion_policy == INCLUSION_POLICY_TLH) {
+      if (caches[llc]->GetLRU(address) == requested) {
+        inclusion_victims_avoided++;
+      }
+      caches[llc]->Insert(*requested);
+      temporal_locality_hints++;
+    }
   }
 
-  cache++;
+  const bool write = type == ACCESS_STORE || type == ACCESS_RMW;
+  const bool private_hit = level < n_levels - 1;
+  if (n_cores > 1) {
+    Coherence(*requested, core, write, private_hit);
+  }
 
-  // If we have evicted something from the previous level, insert it into the current level
-  // while continuing to search for the requested line.
-  while (cache < caches.end() && requested == NULL && evicted != NULL) {
-    // Search for the requested line
-    requested = (*cache)->AccessLine(address, size_B);
-    // Evict a line if the cache is full to make room for the evicted line
-    CacheLine* const tmp = (*cache)->EvictLRU(evicted->address);
-    // Insert the previously evicted line
-    (*cache)->Insert(*evicted);
-    // Repeat if necessary...
-    evicted = tmp;
-    cache++;
+  // Fill the levels above the one that served the request. Filling from the
+  // bottom up keeps the hierarchy inclusive after every step. A store stops
+  // at the first level that does not allocate on a write miss.
+  uint8_t top_level = 0;
+  if (hints & HINT_BYPASS_L2) {
+    top_level = 2;
+  } else if (hints & HINT_BYPASS_L1) {
+    top_level = 1;
+  }
+  const bool lru = hints & (HINT_INSERT_LRU | HINT_NON_TEMPORAL);
+  while (level > top_level
+      && (type != ACCESS_STORE
+          || write_policies[path[level - 1]].miss == WRITE_ALLOCATE)) {
+    level--;
+    Fill(path[level], *requested, lru);
   }
 
-  // If we are not holding any evicted line and have not found the requested line,
-  // continue searching.
-  while (cache < caches.end() && requested == NULL && evicted == NULL) {
-    requested = (*cache)->AccessLine(address, size_B);
+  if (write) {
+    Store(path, level, requested, address, size_B);
+  }
+  // The bytes are used in every cache of the path that now holds the line,
+  // not in the private caches of the other cores.
+  LEVEL_MASK path_levels = 0;
+  for (uint8_t i = 0; i < n_levels; i++) {
+    path_levels |= ((LEVEL_MASK) 1) << path[i];
+  }
+  requested->AccessLevels(requested->GetLevels() & path_levels, address,
+      size_B);
+  if (n_cores > 1) {
+    UpdateDirectory(*requested, core, write, private_hit);
+  }
+  if (has_prefetchers) {
+    TrainPrefetchers(path, served_level, address, pc, first_use, core,
+        type == ACCESS_IFETCH);
+  }
 
-    cache++;
+  if (level == n_levels) {
+    // The line was not allocated anywhere: it went straight to memory.
+    delete requested;
+    return NULL;
   }
+  return requested;
+}
 
-  // We have reached the end of the cache hierarchy.
-  if (requested == NULL) {
-    // Line was not mapped in cache. Create it and insert it in L1.
-    requested = new CacheLine(line_size_B,
-        address - caches.front()->GetLineOffset(address));
-    requested->Access(address, size_B);
-    caches.front()->Insert(*requested);
-    misses++;
+void MultilevelCache::TrainPrefetchers(const std::vector<uint8_t>& path,
+    const uint8_t served_level, const ADDRESS address, const ADDRESS pc,
+    const bool first_use, const uint8_t core, const bool instruction) {
+  std::vector<ADDRESS> addresses;
+  for (uint8_t level = 0; level <= served_level && level < n_levels;
+      level++) {
+    const std::vector<Prefetcher*>& cache_prefetchers =
+        prefetchers[path[level]];
+    for (size_t i = 0; i < cache_prefetchers.size(); i++) {
+      cache_prefetchers[i]->Train(address, pc,
+          level < served_level || first_use, addresses);
+    }
+    for (size_t i = 0; i < addresses.size(); i++) {
+      PrefetchRequest request;
+      request.line_address = addresses[i]
+          - caches.front()->GetLineOffset(addresses[i]);
+      request.cache = path[level];
+      request.core = core;
+      request.instruction = instruction;
+      prefetch_requests.push_back(request);
+    }
+    addresses.clear();
+  }
+}
+
+void MultilevelCache::IssuePrefetches() {
+  const uint64_t now = hits + misses;
+  for (uint8_t cache = 0; cache < caches.size(); cache++) {
+    std::deque<std::pair<ADDRESS, uint64_t> >& in_flight =
+        in_flight_prefetches[cache];
+    while (!in_flight.empty() && in_flight.front().second <= now) {
+      in_flight.pop_front();
+    }
+  }
+  for (size_t i = 0; i < prefetch_requests.size(); i++) {
+    Prefetch(prefetch_requests[i]);
+  }
+  prefetch_requests.clear();
+}
+
+void MultilevelCache::Prefetch(const PrefetchRequest& request) {
+  const std::vector<uint8_t>& path =
+      request.instruction ?
+          instruction_paths[request.core] : data_paths[request.core];
+  uint8_t target = 0;
+  while (path[target] != request.cache) {
+    target++;
+  }
+  if (caches[request.cache]->Contains(request.line_address)) {
+    return;
+  }
+
+  uint8_t level = target + 1;
+  CacheLine* line = NULL;
+  while (level < n_levels
+      && (line = caches[path[level]]->AccessLine(request.line_address, 0))
+          == NULL) {
+    level++;
+  }
+  if (line == NULL) {
+    line = new CacheLine(line_size_B, request.line_address);
+    line->SetFlag(LINE_FLAG_PREFETCH_FILLED);
+  } else if (n_cores > 1 && request.cache != llc
+      && (line->GetSharers() & ~(((CORE_MASK) 1) << request.core))) {
+    // Prefetching a line another core holds would need the directory.
+    return;
+  }
+
+  prefetching = true;
+  while (level > target) {
+    level--;
+    Fill(path[level], *line, false);
+  }
+  prefetching = false;
+  line->SetPrefetched(request.cache);
+  prefetches[request.cache]++;
+  in_flight_prefetches[request.cache].push_back(
+      std::make_pair(request.line_address,
+          hits + misses + prefetch_latency));
+  if (n_cores > 1) {
+    UpdateDirectory(*line, request.core, false, false);
+  }
+}
+
+bool MultilevelCache::IsInFlight(const uint8_t cache,
+    const ADDRESS line_address) {
+  const uint64_t now = hits + misses;
+  const std::deque<std::pair<ADDRESS, uint64_t> >& in_flight =
+      in_flight_prefetches[cache];
+  for (size_t i = 0; i < in_flight.size(); i++) {
+    if (in_flight[i].first == line_address && in_flight[i].second > now) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void MultilevelCache::Coherence(CacheLine& line, const uint8_t core,
+    const bool write, const bool private_hit) {
+  if (!private_hit) {
+    private_misses[core]++;
+    if (line.ClearCoherenceVictim(core)) {
+      coherence_misses[core]++;
+    }
+  }
+  CORE_MASK others = line.GetSharers() & ~(((CORE_MASK) 1) << core);
+  if (others == 0) {
+    return;
+  }
+  if (write) {
+    // Only a miss can find another core holding the line modified.
+    if (line.HasFlag(LINE_FLAG_MODIFIED)) {
+      cache_to_cache_transfers[core]++;
+    } else if (private_hit) {
+      core_upgrades[core]++;
+    }
+    while (others) {
+      const uint8_t sharer = __builtin_ctzll(others);
+      Invalidate(line, line.GetLevels() & core_caches[sharer],
+          coherence_invalidations, EVICTION_COHERENCE);
+      line.SetCoherenceVictim(sharer);
+      core_invalidations[sharer]++;
+      others &= others - 1;
+    }
+  } else if (!private_hit && line.HasFlag(LINE_FLAG_EXCLUSIVE)) {
+    const uint8_t owner = __builtin_ctzll(others);
+    if (line.HasFlag(LINE_FLAG_MODIFIED)) {
+      // The owner supplies the line and writes it back to the LLC, top down
+      // through its private caches.
+      cache_to_cache_transfers[core]++;
+      for (uint8_t level = 0; level < n_levels - 1; level++) {
+        LEVEL_MASK level_mask = line.GetLevels() & core_caches[owner]
+            & level_caches[level];
+        while (level_mask) {
+          WriteBack(__builtin_ctzll(level_mask), line);
+          level_mask &= level_mask - 1;
+        }
+      }
+    }
+    core_downgrades[owner]++;
+    line.ClearFlag(LINE_FLAG_EXCLUSIVE);
+    line.ClearFlag(LINE_FLAG_MODIFIED);
+  }
+}
+
+void MultilevelCache::UpdateDirectory(CacheLine& line, const uint8_t core,
+    const bool write, const bool private_hit) {
+  if (!(line.GetLevels() & core_caches[core])) {
+    // The access did not allocate the line in core's private caches.
+    return;
+  }
+  line.AddSharer(core);
+  if (write) {
+    line.SetFlag(LINE_FLAG_EXCLUSIVE);
+    line.SetFlag(LINE_FLAG_MODIFIED);
+  } else if (!private_hit
+      && line.GetSharers() == ((CORE_MASK) 1) << core) {
+    line.SetFlag(LINE_FLAG_EXCLUSIVE);
+  }
+}
+
+void MultilevelCache::ClearPresent(CacheLine& line, const uint8_t cache,
+    const EvictionCause cause) {
+  line.ClearPresent(cache);
+  const size_t used_B = line.ClearLevelAccesses(cache);
+  level_byte_utilizations[cache][used_B]++;
+  level_counters[cache].evictions[cause]++;
+  level_counters[cache].used_bytes += used_B;
+  if (line.HasFlag(LINE_FLAG_PREFETCHED) && line.GetPrefetchCache() == cache) {
+    line.ClearFlag(LINE_FLAG_PREFETCHED);
+    useless_prefetches[cache]++;
+  }
+  if (has_prefetchers) {
+    const std::vector<Prefetcher*>& cache_prefetchers = prefetchers[cache];
+    for (size_t i = 0; i < cache_prefetchers.size(); i++) {
+      cache_prefetchers[i]->Evict(line.address);
+    }
+  }
+  const uint8_t core = cache_cores[cache];
+  if (core != NO_CORE && !(line.GetLevels() & core_caches[core])) {
+    line.RemoveSharer(core);
+  }
+}
+
+void MultilevelCache::Store(const std::vector<uint8_t>& path,
+    const uint8_t level, CacheLine* const line, const ADDRESS address,
+    const uint8_t size_B) {
+  // The levels above level do not hold the line: the store passes them.
+  for (uint8_t upper_level = 0; upper_level < level; upper_level++) {
+    write_through_bytes[path[upper_level]] += size_B;
+  }
+  uint8_t cache = level < n_levels ? path[level] : NO_CACHE;
+  while (cache != NO_CACHE && write_policies[cache].hit == WRITE_THROUGH) {
+    write_through_bytes[cache] += size_B;
+    cache = lower_caches[cache];
+  }
+  if (cache != NO_CACHE) {
+    line->Write(cache, address, size_B);
+  }
+}
+
+void MultilevelCache::WriteBack(const uint8_t cache, CacheLine& line) {
+  if (line.CountDirtyBytes(cache) == 0) {
+    return;
+  }
+  // Write-through caches forward the written back line.
+  uint8_t lower = lower_caches[cache];
+  while (lower != NO_CACHE && write_policies[lower].hit == WRITE_THROUGH) {
+    write_through_bytes[lower] += line_size_B;
+    lower = lower_caches[lower];
+  }
+  size_t n_dirty;
+  if (lower != NO_CACHE) {
+    n_dirty = line.WriteBack(cache, lower);
   } else {
-    hits++;
+    n_dirty = line.Clean(cache);
+  }
+  level_counters[cache].write_backs++;
+  write_back_bytes[cache] += line_size_B;
+  write_back_dirty_bytes[cache] += n_dirty;
+}
+
+void MultilevelCache::Fill(const uint8_t index, CacheLine& line,
+    const bool lru) {
+  Cache* const cache = caches[index];
+  const bool is_llc = index == llc && upper_caches[index] != 0;
+  if (cache->GetLRU(line.address) != NULL) {
+    // The set is full. Make room for the line.
+    CacheLine* victim;
+    if (is_llc && inclusion_policy == INCLUSION_POLICY_QBS) {
+      CacheLine* const lru_line = cache->GetLRU(line.address);
+      victim = cache->EvictLRU(line.address, upper_caches[index],
+          max_queries);
+      if (victim != lru_line) {
+        inclusion_victims_avoided++;
+      }
+    } else {
+      victim = cache->EvictLRU(line.address);
+    }
+    if (prefetching) {
+      boost::unordered_set<ADDRESS>& victims = prefetch_victims[index];
+      if (victims.size()
+          >= ((size_t) cache->associativity << cache->n_bits_set)) {
+        // Forget victims older than the cache's own contents.
+        victims.clear();
+      }
+      victims.insert(victim->address);
+    }
+    Evict(index, *victim, inclusion_victims, EVICTION_CAPACITY);
   }
+  cache->Insert(line, lru);
+  line.SetPresent(index);
+  level_counters[index].fills++;
 
-  if (evicted != NULL) {
-    // Remove line from all other levels of the hierarchy (inclusive cache).
-    for (std::vector<Cache*>::iterator it = caches.begin(); it != caches.end();
-        it++) {
-      (*it)->RemoveLine(evicted->address);
+  if (is_llc && inclusion_policy == INCLUSION_POLICY_ECI) {
+    CacheLine* const next_victim = cache->GetLRU(line.address);
+    if (next_victim != NULL
+        && (next_victim->GetLevels() & upper_caches[index])) {
+      const LEVEL_MASK upper_levels = next_victim->GetLevels()
+          & upper_caches[index];
+      level_counters[index].back_invalidations += __builtin_popcountll(
+          upper_levels);
+      Invalidate(*next_victim, upper_levels, early_invalidations,
+          EVICTION_INCLUSION);
+      next_victim->SetFlag(LINE_FLAG_EARLY_INVALIDATED);
     }
-    boost::dynamic_bitset<> accessedBytes = evicted->getAccessedBytes();
+  }
+}
+
+void MultilevelCache::Evict(const uint8_t cache, CacheLine& victim,
+    std::vector<uint64_t>& upper_counts, const EvictionCause cause) {
+  ClearPresent(victim, cache, cause);
+
+  // Remove the line from the upper caches that hold it (inclusive cache).
+  // Only caches in the line's mask are visited.
+  const LEVEL_MASK upper_levels = victim.GetLevels() & upper_caches[cache];
+  level_counters[cache].back_invalidations += __builtin_popcountll(
+      upper_levels);
+  Invalidate(victim, upper_levels, upper_counts,
+      cause == EVICTION_CAPACITY ? EVICTION_INCLUSION : cause);
+  WriteBack(cache, victim);
+
+  if (lower_caches[cache] == NO_CACHE) {
+    const boost::dynamic_bitset<>& accessedBytes = victim.getAccessedBytes();
     int utilization = accessedBytes.count();
+    if (pc_attribution != NULL
+        && !victim.HasFlag(LINE_FLAG_PREFETCH_FILLED)) {
+      pc_attribution->Evict(victim.GetFillPc(), utilization);
+    }
+    if (data_objects != NULL && utilization
+        && !victim.HasFlag(LINE_FLAG_PREFETCH_FILLED)) {
+      data_objects->Evict(victim.address + victim.GetFirstOffset(),
+          utilization);
+    }
     if (utilization) {
-      byte_utilizations.at(utilization - 1)++;}
-      // We have evicted a line from the cache hierarchy. Delete it.
-    delete evicted;
+      std::vector<uint64_t>& utilizations =
+          victim.HasFlag(LINE_FLAG_PREFETCH_FILLED) ?
+              prefetched_byte_utilizations : byte_utilizations;
+      utilizations.at(utilization - 1)++;
+      footprints.Record(accessedBytes, victim.GetFirstOffset());
+    }
+    // We have evicted a line from the cache hierarchy. Delete it.
+    delete &victim;
+  }
+}
+
+void MultilevelCache::Invalidate(CacheLine& line, const LEVEL_MASK levels,
+    std::vector<uint64_t>& counts, const EvictionCause cause) {
+  // Caches are visited level by level from the top down, so a dirty copy is
+  // written back into a lower copy before that copy is itself invalidated.
+  for (uint8_t level = 0; level < n_levels; level++) {
+    LEVEL_MASK level_mask = levels & level_caches[level];
+    while (level_mask) {
+      const uint8_t cache = __builtin_ctzll(level_mask);
+      WriteBack(cache, line);
+      caches[cache]->RemoveLine(line.address);
+      ClearPresent(line, cache, cause);
+      counts[cache]++;
+      level_mask &= level_mask - 1;
+    }
+  }
+}
+
+void MultilevelCache::NonTemporalStore(const ADDRESS address,
+    const uint8_t size_B) {
+  const ADDRESS line_address = address - caches.front()->GetLineOffset(
+      address);
+
+  // By inclusion, a cached copy of the line is held by the LLC.
+  CacheLine* const cached = caches[llc]->AccessLine(address, size_B);
+  if (cached != NULL) {
+    caches[llc]->RemoveLine(line_address);
+    non_temporal_invalidations[llc]++;
+    Evict(llc, *cached, non_temporal_invalidations, EVICTION_FLUSH);
+  }
+
+  std::deque<WriteCombiningBuffer>::iterator buffer =
+      write_combining_buffers.begin();
+  while (buffer != write_combining_buffers.end()
+      && buffer->address != line_address) {
+    buffer++;
+  }
+  if (buffer == write_combining_buffers.end()) {
+    if (n_write_combining_buffers == 0) {
+      write_through_bytes[llc] += size_B;
+      return;
+    }
+    if (write_combining_buffers.size() == n_write_combining_buffers) {
+      FlushWriteCombiningBuffer(write_combining_buffers.front());
+      write_combining_buffers.pop_front();
+    }
+    WriteCombiningBuffer empty;
+    empty.address = line_address;
+    empty.bytes.resize(line_size_B, false);
+    write_combining_buffers.push_back(empty);
+    buffer = write_combining_buffers.end() - 1;
+  }
+
+  for (uint32_t i = address - line_address; i < address - line_address + size_B;
+      i++) {
+    buffer->bytes[i] = true;
+  }
+  if (buffer->bytes.all()) {
+    // A complete line is written out as soon as it is collected.
+    FlushWriteCombiningBuffer(*buffer);
+    write_combining_buffers.erase(buffer);
+  }
+}
+
+void MultilevelCache::FlushWriteCombiningBuffer(const ADDRESS line_address) {
+  for (std::deque<WriteCombiningBuffer>::iterator buffer =
+      write_combining_buffers.begin(); buffer != write_combining_buffers.end();
+      buffer++) {
+    if (buffer->address == line_address) {
+      FlushWriteCombiningBuffer(*buffer);
+      write_combining_buffers.erase(buffer);
+      return;
+    }
+  }
+}
+
+void MultilevelCache::FlushWriteCombiningBuffer(
+    const WriteCombiningBuffer& buffer) {
+  write_combining_flushes++;
+  if (!buffer.bytes.all()) {
+    write_combining_partial_flushes++;
+  }
+  write_combining_bytes += buffer.bytes.count();
+}
+
+std::ostream& operator<<(std::ostream& stream, const MultilevelCache& cache) {
+  stream << "Hits: " << cache.hits << ", Misses: " << cache.misses
+      << std::endl;
+  stream << std::setw(6) << "Cache" << std::setw(12) << "Hits"
+      << std::setw(12) << "Misses" << std::setw(12) << "Fills"
+      << std::setw(12) << "WriteBacks" << std::setw(14) << "WBBytes"
+      << std::setw(14) << "WBDirtyBytes" << std::setw(14) << "WTBytes"
+      << std::endl;
+  for (uint8_t i = 0; i < cache.GetCacheCount(); i++) {
+    const LevelCounters& counters = cache.level_counters[i];
+    stream << std::setw(6) << cache.GetCacheName(i) << std::setw(12)
+        << counters.hits << std::setw(12) << counters.misses << std::setw(12)
+        << counters.fills << std::setw(12) << counters.write_backs
+        << std::setw(14) << cache.write_back_bytes[i] << std::setw(14)
+        << cache.write_back_dirty_bytes[i] << std::setw(14)
+        << cache.write_through_bytes[i] << std::endl;
+  }
+  stream << std::setw(6) << "Cache" << std::setw(12) << "Evictions"
+      << std::setw(12) << "Capacity" << std::setw(12) << "Inclusion"
+      << std::setw(12) << "Flush" << std::setw(12) << "Coherence"
+      << std::setw(12) << "BackInvals" << std::setw(12) << "UsedBytes"
+      << std::setw(12) << "Utilization" << std::setw(12) << "Resident"
+      << std::setw(12) << "ResUsedBytes" << std::endl;
+  for (uint8_t i = 0; i < cache.GetCacheCount(); i++) {
+    const LevelCounters& counters = cache.level_counters[i];
+    stream << std::setw(6) << cache.GetCacheName(i) << std::setw(12)
+        << counters.GetEvictionCount();
+    for (uint8_t cause = 0; cause < N_EVICTION_CAUSES; cause++) {
+      stream << std::setw(12) << counters.evictions[cause];
+    }
+    const uint64_t evicted_B = counters.GetEvictionCount() * cache.line_size_B;
+    stream << std::setw(12) << counters.back_invalidations << std::setw(12)
+        << counters.used_bytes << std::setw(12)
+        << (evicted_B ? (double) counters.used_bytes / evicted_B : 0)
+        << std::setw(12) << counters.resident_lines << std::setw(12)
+        << counters.resident_used_bytes << std::endl;
+  }
+  if (cache.n_cores > 1) {
+    stream << std::setw(6) << "Core" << std::setw(12) << "Hits"
+        << std::setw(12) << "Misses" << std::setw(12) << "PrivMisses"
+        << std::setw(12) << "CohMisses" << std::setw(12) << "Invals"
+        << std::setw(12) << "Downgrades" << std::setw(12) << "Upgrades"
+        << std::setw(12) << "C2C" << std::endl;
+    for (uint8_t core = 0; core < cache.n_cores; core++) {
+      stream << std::setw(6) << (int) core << std::setw(12)
+          << cache.core_hits[core] << std::setw(12) << cache.core_misses[core]
+          << std::setw(12) << cache.private_misses[core] << std::setw(12)
+          << cache.coherence_misses[core] << std::setw(12)
+          << cache.core_invalidations[core] << std::setw(12)
+          << cache.core_downgrades[core] << std::setw(12)
+          << cache.core_upgrades[core] << std::setw(12)
+          << cache.cache_to_cache_transfers[core] << std::endl;
+    }
+  }
+  if (cache.has_prefetchers) {
+    stream << std::setw(6) << "Cache" << std::setw(12) << "Misses"
+        << std::setw(12) << "Prefetches" << std::setw(12) << "Useful"
+        << std::setw(12) << "Late" << std::setw(12) << "Useless"
+        << std::setw(12) << "Pollution" << std::setw(12) << "Coverage"
+        << std::setw(12) << "Accuracy" << std::setw(12) << "StorageB"
+        << std::endl;
+    for (uint8_t i = 0; i < cache.GetCacheCount(); i++) {
+      if (cache.prefetchers[i].empty()) {
+        continue;
+      }
+      uint64_t storage_B = 0;
+      for (size_t j = 0; j < cache.prefetchers[i].size(); j++) {
+        storage_B += cache.prefetchers[i][j]->GetStorageBytes();
+      }
+      const uint64_t useful = cache.useful_prefetches[i];
+      const uint64_t demanded = useful + cache.level_counters[i].misses;
+      stream << std::setw(6) << cache.GetCacheName(i) << std::setw(12)
+          << cache.level_counters[i].misses << std::setw(12)
+          << cache.prefetches[i] << std::setw(12) << useful << std::setw(12)
+          << cache.late_prefetches[i] << std::setw(12)
+          << cache.useless_prefetches[i] << std::setw(12)
+          << cache.prefetch_pollution[i] << std::setw(12)
+          << (demanded ? (double) useful / demanded : 0) << std::setw(12)
+          << (cache.prefetches[i] ? (double) useful / cache.prefetches[i] : 0)
+          << std::setw(12) << storage_B << std::endl;
+    }
+  }
+  if (cache.footprints.n_lines) {
+    stream << cache.footprints;
   }
-  return *requested;
+  return stream;
 }
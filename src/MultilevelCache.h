@@ -8,47 +8,470 @@
 #ifndef MULTILEVELCACHE_H_
 #define MULTILEVELCACHE_H_
 
+#include <boost/dynamic_bitset.hpp>
+#include <boost/unordered_set.hpp>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <utility>
 #include <vector>
 
+#include "AccessObserver.h"
+#include "AccessRecord.h"
+#include "AccessStream.h"
 #include "Address.h"
 #include "Cache.h"
+#include "DataObjectMap.h"
+#include "FootprintHistogram.h"
+#include "PcAttribution.h"
+#include "Prefetcher.h"
 
 #define DEFAULT_LINE_SIZE 64   // 64 Bytes per block
+#define DEFAULT_WRITE_COMBINING_BUFFERS 10
+#define DEFAULT_PREFETCH_LATENCY 8   // demand accesses a prefetch takes
+// The cache index of main memory, ie. below the LLC.
+#define NO_CACHE 0xff
+// The core of a cache that is shared by all cores.
+#define NO_CORE 0xff
 
+/**
+ * LLC replacement policies for the inclusive hierarchy. Each policy tries to
+ * keep the LLC from victimizing lines that are still in use in upper levels.
+ */
+enum InclusionPolicy {
+  // Plain LRU: the LLC ignores the upper levels.
+  INCLUSION_POLICY_LRU,
+  // Temporal locality hints: a hit in an upper level also refreshes the LLC
+  // LRU position of the line.
+  INCLUSION_POLICY_TLH,
+  // Early core invalidation: after an LLC fill, the next LLC victim candidate
+  // is invalidated from the upper levels so that a re-reference rescues it
+  // with an LLC hit before it reaches the LRU position.
+  INCLUSION_POLICY_ECI,
+  // Query based selection: the LLC skips victim candidates that are held by
+  // an upper level.
+  INCLUSION_POLICY_QBS
+};
+
+/**
+ * What a level does with a store to a line it holds.
+ */
+enum WriteHitPolicy {
+  // Mark the level's copy dirty and write it back when it is evicted.
+  WRITE_BACK,
+  // Forward the stored bytes to the next level immediately.
+  WRITE_THROUGH
+};
+
+/**
+ * What a level does with a store to a line it does not hold.
+ */
+enum WriteMissPolicy {
+  // Fill the line into the level, then store to it.
+  WRITE_ALLOCATE,
+  // Forward the store to the next level without filling the line.
+  NO_WRITE_ALLOCATE
+};
+
+/**
+ * Why a line left a cache.
+ */
+enum EvictionCause {
+  // Replaced to make room for a fill.
+  EVICTION_CAPACITY,
+  // Back-invalidated because a lower cache evicted it.
+  EVICTION_INCLUSION,
+  // Flushed from the hierarchy by a non-temporal store.
+  EVICTION_FLUSH,
+  // Invalidated by a write of another core.
+  EVICTION_COHERENCE,
+  N_EVICTION_CAUSES
+};
+
+/**
+ * The counters of one cache. They are padded to whole host cache lines, so
+ * the counters of different caches, or of the shards of a
+ * ConcurrentMultilevelCache, are not packed into the same line.
+ */
+struct LevelCounters {
+  // Demand requests served by the cache.
+  uint64_t hits;
+  // Demand requests that looked up the cache and missed.
+  uint64_t misses;
+  // Lines filled into the cache, by demand requests or prefetches.
+  uint64_t fills;
+  // Entry i counts the lines that left the cache for EvictionCause i.
+  uint64_t evictions[N_EVICTION_CAUSES];
+  // Lines the cache invalidated from the upper caches as it evicted them.
+  uint64_t back_invalidations;
+  // Dirty lines written back to the next level, or to memory for the LLC.
+  uint64_t write_backs;
+  // The bytes of the lines that left the cache that were accessed while the
+  // cache held them.
+  uint64_t used_bytes;
+  // The lines the cache still held when the hierarchy was finalized, and
+  // their bytes accessed while the cache held them.
+  uint64_t resident_lines;
+  uint64_t resident_used_bytes;
+  char padding[2 * CACHE_LINE_B - (8 + N_EVICTION_CAUSES) * sizeof(uint64_t)];
+
+  uint64_t GetEvictionCount() const {
+    uint64_t n_evictions = 0;
+    for (uint8_t cause = 0; cause < N_EVICTION_CAUSES; cause++) {
+      n_evictions += evictions[cause];
+    }
+    return n_evictions;
+  }
+
+  /**
+   * Adds the counters of other to these.
+   */
+  void Add(const LevelCounters& other) {
+    hits += other.hits;
+    misses += other.misses;
+    fills += other.fills;
+    for (uint8_t cause = 0; cause < N_EVICTION_CAUSES; cause++) {
+      evictions[cause] += other.evictions[cause];
+    }
+    back_invalidations += other.back_invalidations;
+    write_backs += other.write_backs;
+    used_bytes += other.used_bytes;
+    resident_lines += other.resident_lines;
+    resident_used_bytes += other.resident_used_bytes;
+  }
+};
+
+struct WritePolicy {
+  WriteHitPolicy hit;
+  WriteMissPolicy miss;
+};
+
+/**
+ * Collects the non-temporal stores to one line until it is flushed to memory.
+ */
+struct WriteCombiningBuffer {
+  ADDRESS address;
+  boost::dynamic_bitset<> bytes;
+};
+
+/**
+ * A line a prefetcher asked for, issued before the next demand access.
+ */
+struct PrefetchRequest {
+  ADDRESS line_address;
+  uint8_t cache;
+  uint8_t core;
+  bool instruction;
+};
+
+/**
+ * The caches of the hierarchy are numbered by cache index. Each core has
+ * private caches at every level but the last, which all cores share. The data
+ * path of core 0 holds indexes 0 to n_levels - 1, so in a single-core
+ * hierarchy without split caches the cache index is the level. The private
+ * caches of the other cores follow, then the L1 instruction caches if the L1
+ * is split. The bits of a LEVEL_MASK and the entries of the per-cache
+ * statistics are cache indexes.
+ */
 class MultilevelCache {
 private:
   std::vector<Cache*> caches;
+  // Entry i is the core that owns cache i, or NO_CORE for the LLC.
+  std::vector<uint8_t> cache_cores;
+  // Entry i is the cache below cache i, or NO_CACHE for the LLC.
+  std::vector<uint8_t> lower_caches;
+  // Entry i is a mask of every cache above cache i.
+  std::vector<LEVEL_MASK> upper_caches;
+  // Entry i is a mask of the caches at level i.
+  std::vector<LEVEL_MASK> level_caches;
+  // Entry i is a mask of core i's private caches.
+  std::vector<LEVEL_MASK> core_caches;
+  // Entry i holds the caches searched by core i's data accesses and
+  // instruction fetches, from the first level to the LLC.
+  std::vector<std::vector<uint8_t> > data_paths;
+  std::vector<std::vector<uint8_t> > instruction_paths;
+  uint8_t llc;
+  bool split_l1;
+  std::vector<WritePolicy> write_policies;
+  InclusionPolicy inclusion_policy;
+  uint32_t max_queries;
+  // Oldest buffer first.
+  std::deque<WriteCombiningBuffer> write_combining_buffers;
+  uint32_t n_write_combining_buffers;
+  std::vector<AccessObserver*> observers;
+  // Entry i holds the prefetchers attached to cache i.
+  std::vector<std::vector<Prefetcher*> > prefetchers;
+  bool has_prefetchers;
+  std::vector<PrefetchRequest> prefetch_requests;
+  // Entry i holds the lines prefetched into cache i that have not arrived
+  // yet, with the demand access count at which they arrive. Oldest first.
+  std::vector<std::deque<std::pair<ADDRESS, uint64_t> > >
+      in_flight_prefetches;
+  // Entry i holds the lines prefetch fills evicted from cache i that have not
+  // missed since.
+  std::vector<boost::unordered_set<ADDRESS> > prefetch_victims;
+  uint32_t prefetch_latency;
+  // Set while a prefetch fills the hierarchy.
+  bool prefetching;
+  PcAttribution* pc_attribution;
+  DataObjectMap* data_objects;
 
 private:
+  /**
+   * Creates the caches of the hierarchy and the paths through them. The L1
+   * is split if l1i_capacity_B is not zero.
+   */
+  void Build(const std::vector<uint64_t>& capacities_B,
+      const std::vector<uint16_t>& associativities,
+      const uint64_t l1i_capacity_B, const uint16_t l1i_associativity);
+
+  /**
+   * Creates a cache at level owned by core and returns its index.
+   */
+  uint8_t AddCache(const uint64_t capacity_B, const uint16_t associativity,
+      const uint8_t level, const uint8_t core);
+
   /**
    * Splits the access request if it spans multiple CacheLines.
-   * Returns a vector of accessed CacheLines.
+   * Appends the accessed CacheLines to accessed_lines unless it is NULL.
    */
-  std::vector<CacheLine*>& SplitAccess(const ADDRESS address,
-      const uint8_t n_bytes);
+  void SplitAccess(const AccessRecord& record,
+      std::vector<CacheLine*>* const accessed_lines);
+
+  /**
+   * Tells every observer of the part of an access that falls in one line.
+   */
+  void Notify(const AccessRecord& record, const ADDRESS address,
+      const uint32_t size_B);
 
   /**
    * Searches the cache for the CacheLine containing the requested address.
+   * Instruction fetches search the instruction path, all other accesses the
+   * data path.
    *
    * Algorithm:
-   * 1.  If the line is in the first level cache, fetch it and return.
-   * 2.  Else, if the first level cache is full, evict a line.
-   * 3.  Search the next level cache for the line. If we find it, remove it.
-   * 4.  If we previously evicted a line and the cache is full, evict a line.
-   * 4.1.Insert the previously evicted line into the cache.
-   * 5.  Repeat 3-4.1 until the end of the cache hierarchy.
-   * 6.  If we evicted a line from the LLC, destroy it.
-   * 7.  If we have not found the requested cache line, create it (ie. fetch from main memory).
-   * 8.  Insert the requested cache line into the L1.
+   * 1.  Search each level, starting at the L1, until the line is found.
+   * 2.  If the line was found, move it to the MRU position of that level.
+   * 3.  Else, create it (ie. fetch from main memory).
+   * 4.  Fill the line into every level above the level that served it, from
+   *     the bottom up. Each fill may evict a victim from its level (see Evict).
+   *     A store stops filling at the first no-write-allocate level and any
+   *     access stops at a level its hints bypass.
+   * 5.  If the access modifies the line, store to the highest level that
+   *     holds it (see Store).
+   * 6.  Train the prefetchers of the levels searched (see TrainPrefetchers).
+   *     Their requests are issued before the next access, so the lines this
+   *     access returns are not evicted under it.
    *
+   * In a multicore hierarchy, the directory acts on the line between steps 3
+   * and 4 (see Coherence).
+   *
+   * Non-temporal stores do not use this algorithm (see NonTemporalStore).
+   * Returns NULL if the line was allocated in no level.
    */
-  CacheLine& InclusiveAccess(const ADDRESS address, const uint8_t size_B);
+  CacheLine* InclusiveAccess(const ADDRESS address, const uint8_t size_B,
+      const AccessType type, const uint8_t hints, const uint8_t core,
+      const ADDRESS pc);
+
+  /**
+   * Trains the prefetchers of the caches of path that a demand access to
+   * address looked up, the access being served at served_level. first_use
+   * is true iff the access was the first use of a prefetched line.
+   * Collects the lines they ask for in prefetch_requests.
+   */
+  void TrainPrefetchers(const std::vector<uint8_t>& path,
+      const uint8_t served_level, const ADDRESS address, const ADDRESS pc,
+      const bool first_use, const uint8_t core, const bool instruction);
+
+  /**
+   * Issues the prefetch requests collected so far.
+   */
+  void IssuePrefetches();
+
+  /**
+   * Fills the line of request into its cache and the caches between it and
+   * the level that holds the line, like a load that does not access any
+   * byte. Lines the cache holds, and lines another core holds in a
+   * multicore hierarchy, are not prefetched.
+   */
+  void Prefetch(const PrefetchRequest& request);
+
+  /**
+   * Returns true iff the line at line_address, prefetched into cache, has
+   * not arrived yet.
+   */
+  bool IsInFlight(const uint8_t cache, const ADDRESS line_address);
+
+  /**
+   * Applies the MESI directory protocol to an access by core to line, before
+   * the line is filled into core's private caches. private_hit is true iff
+   * one of core's private caches served the access.
+   *
+   * A store invalidates the copies of the other sharers, taking the data
+   * from the owner if it had modified the line. A load that misses in the
+   * private caches downgrades an exclusive or modified owner to shared,
+   * taking the data from the owner if it had modified the line. A private
+   * miss on a line whose copy was invalidated by a store is a coherence miss.
+   */
+  void Coherence(CacheLine& line, const uint8_t core, const bool write,
+      const bool private_hit);
+
+  /**
+   * Records in the directory entry of line that core accessed it, once the
+   * access has filled core's private caches.
+   */
+  void UpdateDirectory(CacheLine& line, const uint8_t core, const bool write,
+      const bool private_hit);
+
+  /**
+   * Records that cache no longer holds line, and removes cache's core from
+   * the sharers of line if none of its private caches holds it. A line
+   * prefetched into cache that was never used is counted as useless. The
+   * prefetchers of cache are notified, and the eviction is counted under
+   * cause with the bytes used during cache's residency.
+   */
+  void ClearPresent(CacheLine& line, const uint8_t cache,
+      const EvictionCause cause);
+
+  /**
+   * Inserts line into cache, evicting the LRU line of its set if the set is
+   * full, and marks the line present in cache. If lru is true, the line is
+   * inserted at the LRU position.
+   */
+  void Fill(const uint8_t cache, CacheLine& line, const bool lru);
+
+  /**
+   * Handles a line that was evicted from cache for cause. To maintain
+   * inclusion, the line is removed from every upper cache that holds it
+   * according to its level mask; each such removal is counted in
+   * upper_counts, as an inclusion eviction if cache made room for a fill and
+   * under cause otherwise. A line evicted from the LLC has left the
+   * hierarchy: its utilization is recorded and it is destroyed.
+   */
+  void Evict(const uint8_t cache, CacheLine& victim,
+      std::vector<uint64_t>& upper_counts, const EvictionCause cause);
+
+  /**
+   * Stores size_B bytes at address without allocating the line. A cached
+   * copy of the line is written back and invalidated from the hierarchy, and
+   * the bytes are collected in a write-combining buffer. If no buffer is
+   * available, the oldest one is flushed.
+   */
+  void NonTemporalStore(const ADDRESS address, const uint8_t size_B);
+
+  /**
+   * Flushes the write-combining buffer that holds line_address, if any.
+   */
+  void FlushWriteCombiningBuffer(const ADDRESS line_address);
+
+  /**
+   * Writes buffer to memory.
+   */
+  void FlushWriteCombiningBuffer(const WriteCombiningBuffer& buffer);
+
+  /**
+   * Stores size_B bytes at address into line, where level is the highest
+   * level of path holding the line. Levels above level and write-through
+   * levels forward the bytes to the next level; the first write-back level
+   * marks them dirty.
+   */
+  void Store(const std::vector<uint8_t>& path, const uint8_t level,
+      CacheLine* const line, const ADDRESS address, const uint8_t size_B);
+
+  /**
+   * Writes back cache's dirty copy of line to the next write-back cache, or
+   * to memory if there is none.
+   */
+  void WriteBack(const uint8_t cache, CacheLine& line);
+
+  /**
+   * Removes line from every cache in levels for cause, writing back dirty
+   * copies, and increments the entry of counts for each of those caches.
+   */
+  void Invalidate(CacheLine& line, const LEVEL_MASK levels,
+      std::vector<uint64_t>& counts, const EvictionCause cause);
 
 public:
+  // Entry i counts the lines evicted from the hierarchy with i + 1 bytes
+  // accessed, among the lines a demand miss brought into it.
   std::vector<uint64_t> byte_utilizations;
+  // The same, among the lines a prefetch brought into the hierarchy.
+  std::vector<uint64_t> prefetched_byte_utilizations;
+  // The same as byte_utilizations, among the lines still in the hierarchy
+  // when it was finalized.
+  std::vector<uint64_t> resident_byte_utilizations;
+  // Which bytes were accessed in the lines evicted from the hierarchy.
+  FootprintHistogram footprints;
+  // Entry i, j counts the lines that left cache i with j bytes accessed while
+  // cache i held them, whatever their cause of eviction.
+  std::vector<std::vector<uint64_t> > level_byte_utilizations;
+  // Entry i counts the lines back-invalidated from cache i because a lower
+  // cache evicted them.
+  std::vector<uint64_t> inclusion_victims;
+  // Entry i holds the counters of cache i.
+  std::vector<LevelCounters> level_counters;
+  // Entry i counts the lines prefetched into cache i.
+  std::vector<uint64_t> prefetches;
+  // Entry i counts the lines prefetched into cache i that a demand access
+  // used, and how many of those had not arrived yet when it did.
+  std::vector<uint64_t> useful_prefetches;
+  std::vector<uint64_t> late_prefetches;
+  // Entry i counts the lines prefetched into cache i that left it unused.
+  std::vector<uint64_t> useless_prefetches;
+  // Entry i counts the demand misses in cache i on lines that a prefetch
+  // evicted from it.
+  std::vector<uint64_t> prefetch_pollution;
+  // Entry i counts the lines invalidated from cache i by early core
+  // invalidation.
+  std::vector<uint64_t> early_invalidations;
+  // Counts the inclusion victims avoided by the inclusion policy: LLC
+  // victim candidates skipped by QBS, early invalidated lines rescued by an
+  // LLC hit under ECI, and LRU lines refreshed by a hint under TLH.
+  uint64_t inclusion_victims_avoided;
+  // Counts the hints sent to the LLC under TLH.
+  uint64_t temporal_locality_hints;
+  // Entry i counts the bytes transferred by cache i's write-backs. Whole
+  // lines are written back.
+  std::vector<uint64_t> write_back_bytes;
+  // Entry i counts the bytes of cache i's written back lines that were
+  // actually modified.
+  std::vector<uint64_t> write_back_dirty_bytes;
+  // Entry i counts the store bytes that cache i forwarded to the next level
+  // without holding them dirty, because it writes through or did not
+  // allocate the line.
+  std::vector<uint64_t> write_through_bytes;
+  // Entry i counts the lines invalidated from cache i by a non-temporal store.
+  std::vector<uint64_t> non_temporal_invalidations;
+  // Counts the write-combining buffers flushed to memory, and how many of
+  // those did not hold a complete line.
+  uint64_t write_combining_flushes;
+  uint64_t write_combining_partial_flushes;
+  // Counts the bytes written to memory by write-combining flushes.
+  uint64_t write_combining_bytes;
+  // Entry i counts the lines invalidated from cache i by another core's
+  // store.
+  std::vector<uint64_t> coherence_invalidations;
   uint64_t hits;
   uint64_t misses;
+  // Entry i counts the hits and misses of core i's accesses.
+  std::vector<uint64_t> core_hits;
+  std::vector<uint64_t> core_misses;
+  // Entry i counts core i's accesses that missed in its private caches, and
+  // how many of those were coherence misses, ie. missed a line because
+  // another core's store invalidated core i's copy. The other private misses
+  // are cold, capacity or conflict misses.
+  std::vector<uint64_t> private_misses;
+  std::vector<uint64_t> coherence_misses;
+  // Entry i counts the lines core i lost to another core's store, and the
+  // exclusive or modified lines core i had to share with another core's load.
+  std::vector<uint64_t> core_invalidations;
+  std::vector<uint64_t> core_downgrades;
+  // Entry i counts core i's stores to lines it shared with other cores.
+  std::vector<uint64_t> core_upgrades;
+  // Entry i counts core i's accesses served by another core's modified copy.
+  std::vector<uint64_t> cache_to_cache_transfers;
   const uint8_t n_levels;
+  const uint8_t n_cores;
   const uint16_t line_size_B;
 
 public:
@@ -65,13 +488,176 @@ public:
   MultilevelCache(const std::vector<uint64_t>& capacities_B,
       const std::vector<uint16_t>& assocativities, const uint16_t line_size_B =
       DEFAULT_LINE_SIZE);
+
+  /**
+   * Constructs a multilevel cache with separate L1 instruction and data
+   * caches that share the lower levels.
+   *
+   * @param capacities_B Cache capacities for each level of the cache, in bytes.
+   *        The first entry is the capacity of the L1 data cache.
+   * @param associativities Cache associativities for each level of the cache.
+   * @param l1i_capacity_B The capacity of the L1 instruction cache, in bytes.
+   * @param l1i_associativity The associativity of the L1 instruction cache.
+   * @param line_size_B The number of bytes each cache line will hold, defaults to 64.
+   */
+  MultilevelCache(const std::vector<uint64_t>& capacities_B,
+      const std::vector<uint16_t>& assocativities,
+      const uint64_t l1i_capacity_B, const uint16_t l1i_associativity,
+      const uint16_t line_size_B = DEFAULT_LINE_SIZE);
+
+  /**
+   * Constructs a multilevel cache in which each of n_cores cores has private
+   * caches at every level but the last, and all cores share the last level.
+   * Accesses are mapped to cores by the thread id of their record.
+   *
+   * @param n_cores The number of cores.
+   * @param capacities_B Cache capacities for each level of the cache, in bytes.
+   *        Private levels are given per core.
+   * @param associativities Cache associativities for each level of the cache.
+   * @param line_size_B The number of bytes each cache line will hold, defaults to 64.
+   */
+  MultilevelCache(const uint8_t n_cores,
+      const std::vector<uint64_t>& capacities_B,
+      const std::vector<uint16_t>& assocativities, const uint16_t line_size_B =
+      DEFAULT_LINE_SIZE);
+
+  /**
+   * Constructs a multicore hierarchy with split private L1 caches.
+   */
+  MultilevelCache(const uint8_t n_cores,
+      const std::vector<uint64_t>& capacities_B,
+      const std::vector<uint16_t>& assocativities,
+      const uint64_t l1i_capacity_B, const uint16_t l1i_associativity,
+      const uint16_t line_size_B = DEFAULT_LINE_SIZE);
   virtual ~MultilevelCache();
 
+  /**
+   * Returns the number of caches in the hierarchy.
+   */
+  const uint8_t GetCacheCount() const {
+    return caches.size();
+  }
+
+  /**
+   * Returns the level of cache, 0 for the first level.
+   */
+  const uint8_t GetCacheLevel(const uint8_t cache) const;
+
+  /**
+   * Returns a name for cache, eg. "L1I" or "L2", for reports.
+   */
+  const std::string GetCacheName(const uint8_t cache) const;
+
+  /**
+   * Selects the LLC replacement policy. Defaults to INCLUSION_POLICY_LRU.
+   *
+   * @param policy the policy to apply to LLC victim selection.
+   * @param max_queries the number of victim candidates QBS examines per
+   *        eviction before falling back to LRU.
+   */
+  void SetInclusionPolicy(const InclusionPolicy policy,
+      const uint32_t max_queries = UINT32_MAX);
+
+  /**
+   * Selects the write policies of cache. Every cache defaults to WRITE_BACK
+   * and WRITE_ALLOCATE.
+   */
+  void SetWritePolicy(const uint8_t cache, const WriteHitPolicy hit,
+      const WriteMissPolicy miss);
+
+  /**
+   * Sets the number of write-combining buffers available to non-temporal
+   * stores. Defaults to DEFAULT_WRITE_COMBINING_BUFFERS.
+   */
+  void SetWriteCombiningBuffers(const uint32_t n_buffers);
+
+  /**
+   * Flushes every write-combining buffer to memory, eg. on a fence.
+   */
+  void FlushWriteCombiningBuffers();
+
+  /**
+   * Ends the simulation: flushes the write-combining buffers, drops pending
+   * prefetches, and empties every cache, set by set. The lines still
+   * resident are counted separately from the evicted ones, as resident at
+   * end, and destroyed. The hierarchy may be used again, cold.
+   */
+  void Finalize();
+
+  /**
+   * Adds an analysis that observes every access from now on. The cache does
+   * not own the observer.
+   */
+  void AddObserver(AccessObserver* const observer);
+
+  /**
+   * Attaches prefetcher to cache. Several prefetchers may share a cache. The
+   * cache does not own the prefetcher.
+   */
+  void AddPrefetcher(const uint8_t cache, Prefetcher* const prefetcher);
+
+  /**
+   * Sets the number of demand accesses a prefetch takes to arrive. A demand
+   * access to a line before its prefetch arrives counts as a late prefetch.
+   * Defaults to DEFAULT_PREFETCH_LATENCY.
+   */
+  void SetPrefetchLatency(const uint32_t n_accesses);
+
+  /**
+   * Charges the misses of the hierarchy and the unused bytes of the lines
+   * they fill to the instructions that missed, in attribution, from now on.
+   * Lines brought in by prefetches are not charged. The cache does not own
+   * attribution; NULL stops the charging.
+   */
+  void SetPcAttribution(PcAttribution* const attribution);
+
+  /**
+   * Charges the misses of the hierarchy and the unused bytes of the lines
+   * that leave it to the data objects of objects, from now on, and passes
+   * it the ACCESS_ALLOC and ACCESS_FREE records. Lines brought in by
+   * prefetches are not charged. The cache does not own objects; NULL stops
+   * the charging.
+   */
+  void SetDataObjects(DataObjectMap* const objects);
+
   /**
    * Access the cache for a load or store operation.
-   * Returns a vector of CacheLines that contain the address requested.
+   * Returns a vector of CacheLines that contain the address requested. An
+   * entry is NULL if the access did not allocate its line in any level.
+   */
+  std::vector<CacheLine*>& Access(const ADDRESS address, const uint8_t n_bytes,
+      const AccessType type = ACCESS_LOAD);
+
+  /**
+   * Access the cache for the operation described by record, honoring its
+   * hints. The access is made by core record.thread_id modulo n_cores.
+   */
+  std::vector<CacheLine*>& Access(const AccessRecord& record);
+
+  /**
+   * Accesses the cache for every record of stream, eg. a TraceMerger over
+   * the streams of each thread. Returns the number of records simulated.
+   */
+  uint64_t Simulate(AccessStream& stream);
+
+  /**
+   * Accesses the cache for the operation described by record, like Access,
+   * without collecting the accessed lines.
+   */
+  void Simulate(const AccessRecord& record);
+
+  /**
+   * Fetches the n_bytes bytes of instructions of a basic block starting at
+   * address, with one instruction fetch per line the block touches.
+   */
+  void FetchBlock(const ADDRESS address, const uint32_t n_bytes,
+      const uint16_t thread_id = 0);
+
+  /**
+   * Writes a table of the statistics of each cache.
    */
-  std::vector<CacheLine*>& Access(const ADDRESS address, const uint8_t n_bytes);
+  friend std::ostream& operator<<(std::ostream& stream,
+      const MultilevelCache& cache);
 };
 
 #endif /* MULTILEVELCACHE_H_ */
@@ -0,0 +1,32 @@
+/*
+ * NextLinePrefetcher.cpp
+ *
+ *  Created on: Sep 9, 2016
+ *      Author: vance
+ */
+
+#include "NextLinePrefetcher.h"
+
+NextLinePrefetcher::NextLinePrefetcher(const uint16_t line_size_B,
+    const uint32_t degree) :
+    line_size_B(line_size_B), degree(degree) {
+}
+
+NextLinePrefetcher::~NextLinePrefetcher() {
+}
+
+void NextLinePrefetcher::Train(const ADDRESS address, const ADDRESS pc,
+    const bool miss, std::vector<ADDRESS>& prefetches) {
+  if (!miss) {
+    return;
+  }
+  const ADDRESS line_address = address - address % line_size_B;
+  for (uint32_t i = 1; i <= degree; i++) {
+    const ADDRESS next = line_address + i * line_size_B;
+    if (next < line_address) {
+      // The end of the address space.
+      break;
+    }
+    prefetches.push_back(next);
+  }
+}
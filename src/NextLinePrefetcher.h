@@ -0,0 +1,36 @@
+/*
+ * NextLinePrefetcher.h
+ *
+ *  Created on: Sep 9, 2016
+ *      Author: vance
+ */
+
+#ifndef NEXTLINEPREFETCHER_H_
+#define NEXTLINEPREFETCHER_H_
+
+#include <stdint.h>
+#include <vector>
+
+#include "Address.h"
+#include "Prefetcher.h"
+
+/**
+ * Prefetches the degree lines that follow a line that missed.
+ */
+class NextLinePrefetcher: public Prefetcher {
+private:
+  const uint16_t line_size_B;
+  const uint32_t degree;
+
+public:
+  /**
+   * Constructs a NextLinePrefetcher for lines of line_size_B bytes.
+   */
+  NextLinePrefetcher(const uint16_t line_size_B, const uint32_t degree = 1);
+  virtual ~NextLinePrefetcher();
+
+  void Train(const ADDRESS address, const ADDRESS pc, const bool miss,
+      std::vector<ADDRESS>& prefetches);
+};
+
+#endif /* NEXTLINEPREFETCHER_H_ */
@@ -0,0 +1,178 @@
+/*
+ * PcAttribution.cpp
+ *
+ *  Created on: Sep 16, 2016
+ *      Author: vance
+ */
+
+#include "PcAttribution.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <stdexcept>
+
+namespace {
+
+uint64_t GetMisses(const PcCounts& counts) {
+  return counts.misses;
+}
+
+uint64_t GetWastedBytes(const PcCounts& counts) {
+  return counts.wasted_bytes + counts.resident_wasted_bytes;
+}
+
+/**
+ * Orders instructions by a counter, the most first.
+ */
+class MoreOf {
+private:
+  uint64_t (*counter)(const PcCounts&);
+
+public:
+  MoreOf(uint64_t (*counter)(const PcCounts&)) :
+      counter(counter) {
+  }
+
+  bool operator()(const PcCounts& a, const PcCounts& b) const {
+    if (counter(a) != counter(b)) {
+      return counter(a) > counter(b);
+    }
+    return a.pc < b.pc;
+  }
+};
+
+void Add(PcCounts& counts, const PcCounts& other) {
+  counts.misses += other.misses;
+  counts.evictions += other.evictions;
+  counts.wasted_bytes += other.wasted_bytes;
+  counts.resident += other.resident;
+  counts.resident_wasted_bytes += other.resident_wasted_bytes;
+}
+
+void WriteRows(std::ostream& stream, const std::vector<PcCounts>& rows) {
+  stream << std::setw(18) << "PC" << std::setw(12) << "Misses"
+      << std::setw(12) << "Evictions" << std::setw(14) << "WastedBytes"
+      << std::setw(12) << "Resident" << std::setw(16) << "ResWastedBytes"
+      << std::endl;
+  for (size_t i = 0; i < rows.size(); i++) {
+    stream << std::setw(18) << std::hex << std::showbase << rows[i].pc
+        << std::dec << std::noshowbase << std::setw(12) << rows[i].misses
+        << std::setw(12) << rows[i].evictions << std::setw(14)
+        << rows[i].wasted_bytes << std::setw(12) << rows[i].resident
+        << std::setw(16) << rows[i].resident_wasted_bytes << std::endl;
+  }
+}
+
+}
+
+PcAttribution::PcAttribution(const uint16_t line_size_B,
+    const size_t n_entries) :
+    n_bits_index(n_entries ? __builtin_ctzll(n_entries) : 0),
+        max_tracked(n_entries - n_entries / 4), n_tracked(0),
+        line_size_B(line_size_B) {
+  if (n_entries < 4 || n_entries & (n_entries - 1)) {
+    throw std::invalid_argument(
+        "A PC table needs a power of two number of entries, at least 4.");
+  }
+  PcCounts empty = PcCounts();
+  entries.resize(n_entries, empty);
+  untracked = empty;
+}
+
+PcAttribution::~PcAttribution() {
+}
+
+size_t PcAttribution::Probe(const ADDRESS pc) const {
+  const size_t mask = entries.size() - 1;
+  size_t index = ((uint64_t) pc * 0x9e3779b97f4a7c15ull)
+      >> (64 - n_bits_index);
+  // The table is never full, so the probe ends.
+  while (entries[index].valid && entries[index].pc != pc) {
+    index = (index + 1) & mask;
+  }
+  return index;
+}
+
+PcCounts& PcAttribution::GetCounts(const ADDRESS pc) {
+  const size_t index = Probe(pc);
+  if (entries[index].valid) {
+    return entries[index];
+  }
+  if (n_tracked == max_tracked) {
+    return untracked;
+  }
+  n_tracked++;
+  entries[index].pc = pc;
+  entries[index].valid = true;
+  return entries[index];
+}
+
+void PcAttribution::Merge(const PcAttribution& other) {
+  if (other.line_size_B != line_size_B) {
+    throw std::invalid_argument("The tables' line sizes differ.");
+  }
+  for (size_t i = 0; i < other.entries.size(); i++) {
+    if (other.entries[i].valid) {
+      Add(GetCounts(other.entries[i].pc), other.entries[i]);
+    }
+  }
+  Add(untracked, other.untracked);
+}
+
+PcCounts PcAttribution::Get(const ADDRESS pc) const {
+  const size_t index = Probe(pc);
+  if (entries[index].valid) {
+    return entries[index];
+  }
+  PcCounts empty = PcCounts();
+  empty.pc = pc;
+  return empty;
+}
+
+std::vector<PcCounts> PcAttribution::GetEntries() const {
+  std::vector<PcCounts> tracked;
+  for (size_t i = 0; i < entries.size(); i++) {
+    if (entries[i].valid) {
+      tracked.push_back(entries[i]);
+    }
+  }
+  return tracked;
+}
+
+std::vector<PcCounts> PcAttribution::GetTop(
+    uint64_t (*counter)(const PcCounts&), const size_t n) const {
+  std::vector<PcCounts> top;
+  for (size_t i = 0; i < entries.size(); i++) {
+    if (entries[i].valid && counter(entries[i])) {
+      top.push_back(entries[i]);
+    }
+  }
+  const size_t n_top = std::min(n, top.size());
+  std::partial_sort(top.begin(), top.begin() + n_top, top.end(),
+      MoreOf(counter));
+  top.resize(n_top);
+  return top;
+}
+
+std::vector<PcCounts> PcAttribution::GetTopMisses(const size_t n) const {
+  return GetTop(GetMisses, n);
+}
+
+std::vector<PcCounts> PcAttribution::GetTopWastedBytes(const size_t n) const {
+  return GetTop(GetWastedBytes, n);
+}
+
+std::ostream& operator<<(std::ostream& stream,
+    const PcAttribution& attribution) {
+  stream << "Top instructions by misses" << std::endl;
+  WriteRows(stream, attribution.GetTopMisses(DEFAULT_PC_REPORT_ROWS));
+  stream << "Top instructions by wasted bytes" << std::endl;
+  WriteRows(stream, attribution.GetTopWastedBytes(DEFAULT_PC_REPORT_ROWS));
+  stream << "Untracked: Misses: " << attribution.untracked.misses
+      << ", Evictions: " << attribution.untracked.evictions
+      << ", WastedBytes: " << attribution.untracked.wasted_bytes
+      << ", Resident: " << attribution.untracked.resident
+      << ", ResWastedBytes: " << attribution.untracked.resident_wasted_bytes
+      << std::endl;
+  return stream;
+}
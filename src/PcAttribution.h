@@ -0,0 +1,158 @@
+/*
+ * PcAttribution.h
+ *
+ *  Created on: Sep 16, 2016
+ *      Author: vance
+ */
+
+#ifndef PCATTRIBUTION_H_
+#define PCATTRIBUTION_H_
+
+#include <iostream>
+#include <stdint.h>
+#include <vector>
+
+#include "Address.h"
+
+#define DEFAULT_PC_ENTRIES 4096
+#define DEFAULT_PC_REPORT_ROWS 20
+
+/**
+ * What one instruction cost the hierarchy.
+ */
+struct PcCounts {
+  ADDRESS pc;
+  // The accesses of the instruction that missed in every level.
+  uint64_t misses;
+  // The lines those misses filled that have left the hierarchy, and the
+  // bytes of those lines that were never accessed.
+  uint64_t evictions;
+  uint64_t wasted_bytes;
+  // The same for the lines still in the hierarchy when it was finalized.
+  uint64_t resident;
+  uint64_t resident_wasted_bytes;
+  bool valid;
+};
+
+/**
+ * Charges the misses of the hierarchy, and the bytes of the lines they filled
+ * that were never used, to the instructions that missed. The line remembers
+ * the instruction that filled it; the bytes it did not use are charged when
+ * it leaves the hierarchy.
+ *
+ * The counts are kept in an open-addressed hash table of a fixed number of
+ * entries. Once it is three quarters full, the instructions it does not hold
+ * are charged to a single untracked entry, so its memory stays bounded
+ * however many instructions miss.
+ */
+class PcAttribution {
+private:
+  std::vector<PcCounts> entries;
+  const uint8_t n_bits_index;
+  const size_t max_tracked;
+  size_t n_tracked;
+  const uint16_t line_size_B;
+
+private:
+  /**
+   * Returns the index of the entry of pc, or of the empty entry where it
+   * would be added.
+   */
+  size_t Probe(const ADDRESS pc) const;
+
+  /**
+   * Returns the entry of pc, adding one if there is room, or the untracked
+   * entry.
+   */
+  PcCounts& GetCounts(const ADDRESS pc);
+
+  /**
+   * Returns the n instructions counted with the most of counter.
+   */
+  std::vector<PcCounts> GetTop(uint64_t (*counter)(const PcCounts&),
+      const size_t n) const;
+
+public:
+  // The charges of the instructions that found the table full.
+  PcCounts untracked;
+
+  /**
+   * Constructs a PcAttribution for lines of line_size_B bytes.
+   *
+   * @param n_entries the entries of the table, a power of two.
+   */
+  PcAttribution(const uint16_t line_size_B,
+      const size_t n_entries = DEFAULT_PC_ENTRIES);
+  virtual ~PcAttribution();
+
+  /**
+   * Charges a miss to pc.
+   */
+  void Miss(const ADDRESS pc) {
+    GetCounts(pc).misses++;
+  }
+
+  /**
+   * Charges the bytes of a line filled by pc that were not among the used_B
+   * bytes accessed before the line left the hierarchy.
+   */
+  void Evict(const ADDRESS pc, const size_t used_B) {
+    PcCounts& counts = GetCounts(pc);
+    counts.evictions++;
+    counts.wasted_bytes += line_size_B - used_B;
+  }
+
+  /**
+   * Charges the bytes of a line filled by pc that were not among the used_B
+   * bytes accessed before the hierarchy was finalized with the line still
+   * resident, see MultilevelCache::Finalize.
+   */
+  void Resident(const ADDRESS pc, const size_t used_B) {
+    PcCounts& counts = GetCounts(pc);
+    counts.resident++;
+    counts.resident_wasted_bytes += line_size_B - used_B;
+  }
+
+  /**
+   * Adds the charges counted by other, eg. by another shard, to these.
+   */
+  void Merge(const PcAttribution& other);
+
+  /**
+   * Returns the counts of pc, which are zero if pc was not charged or is
+   * untracked.
+   */
+  PcCounts Get(const ADDRESS pc) const;
+
+  /**
+   * Returns the counts of every instruction tracked, in no order.
+   */
+  std::vector<PcCounts> GetEntries() const;
+
+  /**
+   * Returns the n instructions with the most misses, the most first.
+   */
+  std::vector<PcCounts> GetTopMisses(const size_t n) const;
+
+  /**
+   * Returns the n instructions with the most wasted bytes, evicted and
+   * resident, the most first.
+   */
+  std::vector<PcCounts> GetTopWastedBytes(const size_t n) const;
+
+  /**
+   * Returns the number of bytes the table takes.
+   */
+  uint64_t GetStorageBytes() const {
+    return entries.size() * sizeof(PcCounts);
+  }
+
+  /**
+   * Writes the DEFAULT_PC_REPORT_ROWS instructions with the most misses,
+   * then those with the most wasted bytes.
+   */
+  friend std::ostream& operator<<(std::ostream& stream,
+      const PcAttribution& attribution);
+};
+
+#endif /* PCATTRIBUTION_H_ */
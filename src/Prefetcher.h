@@ -0,0 +1,53 @@
+/*
+ * Prefetcher.h
+ *
+ *  Created on: Sep 9, 2016
+ *      Author: vance
+ */
+
+#ifndef PREFETCHER_H_
+#define PREFETCHER_H_
+
+#include <stdint.h>
+#include <vector>
+
+#include "Address.h"
+
+/**
+ * A hardware prefetcher attached to one cache of a MultilevelCache.
+ *
+ * The prefetcher is trained with every demand access that looks the cache
+ * up, and asks for lines to be filled into the cache. The hierarchy issues
+ * the requests before the next demand access.
+ */
+class Prefetcher {
+public:
+  virtual ~Prefetcher() {
+  }
+
+  /**
+   * Trains the prefetcher with a demand access to address by the instruction
+   * at pc, which is 0 if unknown. miss is true iff the access missed in the
+   * cache or was the first use of a line prefetched into it, so that a
+   * prefetcher triggered by misses keeps running ahead of a stream it
+   * covers. Appends the addresses of the lines to prefetch to prefetches.
+   */
+  virtual void Train(const ADDRESS address, const ADDRESS pc, const bool miss,
+      std::vector<ADDRESS>& prefetches) = 0;
+
+  /**
+   * Notifies the prefetcher that the line at line_address left the cache,
+   * whether evicted or invalidated.
+   */
+  virtual void Evict(const ADDRESS line_address) {
+  }
+
+  /**
+   * Returns the bytes of metadata the prefetcher would need in hardware.
+   */
+  virtual uint64_t GetStorageBytes() const {
+    return 0;
+  }
+};
+
+#endif /* PREFETCHER_H_ */
@@ -0,0 +1,151 @@
+/*
+ * SharedCaptureRegion.cpp
+ *
+ *  Created on: Sep 2, 2016
+ *      Author: vance
+ */
+
+#include "SharedCaptureRegion.h"
+
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+/**
+ * Rounds size_B up to a whole number of host cache lines.
+ */
+size_t Align(const size_t size_B) {
+  return (size_B + CACHE_LINE_B - 1) & ~(size_t) (CACHE_LINE_B - 1);
+}
+
+}
+
+SharedCaptureRegion::SharedCaptureRegion(const std::string& name,
+    const uint32_t n_slots, const uint64_t capacity, const uint32_t batch) :
+    name(name), owner(true), base(NULL), size_B(0), header(NULL), slots(NULL),
+    records(NULL) {
+  if (n_slots == 0) {
+    throw std::invalid_argument("A region needs a slot.");
+  }
+  if (capacity == 0 || (capacity & (capacity - 1))) {
+    throw std::invalid_argument("Ring capacity must be a power of two.");
+  }
+  if (batch == 0 || batch > capacity) {
+    throw std::invalid_argument("Ring batch must be within the capacity.");
+  }
+  shm_unlink(name.c_str());
+  const int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd < 0) {
+    throw std::runtime_error("Could not create region " + name + ".");
+  }
+  const size_t size = Align(sizeof(Header))
+      + n_slots * (sizeof(SharedSlot) + capacity * sizeof(SharedRecord));
+  if (ftruncate(fd, size) != 0) {
+    close(fd);
+    shm_unlink(name.c_str());
+    throw std::runtime_error("Could not size region " + name + ".");
+  }
+  // The new region is zeroed: every slot is free and empty.
+  Map(fd);
+  header->n_slots = n_slots;
+  header->capacity = capacity;
+  header->batch = batch;
+  slots = (SharedSlot*) ((char*) base + Align(sizeof(Header)));
+  records = (SharedRecord*) (slots + n_slots);
+  // Processes that open the region check the magic last.
+  __atomic_store_n(&header->magic, SHARED_REGION_MAGIC, __ATOMIC_RELEASE);
+}
+
+SharedCaptureRegion::SharedCaptureRegion(const std::string& name) :
+    name(name), owner(false), base(NULL), size_B(0), header(NULL), slots(NULL),
+    records(NULL) {
+  const int fd = shm_open(name.c_str(), O_RDWR, 0);
+  if (fd < 0) {
+    throw std::runtime_error("Could not open region " + name + ".");
+  }
+  Map(fd);
+  if (size_B < sizeof(Header)
+      || __atomic_load_n(&header->magic, __ATOMIC_ACQUIRE)
+          != SHARED_REGION_MAGIC) {
+    munmap(base, size_B);
+    throw std::runtime_error("Region " + name + " is not a capture region.");
+  }
+  slots = (SharedSlot*) ((char*) base + Align(sizeof(Header)));
+  records = (SharedRecord*) (slots + header->n_slots);
+}
+
+SharedCaptureRegion::~SharedCaptureRegion() {
+  munmap(base, size_B);
+  if (owner) {
+    shm_unlink(name.c_str());
+  }
+}
+
+void SharedCaptureRegion::Map(const int fd) {
+  struct stat status;
+  if (fstat(fd, &status) != 0) {
+    close(fd);
+    throw std::runtime_error("Could not map region " + name + ".");
+  }
+  size_B = status.st_size;
+  base = mmap(NULL, size_B, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    if (owner) {
+      shm_unlink(name.c_str());
+    }
+    throw std::runtime_error("Could not map region " + name + ".");
+  }
+  header = (Header*) base;
+}
+
+SharedRing* SharedCaptureRegion::Attach(const uint32_t pid,
+    const uint32_t tid) {
+  for (uint32_t i = 0; i < header->n_slots; i++) {
+    SharedSlot& slot = slots[i];
+    if (!__sync_bool_compare_and_swap(&slot.state, SLOT_FREE, SLOT_CLAIMED)) {
+      continue;
+    }
+    slot.pid = pid;
+    slot.tid = tid;
+    slot.head = 0;
+    slot.tail = 0;
+    slot.unpublished_tail = 0;
+    slot.cached_head = 0;
+    slot.n_dropped = 0;
+    __atomic_store_n(&slot.state, SLOT_ATTACHED, __ATOMIC_RELEASE);
+    return new SharedRing(&slot, records + i * header->capacity,
+        header->capacity, header->batch);
+  }
+  return NULL;
+}
+
+void SharedCaptureRegion::Detach(SharedRing* const ring) {
+  ring->Flush();
+  __atomic_store_n(&ring->slot->state, SLOT_DETACHED, __ATOMIC_RELEASE);
+  delete ring;
+}
+
+size_t SharedCaptureRegion::Pop(const uint32_t slot, SharedRecord* const out,
+    const size_t max) {
+  SharedSlot& shared = slots[slot];
+  const SharedRecord* const ring = records + slot * header->capacity;
+  const uint64_t mask = header->capacity - 1;
+  const uint64_t first = shared.head;
+  const uint64_t available = __atomic_load_n(&shared.tail, __ATOMIC_ACQUIRE)
+      - first;
+  const size_t n = available < max ? available : max;
+  for (size_t i = 0; i < n; i++) {
+    out[i] = ring[(first + i) & mask];
+  }
+  __atomic_store_n(&shared.head, first + n, __ATOMIC_RELEASE);
+  return n;
+}
+
+void SharedCaptureRegion::Release(const uint32_t slot) {
+  __atomic_store_n(&slots[slot].state, SLOT_FREE, __ATOMIC_RELEASE);
+}
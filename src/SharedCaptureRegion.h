@@ -0,0 +1,227 @@
+/*
+ * SharedCaptureRegion.h
+ *
+ *  Created on: Sep 2, 2016
+ *      Author: vance
+ */
+
+#ifndef SHAREDCAPTUREREGION_H_
+#define SHAREDCAPTUREREGION_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+#include "CaptureRing.h"
+
+#define DEFAULT_REGION_SLOTS 64   // threads attached at once
+#define SHARED_REGION_MAGIC 0x56434852   // "VCHR"
+
+/**
+ * An access as captured by another process. The address is the full virtual
+ * address: the daemon translates it before it is narrowed to an ADDRESS.
+ */
+struct SharedRecord {
+  uint64_t address;
+  uint8_t size;
+  // An AccessType.
+  uint8_t type;
+  // A combination of AccessHints.
+  uint8_t hints;
+};
+
+/**
+ * The states of a slot of a SharedCaptureRegion.
+ */
+enum SlotState {
+  SLOT_FREE,
+  // A producer is initializing the slot.
+  SLOT_CLAIMED,
+  SLOT_ATTACHED,
+  // The producer left: the daemon frees the slot once it is drained.
+  SLOT_DETACHED
+};
+
+/**
+ * The ring of one thread, laid out in shared memory. Each index lives on its
+ * own host cache line, as in CaptureRing.
+ */
+struct SharedSlot {
+  uint32_t state;
+  uint32_t pid;
+  uint32_t tid;
+  char state_padding[CACHE_LINE_B - 3 * sizeof(uint32_t)];
+  // Written by the daemon.
+  uint64_t head;
+  char head_padding[CACHE_LINE_B - sizeof(uint64_t)];
+  // Written by the producer: the records visible to the daemon.
+  uint64_t tail;
+  char tail_padding[CACHE_LINE_B - sizeof(uint64_t)];
+  // Written by the producer only.
+  uint64_t unpublished_tail;
+  uint64_t cached_head;
+  uint64_t n_dropped;
+  char producer_padding[CACHE_LINE_B - 3 * sizeof(uint64_t)];
+};
+
+/**
+ * The producer side of a SharedSlot, held by the instrumented thread that
+ * attached it.
+ *
+ * Capture never waits for the daemon: a record that finds the ring full is
+ * dropped and counted in the slot, where the daemon reports it.
+ */
+class SharedRing {
+private:
+  SharedSlot* const slot;
+  SharedRecord* const records;
+  const uint64_t mask;
+  const uint32_t batch;
+
+  friend class SharedCaptureRegion;
+
+public:
+  SharedRing(SharedSlot* const slot, SharedRecord* const records,
+      const uint64_t capacity, const uint32_t batch) :
+      slot(slot), records(records), mask(capacity - 1), batch(batch) {
+  }
+
+  /**
+   * Appends record to the ring. Returns false, and drops the record, if the
+   * ring is full.
+   */
+  bool Push(const SharedRecord& record) {
+    if (slot->unpublished_tail - slot->cached_head == mask + 1) {
+      slot->cached_head = __atomic_load_n(&slot->head, __ATOMIC_ACQUIRE);
+      if (slot->unpublished_tail - slot->cached_head == mask + 1) {
+        Flush();
+        __atomic_store_n(&slot->n_dropped, slot->n_dropped + 1,
+            __ATOMIC_RELAXED);
+        return false;
+      }
+    }
+    records[slot->unpublished_tail & mask] = record;
+    slot->unpublished_tail++;
+    if (slot->unpublished_tail - slot->tail >= batch) {
+      Flush();
+    }
+    return true;
+  }
+
+  /**
+   * Publishes the records appended since the last publication.
+   */
+  void Flush() {
+    __atomic_store_n(&slot->tail, slot->unpublished_tail, __ATOMIC_RELEASE);
+  }
+};
+
+/**
+ * A POSIX shared-memory region of per-thread rings, through which the threads
+ * of any number of instrumented processes feed one simulator daemon.
+ *
+ * The daemon creates the region and owns its name. A process opens it by
+ * name, and each of its threads attaches a free slot, so processes come and
+ * go while the daemon runs. A slot is drained by the daemon only: a detached
+ * slot becomes free again once its records are simulated.
+ */
+class SharedCaptureRegion {
+private:
+  struct Header {
+    uint32_t magic;
+    uint32_t n_slots;
+    uint64_t capacity;
+    uint32_t batch;
+  };
+
+  const std::string name;
+  const bool owner;
+  void* base;
+  size_t size_B;
+  Header* header;
+  SharedSlot* slots;
+  SharedRecord* records;
+
+private:
+  void Map(const int fd);
+
+public:
+  /**
+   * Creates the region name, replacing any stale region of that name. For
+   * the daemon: the region is removed when it is destroyed.
+   *
+   * @param name the POSIX shared-memory name, eg. "/vcache".
+   * @param n_slots the number of threads that may be attached at once.
+   * @param capacity the records of each ring, a power of two.
+   * @param batch the publication batch of each ring, see CaptureRing.
+   */
+  SharedCaptureRegion(const std::string& name, const uint32_t n_slots,
+      const uint64_t capacity = DEFAULT_RING_CAPACITY, const uint32_t batch =
+          DEFAULT_RING_BATCH);
+
+  /**
+   * Opens the region name created by a daemon. For instrumented processes.
+   */
+  SharedCaptureRegion(const std::string& name);
+  virtual ~SharedCaptureRegion();
+
+  /**
+   * Attaches thread tid of process pid to a free slot. Returns its ring, to
+   * be detached by the thread, or NULL if every slot is taken.
+   */
+  SharedRing* Attach(const uint32_t pid, const uint32_t tid);
+
+  /**
+   * Publishes the records of ring and leaves its slot to the daemon.
+   */
+  void Detach(SharedRing* const ring);
+
+  uint32_t GetSlotCount() const {
+    return header->n_slots;
+  }
+
+  uint64_t GetCapacity() const {
+    return header->capacity;
+  }
+
+  SlotState GetState(const uint32_t slot) const {
+    return (SlotState) __atomic_load_n(&slots[slot].state, __ATOMIC_ACQUIRE);
+  }
+
+  uint32_t GetPid(const uint32_t slot) const {
+    return slots[slot].pid;
+  }
+
+  uint32_t GetTid(const uint32_t slot) const {
+    return slots[slot].tid;
+  }
+
+  /**
+   * Returns the number of records the producer of slot dropped.
+   */
+  uint64_t GetDroppedCount(const uint32_t slot) const {
+    return __atomic_load_n(&slots[slot].n_dropped, __ATOMIC_RELAXED);
+  }
+
+  /**
+   * Returns the number of published records of slot not yet popped.
+   */
+  uint64_t GetBacklog(const uint32_t slot) const {
+    return __atomic_load_n(&slots[slot].tail, __ATOMIC_ACQUIRE)
+        - slots[slot].head;
+  }
+
+  /**
+   * Moves up to max published records of slot into out and returns how many
+   * it moved. Daemon only.
+   */
+  size_t Pop(const uint32_t slot, SharedRecord* const out, const size_t max);
+
+  /**
+   * Frees slot for another thread. Daemon only, once a detached slot is
+   * drained or its process has died.
+   */
+  void Release(const uint32_t slot);
+};
+
+#endif /* SHAREDCAPTUREREGION_H_ */
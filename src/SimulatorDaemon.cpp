@@ -0,0 +1,258 @@
+/*
+ * SimulatorDaemon.cpp
+ *
+ *  Created on: Sep 2, 2016
+ *      Author: vance
+ */
+
+#include "SimulatorDaemon.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <iomanip>
+#include <sched.h>
+#include <signal.h>
+#include <sstream>
+#include <stdexcept>
+#include <unistd.h>
+
+#include "CapturePipeline.h"
+
+#define PAGEMAP_PRESENT (1ull << 63)
+#define PAGEMAP_FRAME_MASK ((1ull << 55) - 1)
+
+SimulatorDaemon::SimulatorDaemon(SharedCaptureRegion& region,
+    ConcurrentMultilevelCache& cache, const uint32_t n_simulators,
+    const bool physical, const SamplingMode mode, const uint32_t max_period) :
+    region(region), cache(cache), physical(physical), mode(mode),
+    max_period(max_period), n_bits_page(0), stopping(false), running(false) {
+  if (n_simulators == 0) {
+    throw std::invalid_argument("A daemon needs a simulator.");
+  }
+  // Throws for an invalid period before any slot holds a sampler.
+  BackpressureSampler(region.GetCapacity(), cache.line_size_B, mode,
+      max_period, cache.GetShardCount());
+  for (long page_size_B = sysconf(_SC_PAGESIZE); page_size_B > 1;
+      page_size_B >>= 1) {
+    n_bits_page++;
+  }
+  slots.resize(region.GetSlotCount());
+  for (size_t i = 0; i < slots.size(); i++) {
+    slots[i].open = false;
+    slots[i].sampler = NULL;
+    slots[i].pagemap = -1;
+  }
+  simulators.resize(n_simulators);
+  for (uint32_t i = 0; i < n_simulators; i++) {
+    simulators[i].daemon = this;
+    simulators[i].index = i;
+  }
+  pthread_mutex_init(&finished_lock, NULL);
+}
+
+SimulatorDaemon::~SimulatorDaemon() {
+  Stop();
+  for (size_t i = 0; i < slots.size(); i++) {
+    if (slots[i].pagemap >= 0) {
+      close(slots[i].pagemap);
+    }
+    delete slots[i].sampler;
+  }
+  pthread_mutex_destroy(&finished_lock);
+}
+
+void SimulatorDaemon::Start() {
+  if (running) {
+    return;
+  }
+  __atomic_store_n(&stopping, false, __ATOMIC_RELEASE);
+  for (size_t i = 0; i < simulators.size(); i++) {
+    if (pthread_create(&simulators[i].thread, NULL, Simulate,
+        &simulators[i])) {
+      throw std::runtime_error("Could not start a simulator thread.");
+    }
+  }
+  running = true;
+}
+
+void SimulatorDaemon::Stop() {
+  if (!running) {
+    return;
+  }
+  __atomic_store_n(&stopping, true, __ATOMIC_RELEASE);
+  for (size_t i = 0; i < simulators.size(); i++) {
+    pthread_join(simulators[i].thread, NULL);
+  }
+  running = false;
+}
+
+void* SimulatorDaemon::Simulate(void* argument) {
+  Simulator* const simulator = (Simulator*) argument;
+  SimulatorDaemon* const daemon = simulator->daemon;
+  while (true) {
+    // Read the flag before draining, as in CapturePipeline.
+    const bool stopping = __atomic_load_n(&daemon->stopping,
+        __ATOMIC_ACQUIRE);
+    size_t n_drained = 0;
+    for (size_t slot = simulator->index; slot < daemon->slots.size(); slot +=
+        daemon->simulators.size()) {
+      n_drained += daemon->Drain(slot);
+    }
+    if (n_drained == 0) {
+      if (stopping) {
+        break;
+      }
+      sched_yield();
+    }
+  }
+  return NULL;
+}
+
+size_t SimulatorDaemon::Drain(const uint32_t index) {
+  const SlotState state = region.GetState(index);
+  if (state != SLOT_ATTACHED && state != SLOT_DETACHED) {
+    return 0;
+  }
+  Slot& slot = slots[index];
+  if (!slot.open) {
+    Open(index);
+  }
+  slot.sampler->Update(region.GetBacklog(index));
+  SharedRecord records[DEFAULT_DRAIN_BATCH];
+  const size_t n = region.Pop(index, records, DEFAULT_DRAIN_BATCH);
+  for (size_t i = 0; i < n; i++) {
+    const SharedRecord& record = records[i];
+    // Sets are sampled by virtual address: translating the records that
+    // are not simulated would cost as much as simulating them.
+    if (slot.sampler->Sample(record.address)) {
+      cache.Access(AccessRecord(Translate(slot, record.address), record.size,
+          (AccessType) record.type, record.hints, index));
+    }
+  }
+  slot.stats.n_simulated = slot.sampler->n_simulated;
+  slot.stats.n_sampled_out = slot.sampler->n_records
+      - slot.sampler->n_simulated;
+  slot.stats.peak_period = slot.sampler->peak_period;
+  // A detached slot is empty once a pop after the detach found nothing. A
+  // thread whose process died never detaches.
+  if (n == 0 && (state == SLOT_DETACHED
+      || (kill(slot.stats.pid, 0) != 0 && errno == ESRCH))) {
+    Close(index);
+  }
+  return n;
+}
+
+ADDRESS SimulatorDaemon::Translate(Slot& slot, const uint64_t address) {
+  if (!physical) {
+    return address;
+  }
+  const uint64_t page = address >> n_bits_page;
+  const uint64_t offset = address & ((1ull << n_bits_page) - 1);
+  boost::unordered_map<uint64_t, uint64_t>::const_iterator found =
+      slot.frames.find(page);
+  if (found != slot.frames.end()) {
+    return (found->second << n_bits_page) | offset;
+  }
+  uint64_t entry;
+  if (slot.pagemap >= 0
+      && pread(slot.pagemap, &entry, sizeof(entry), page * sizeof(entry))
+          == sizeof(entry) && (entry & PAGEMAP_PRESENT)) {
+    const uint64_t frame = entry & PAGEMAP_FRAME_MASK;
+    if (frame != 0) {
+      slot.frames[page] = frame;
+      return (frame << n_bits_page) | offset;
+    }
+    // Frame numbers read as zero without CAP_SYS_ADMIN: stop trying.
+    close(slot.pagemap);
+    slot.pagemap = -1;
+  }
+  // A page that is not present is tried again on its next access.
+  slot.stats.n_untranslated++;
+  return address;
+}
+
+void SimulatorDaemon::Open(const uint32_t index) {
+  Slot& slot = slots[index];
+  slot.open = true;
+  slot.stats.pid = region.GetPid(index);
+  slot.stats.tid = region.GetTid(index);
+  slot.stats.thread_id = index;
+  slot.stats.n_simulated = 0;
+  slot.stats.n_sampled_out = 0;
+  slot.stats.peak_period = 1;
+  slot.stats.n_dropped = 0;
+  slot.stats.n_untranslated = 0;
+  delete slot.sampler;
+  slot.sampler = new BackpressureSampler(region.GetCapacity(),
+      cache.line_size_B, mode, max_period, cache.GetShardCount());
+  slot.frames.clear();
+  if (physical) {
+    std::ostringstream path;
+    path << "/proc/" << slot.stats.pid << "/pagemap";
+    slot.pagemap = open(path.str().c_str(), O_RDONLY);
+  }
+}
+
+void SimulatorDaemon::Close(const uint32_t index) {
+  Slot& slot = slots[index];
+  slot.stats.n_dropped = region.GetDroppedCount(index);
+  pthread_mutex_lock(&finished_lock);
+  finished.push_back(slot.stats);
+  pthread_mutex_unlock(&finished_lock);
+  if (slot.pagemap >= 0) {
+    close(slot.pagemap);
+    slot.pagemap = -1;
+  }
+  slot.frames.clear();
+  slot.open = false;
+  region.Release(index);
+}
+
+std::vector<CaptureStats> SimulatorDaemon::GetStats() const {
+  std::vector<CaptureStats> stats(finished);
+  for (size_t i = 0; i < slots.size(); i++) {
+    if (slots[i].open) {
+      stats.push_back(slots[i].stats);
+      stats.back().n_dropped = region.GetDroppedCount(i);
+    }
+  }
+  return stats;
+}
+
+double SimulatorDaemon::GetSamplingRatio() const {
+  const std::vector<CaptureStats> stats = GetStats();
+  uint64_t n_simulated = 0;
+  uint64_t n_captured = 0;
+  for (size_t i = 0; i < stats.size(); i++) {
+    n_simulated += stats[i].n_simulated;
+    n_captured += stats[i].n_simulated + stats[i].n_sampled_out
+        + stats[i].n_dropped;
+  }
+  return n_captured ? (double) n_simulated / n_captured : 1.0;
+}
+
+std::ostream& operator<<(std::ostream& stream, const SimulatorDaemon& daemon) {
+  const std::vector<CaptureStats> stats = daemon.GetStats();
+  CaptureStats total = CaptureStats();
+  stream << std::setw(8) << "Pid" << std::setw(8) << "Tid" << std::setw(8)
+      << "Thread" << std::setw(14) << "Simulated" << std::setw(14)
+      << "SampledOut" << std::setw(14) << "Dropped" << std::setw(14)
+      << "Untranslated" << std::setw(12) << "PeakPeriod" << std::endl;
+  for (size_t i = 0; i < stats.size(); i++) {
+    stream << std::setw(8) << stats[i].pid << std::setw(8) << stats[i].tid
+        << std::setw(8) << stats[i].thread_id << std::setw(14)
+        << stats[i].n_simulated << std::setw(14) << stats[i].n_sampled_out
+        << std::setw(14) << stats[i].n_dropped << std::setw(14)
+        << stats[i].n_untranslated << std::setw(12) << stats[i].peak_period
+        << std::endl;
+    total.n_simulated += stats[i].n_simulated;
+    total.n_sampled_out += stats[i].n_sampled_out;
+    total.n_dropped += stats[i].n_dropped;
+    total.n_untranslated += stats[i].n_untranslated;
+  }
+  stream << std::setw(24) << "Total" << std::setw(14) << total.n_simulated
+      << std::setw(14) << total.n_sampled_out << std::setw(14)
+      << total.n_dropped << std::setw(14) << total.n_untranslated << std::endl;
+  stream << "Sampling ratio: " << daemon.GetSamplingRatio() << std::endl;
+  return stream;
+}
@@ -0,0 +1,165 @@
+/*
+ * SimulatorDaemon.h
+ *
+ *  Created on: Sep 2, 2016
+ *      Author: vance
+ */
+
+#ifndef SIMULATORDAEMON_H_
+#define SIMULATORDAEMON_H_
+
+#include <boost/unordered_map.hpp>
+#include <iostream>
+#include <pthread.h>
+#include <stdint.h>
+#include <vector>
+
+#include "BackpressureSampler.h"
+#include "ConcurrentMultilevelCache.h"
+#include "SharedCaptureRegion.h"
+
+/**
+ * What became of the records of one attached thread.
+ */
+struct CaptureStats {
+  uint32_t pid;
+  uint32_t tid;
+  // The thread id the daemon gave the thread's accesses: its slot.
+  uint16_t thread_id;
+  uint64_t n_simulated;
+  // Records discarded by the daemon while it was behind.
+  uint64_t n_sampled_out;
+  // The longest sampling period that applied.
+  uint32_t peak_period;
+  // Records the thread dropped because its ring was full.
+  uint64_t n_dropped;
+  // Records simulated at their virtual address because their page could not
+  // be translated.
+  uint64_t n_untranslated;
+};
+
+/**
+ * Simulates the threads of every process attached to a SharedCaptureRegion
+ * against one shared hierarchy, eg. the master and workers of a service
+ * sharing an LLC.
+ *
+ * The accesses of the thread in slot i are simulated as thread i, so they
+ * run on core i modulo the cores of the hierarchy. Addresses are virtual
+ * unless physical addresses are requested: then each page is translated
+ * through /proc/<pid>/pagemap, so pages that processes share alias. Reading
+ * frame numbers needs CAP_SYS_ADMIN; without it, pages keep their virtual
+ * address. Either way the address is narrowed to an ADDRESS.
+ *
+ * Producers never wait. When the daemon falls behind a thread it samples the
+ * thread's records, see BackpressureSampler; if the ring fills anyway, the
+ * thread drops records. Both losses are counted per thread, and the report
+ * annotates the statistics with the share of the trace that was simulated.
+ */
+class SimulatorDaemon {
+private:
+  struct Slot {
+    // Whether the stats belong to the thread attached to the slot.
+    bool open;
+    CaptureStats stats;
+    BackpressureSampler* sampler;
+    // The virtual page to frame translations of the slot's process.
+    boost::unordered_map<uint64_t, uint64_t> frames;
+    int pagemap;
+  };
+
+  struct Simulator {
+    pthread_t thread;
+    SimulatorDaemon* daemon;
+    uint32_t index;
+  };
+
+  SharedCaptureRegion& region;
+  ConcurrentMultilevelCache& cache;
+  const bool physical;
+  const SamplingMode mode;
+  const uint32_t max_period;
+  uint8_t n_bits_page;
+  std::vector<Slot> slots;
+  std::vector<Simulator> simulators;
+  // The stats of threads whose slots were released.
+  std::vector<CaptureStats> finished;
+  pthread_mutex_t finished_lock;
+  bool stopping;
+  bool running;
+
+private:
+  /**
+   * The body of a simulator thread: drains slots index, index +
+   * n_simulators and so on until the daemon stops and they are empty.
+   */
+  static void* Simulate(void* simulator);
+
+  /**
+   * Simulates the records the thread in slot has published. Returns the
+   * number of records popped.
+   */
+  size_t Drain(const uint32_t slot);
+
+  /**
+   * Returns the ADDRESS the virtual address of slot is simulated at.
+   */
+  ADDRESS Translate(Slot& slot, const uint64_t address);
+
+  /**
+   * Starts the stats of the thread that attached slot.
+   */
+  void Open(const uint32_t slot);
+
+  /**
+   * Retires the stats of slot and frees it.
+   */
+  void Close(const uint32_t slot);
+
+public:
+  /**
+   * Constructs a stopped SimulatorDaemon.
+   *
+   * @param region the rings the threads write. Not owned.
+   * @param cache the hierarchy the threads share. Not owned.
+   * @param n_simulators the number of simulator threads.
+   * @param physical whether to simulate physical addresses.
+   * @param mode how to sample a thread the daemon falls behind.
+   * @param max_period the longest sampling period, see BackpressureSampler.
+   */
+  SimulatorDaemon(SharedCaptureRegion& region,
+      ConcurrentMultilevelCache& cache, const uint32_t n_simulators = 1,
+      const bool physical = false, const SamplingMode mode = SAMPLING_SETS,
+      const uint32_t max_period = DEFAULT_MAX_SAMPLE_PERIOD);
+  virtual ~SimulatorDaemon();
+
+  /**
+   * Starts the simulator threads.
+   */
+  void Start();
+
+  /**
+   * Waits for the simulators to drain every record published so far, then
+   * stops them.
+   */
+  void Stop();
+
+  /**
+   * Returns the stats of every thread that attached, in the order they
+   * detached and then by slot. Call while stopped.
+   */
+  std::vector<CaptureStats> GetStats() const;
+
+  /**
+   * Returns the fraction of the records captured, including those dropped,
+   * that were simulated. Call while stopped.
+   */
+  double GetSamplingRatio() const;
+
+  /**
+   * Writes one row per thread and the totals.
+   */
+  friend std::ostream& operator<<(std::ostream& stream,
+      const SimulatorDaemon& daemon);
+};
+
+#endif /* SIMULATORDAEMON_H_ */
@@ -0,0 +1,160 @@
+/*
+ * SpatialPrefetcher.cpp
+ *
+ *  Created on: Sep 12, 2016
+ *      Author: vance
+ */
+
+#include "SpatialPrefetcher.h"
+
+#include <stdexcept>
+
+SpatialPrefetcher::SpatialPrefetcher(const uint16_t line_size_B,
+    const uint32_t region_size_B, const uint32_t n_generations,
+    const uint32_t n_patterns) :
+    line_size_B(line_size_B), region_size_B(region_size_B), n_region_lines(
+        region_size_B / line_size_B), n_accesses(0), n_predictions(0),
+        predicted_lines(0), covered_lines(0), uncovered_lines(0) {
+  if (region_size_B < line_size_B || region_size_B % line_size_B
+      || n_region_lines & (n_region_lines - 1)) {
+    throw std::invalid_argument(
+        "A spatial region must be a power of two number of lines.");
+  }
+  if (n_generations == 0 || n_patterns == 0) {
+    throw std::invalid_argument(
+        "A spatial prefetcher needs a generation and a pattern.");
+  }
+  Generation generation;
+  generation.valid = false;
+  generation.region = 0;
+  generation.trigger = 0;
+  generation.footprint.resize(n_region_lines);
+  generation.last_use = 0;
+  generations.resize(n_generations, generation);
+  Pattern pattern;
+  pattern.valid = false;
+  pattern.trigger = 0;
+  pattern.footprint.resize(n_region_lines);
+  patterns.resize(n_patterns, pattern);
+  footprint_utilizations.resize(n_region_lines, 0);
+}
+
+SpatialPrefetcher::~SpatialPrefetcher() {
+}
+
+SpatialPrefetcher::Generation* SpatialPrefetcher::Find(const ADDRESS region) {
+  for (size_t i = 0; i < generations.size(); i++) {
+    if (generations[i].valid && generations[i].region == region) {
+      return &generations[i];
+    }
+  }
+  return NULL;
+}
+
+void SpatialPrefetcher::End(Generation& generation) {
+  Pattern& pattern = patterns[generation.trigger % patterns.size()];
+  pattern.valid = true;
+  pattern.trigger = generation.trigger;
+  pattern.footprint = generation.footprint;
+
+  if (generation.prediction.any()) {
+    const size_t covered = (generation.prediction & generation.footprint)
+        .count();
+    predicted_lines += generation.prediction.count();
+    covered_lines += covered;
+    // The trigger is in the footprint but was never predicted.
+    uncovered_lines += (generation.footprint - generation.prediction).count()
+        - 1;
+    if (covered) {
+      footprint_utilizations.at(covered - 1)++;
+    }
+  }
+  generation.valid = false;
+}
+
+void SpatialPrefetcher::Train(const ADDRESS address, const ADDRESS pc,
+    const bool miss, std::vector<ADDRESS>& prefetches) {
+  const ADDRESS region = address / region_size_B;
+  const uint32_t offset = address % region_size_B / line_size_B;
+  n_accesses++;
+
+  Generation* generation = Find(region);
+  if (generation != NULL) {
+    generation->footprint.set(offset);
+    generation->last_use = n_accesses;
+    return;
+  }
+  if (!miss) {
+    return;
+  }
+
+  generation = &generations[0];
+  for (size_t i = 1; i < generations.size() && generation->valid; i++) {
+    if (!generations[i].valid
+        || generations[i].last_use < generation->last_use) {
+      generation = &generations[i];
+    }
+  }
+  if (generation->valid) {
+    End(*generation);
+  }
+  generation->valid = true;
+  generation->region = region;
+  generation->trigger = (uint64_t) pc * n_region_lines + offset;
+  generation->footprint.reset();
+  generation->footprint.set(offset);
+  generation->last_use = n_accesses;
+  generation->prediction.clear();
+
+  const Pattern& pattern = patterns[generation->trigger % patterns.size()];
+  if (!pattern.valid || pattern.trigger != generation->trigger) {
+    return;
+  }
+  generation->prediction = pattern.footprint;
+  generation->prediction.reset(offset);
+  if (generation->prediction.none()) {
+    generation->prediction.clear();
+    return;
+  }
+  n_predictions++;
+  const ADDRESS region_address = region * region_size_B;
+  for (size_t line = generation->prediction.find_first();
+      line != boost::dynamic_bitset<>::npos;
+      line = generation->prediction.find_next(line)) {
+    prefetches.push_back(region_address + line * line_size_B);
+  }
+}
+
+void SpatialPrefetcher::Evict(const ADDRESS line_address) {
+  Generation* const generation = Find(line_address / region_size_B);
+  if (generation != NULL
+      && generation->footprint.test(
+          line_address % region_size_B / line_size_B)) {
+    End(*generation);
+  }
+}
+
+double SpatialPrefetcher::GetAccuracy() const {
+  return predicted_lines ? (double) covered_lines / predicted_lines : 0;
+}
+
+double SpatialPrefetcher::GetCoverage() const {
+  const uint64_t used = covered_lines + uncovered_lines;
+  return used ? (double) covered_lines / used : 0;
+}
+
+uint64_t SpatialPrefetcher::GetStorageBytes() const {
+  const uint32_t offset_bits = __builtin_ctz(n_region_lines);
+  const uint32_t region_bits = sizeof(ADDRESS) * 8
+      - __builtin_ctz(region_size_B);
+  const uint32_t trigger_bits = sizeof(ADDRESS) * 8 + offset_bits;
+  const uint32_t lru_bits = generations.size() > 1 ?
+      32 - __builtin_clz(generations.size() - 1) : 0;
+  // A generation has a valid bit, its region, trigger, footprint, prediction
+  // and LRU state; a pattern a valid bit, its trigger and footprint.
+  const uint64_t generation_bits = 1 + region_bits + trigger_bits
+      + 2 * n_region_lines + lru_bits;
+  const uint64_t pattern_bits = 1 + trigger_bits + n_region_lines;
+  return (generation_bits * generations.size()
+      + pattern_bits * patterns.size() + 7) / 8;
+}
@@ -0,0 +1,121 @@
+/*
+ * SpatialPrefetcher.h
+ *
+ *  Created on: Sep 12, 2016
+ *      Author: vance
+ */
+
+#ifndef SPATIALPREFETCHER_H_
+#define SPATIALPREFETCHER_H_
+
+#include <boost/dynamic_bitset.hpp>
+#include <stdint.h>
+#include <vector>
+
+#include "Address.h"
+#include "Prefetcher.h"
+
+#define DEFAULT_SPATIAL_REGION 2048
+#define DEFAULT_GENERATIONS 32
+#define DEFAULT_PATTERNS 1024
+
+/**
+ * Spatial memory streaming: learns the footprint of lines a program touches
+ * in a region of memory, and prefetches the whole footprint the next time the
+ * same access triggers a visit to a region.
+ *
+ * A generation starts with a miss to a region that has no active generation,
+ * its trigger. The trigger is identified by its pc and by the offset of its
+ * line in the region. The generation records the lines of the region accessed
+ * until one of them leaves the cache, or the generation is replaced by a
+ * newer one. Its footprint is then stored in the pattern table under the
+ * trigger. A trigger found in the table prefetches the lines of its footprint.
+ *
+ * When a predicted generation ends, its prediction is scored against the
+ * footprint it actually had, like the byte utilization of a line: the lines
+ * predicted and used, predicted and unused, and used but not predicted.
+ * Generations still active are not scored.
+ */
+class SpatialPrefetcher: public Prefetcher {
+private:
+  struct Generation {
+    bool valid;
+    ADDRESS region;
+    uint64_t trigger;
+    boost::dynamic_bitset<> footprint;
+    // The footprint predicted when the generation started, if any.
+    boost::dynamic_bitset<> prediction;
+    uint64_t last_use;
+  };
+
+  struct Pattern {
+    bool valid;
+    uint64_t trigger;
+    boost::dynamic_bitset<> footprint;
+  };
+
+  const uint16_t line_size_B;
+  const uint32_t region_size_B;
+  const uint32_t n_region_lines;
+  std::vector<Generation> generations;
+  std::vector<Pattern> patterns;
+  uint64_t n_accesses;
+
+private:
+  /**
+   * Returns the active generation of region, or NULL.
+   */
+  Generation* Find(const ADDRESS region);
+
+  /**
+   * Stores the footprint of generation under its trigger, scores its
+   * prediction and frees it.
+   */
+  void End(Generation& generation);
+
+public:
+  // The number of generations that started with a prediction.
+  uint64_t n_predictions;
+  // The lines prefetched by predictions that have been scored.
+  uint64_t predicted_lines;
+  // Of those, the lines the generation used.
+  uint64_t covered_lines;
+  // The lines scored generations used that were not predicted, other than
+  // their triggers.
+  uint64_t uncovered_lines;
+  // Entry i counts the scored predictions of which i + 1 lines were used.
+  std::vector<uint64_t> footprint_utilizations;
+
+  /**
+   * Constructs a SpatialPrefetcher for lines of line_size_B bytes.
+   *
+   * @param region_size_B the bytes of a region, a power of two multiple of
+   *     the line size.
+   * @param n_generations the number of regions tracked at once.
+   * @param n_patterns the number of footprints remembered.
+   */
+  SpatialPrefetcher(const uint16_t line_size_B, const uint32_t region_size_B =
+      DEFAULT_SPATIAL_REGION, const uint32_t n_generations =
+      DEFAULT_GENERATIONS, const uint32_t n_patterns = DEFAULT_PATTERNS);
+  virtual ~SpatialPrefetcher();
+
+  void Train(const ADDRESS address, const ADDRESS pc, const bool miss,
+      std::vector<ADDRESS>& prefetches);
+
+  uint64_t GetStorageBytes() const;
+
+  void Evict(const ADDRESS line_address);
+
+  /**
+   * Returns the fraction of the predicted lines that were used.
+   */
+  double GetAccuracy() const;
+
+  /**
+   * Returns the fraction of the lines used by predicted generations, other
+   * than their triggers, that were predicted.
+   */
+  double GetCoverage() const;
+};
+
+#endif /* SPATIALPREFETCHER_H_ */
@@ -0,0 +1,94 @@
+/*
+ * StreamPrefetcher.cpp
+ *
+ *  Created on: Sep 9, 2016
+ *      Author: vance
+ */
+
+#include "StreamPrefetcher.h"
+
+#include <stdexcept>
+
+StreamPrefetcher::StreamPrefetcher(const uint16_t line_size_B,
+    const uint32_t degree, const uint32_t distance, const uint32_t n_streams) :
+    line_size_B(line_size_B), degree(degree), distance(distance),
+    n_accesses(0) {
+  if (n_streams == 0) {
+    throw std::invalid_argument("A stream prefetcher needs a stream.");
+  }
+  Stream empty;
+  empty.valid = false;
+  empty.line = 0;
+  empty.direction = 0;
+  empty.next = 0;
+  empty.last_use = 0;
+  streams.resize(n_streams, empty);
+}
+
+StreamPrefetcher::~StreamPrefetcher() {
+}
+
+void StreamPrefetcher::Train(const ADDRESS address, const ADDRESS pc,
+    const bool miss, std::vector<ADDRESS>& prefetches) {
+  const int64_t line = address / line_size_B;
+  n_accesses++;
+
+  Stream* stream = NULL;
+  for (size_t i = 0; i < streams.size() && stream == NULL; i++) {
+    const int64_t delta = line - streams[i].line;
+    if (streams[i].valid && delta <= (int64_t) distance
+        && delta >= -(int64_t) distance) {
+      stream = &streams[i];
+    }
+  }
+  if (stream == NULL) {
+    if (!miss) {
+      return;
+    }
+    Stream* victim = &streams[0];
+    for (size_t i = 1; i < streams.size() && victim->valid; i++) {
+      if (!streams[i].valid || streams[i].last_use < victim->last_use) {
+        victim = &streams[i];
+      }
+    }
+    victim->valid = true;
+    victim->line = line;
+    victim->direction = 0;
+    victim->last_use = n_accesses;
+    return;
+  }
+
+  stream->last_use = n_accesses;
+  if (stream->direction == 0) {
+    if (line == stream->line) {
+      return;
+    }
+    stream->direction = line > stream->line ? 1 : -1;
+    stream->next = line + stream->direction;
+  } else if ((line - stream->line) * stream->direction <= 0) {
+    // The access does not advance the stream.
+    return;
+  }
+  stream->line = line;
+
+  if ((stream->next - line) * stream->direction <= 0) {
+    // The demand accesses overtook the prefetches.
+    stream->next = line + stream->direction;
+  }
+  const int64_t last_line = UINT32_MAX / line_size_B;
+  for (uint32_t i = 0; i < degree
+      && (stream->next - line) * stream->direction <= (int64_t) distance
+      && stream->next >= 0 && stream->next <= last_line; i++) {
+    prefetches.push_back(stream->next * line_size_B);
+    stream->next += stream->direction;
+  }
+}
+
+uint64_t StreamPrefetcher::GetStorageBytes() const {
+  const uint32_t line_bits = sizeof(ADDRESS) * 8 - __builtin_ctz(line_size_B);
+  const uint32_t lru_bits = streams.size() > 1 ?
+      32 - __builtin_clz(streams.size() - 1) : 0;
+  // A valid bit, the last and next lines, the direction and the LRU state.
+  const uint64_t stream_bits = 1 + 2 * line_bits + 2 + lru_bits;
+  return (stream_bits * streams.size() + 7) / 8;
+}
@@ -0,0 +1,66 @@
+/*
+ * StreamPrefetcher.h
+ *
+ *  Created on: Sep 9, 2016
+ *      Author: vance
+ */
+
+#ifndef STREAMPREFETCHER_H_
+#define STREAMPREFETCHER_H_
+
+#include <stdint.h>
+#include <vector>
+
+#include "Address.h"
+#include "Prefetcher.h"
+
+#define DEFAULT_STREAMS 16
+
+/**
+ * Detects streams of ascending or descending lines and runs ahead of them.
+ *
+ * A miss that is not near a tracked stream starts training a new one,
+ * replacing the least recently used stream. A second access within distance
+ * lines of it sets its direction. From then on every access that advances
+ * the stream prefetches up to degree lines, keeping the prefetched lines up
+ * to distance lines ahead of the demand accesses.
+ */
+class StreamPrefetcher: public Prefetcher {
+private:
+  struct Stream {
+    bool valid;
+    // The line of the last access that advanced the stream.
+    int64_t line;
+    // 1 or -1, or 0 while training.
+    int64_t direction;
+    // The next line to prefetch.
+    int64_t next;
+    uint64_t last_use;
+  };
+
+  const uint16_t line_size_B;
+  const uint32_t degree;
+  const uint32_t distance;
+  std::vector<Stream> streams;
+  uint64_t n_accesses;
+
+public:
+  /**
+   * Constructs a StreamPrefetcher for lines of line_size_B bytes.
+   *
+   * @param degree the most lines prefetched per access.
+   * @param distance how many lines ahead of the stream to prefetch.
+   * @param n_streams the number of streams tracked.
+   */
+  StreamPrefetcher(const uint16_t line_size_B, const uint32_t degree = 2,
+      const uint32_t distance = 16, const uint32_t n_streams =
+          DEFAULT_STREAMS);
+  virtual ~StreamPrefetcher();
+
+  void Train(const ADDRESS address, const ADDRESS pc, const bool miss,
+      std::vector<ADDRESS>& prefetches);
+
+  uint64_t GetStorageBytes() const;
+};
+
+#endif /* STREAMPREFETCHER_H_ */
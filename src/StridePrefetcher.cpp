@@ -0,0 +1,78 @@
+/*
+ * StridePrefetcher.cpp
+ *
+ *  Created on: Sep 9, 2016
+ *      Author: vance
+ */
+
+#include "StridePrefetcher.h"
+
+#include <stdexcept>
+
+StridePrefetcher::StridePrefetcher(const uint16_t line_size_B,
+    const uint32_t degree, const uint32_t distance, const uint32_t n_entries) :
+    line_size_B(line_size_B), degree(degree), distance(distance) {
+  if (n_entries == 0) {
+    throw std::invalid_argument("A stride table needs an entry.");
+  }
+  Entry empty;
+  empty.pc = 0;
+  empty.last_address = 0;
+  empty.stride = 0;
+  empty.confidence = 0;
+  empty.valid = false;
+  table.resize(n_entries, empty);
+}
+
+StridePrefetcher::~StridePrefetcher() {
+}
+
+void StridePrefetcher::Train(const ADDRESS address, const ADDRESS pc,
+    const bool miss, std::vector<ADDRESS>& prefetches) {
+  if (pc == 0) {
+    return;
+  }
+  Entry& entry = table[pc % table.size()];
+  if (!entry.valid || entry.pc != pc) {
+    entry.pc = pc;
+    entry.last_address = address;
+    entry.stride = 0;
+    entry.confidence = 0;
+    entry.valid = true;
+    return;
+  }
+
+  const int64_t stride = (int64_t) address - entry.last_address;
+  entry.last_address = address;
+  if (stride == entry.stride) {
+    if (entry.confidence < STRIDE_MAX_CONFIDENCE) {
+      entry.confidence++;
+    }
+  } else if (entry.confidence > 0) {
+    entry.confidence--;
+  } else {
+    entry.stride = stride;
+  }
+  if (entry.confidence < STRIDE_CONFIDENCE || entry.stride == 0) {
+    return;
+  }
+
+  int64_t last_line = address / line_size_B;
+  for (uint32_t i = 0; i < degree; i++) {
+    const int64_t target = address + entry.stride * (int64_t) (distance + i);
+    if (target < 0 || target > (int64_t) UINT32_MAX) {
+      break;
+    }
+    // Strides shorter than a line would ask for the same line repeatedly.
+    if (target / line_size_B != last_line) {
+      last_line = target / line_size_B;
+      prefetches.push_back(last_line * line_size_B);
+    }
+  }
+}
+
+uint64_t StridePrefetcher::GetStorageBytes() const {
+  // A valid bit, the pc, the last address, the stride and the confidence.
+  const uint64_t entry_bits = 1 + 3 * sizeof(ADDRESS) * 8 + 2;
+  return (entry_bits * table.size() + 7) / 8;
+}
@@ -0,0 +1,65 @@
+/*
+ * StridePrefetcher.h
+ *
+ *  Created on: Sep 9, 2016
+ *      Author: vance
+ */
+
+#ifndef STRIDEPREFETCHER_H_
+#define STRIDEPREFETCHER_H_
+
+#include <stdint.h>
+#include <vector>
+
+#include "Address.h"
+#include "Prefetcher.h"
+
+#define DEFAULT_STRIDE_ENTRIES 256
+#define STRIDE_CONFIDENCE 2   // repeats of a stride before it is prefetched
+#define STRIDE_MAX_CONFIDENCE 3
+
+/**
+ * A reference prediction table: prefetches along the stride of each load or
+ * store instruction.
+ *
+ * The table is indexed by the pc of the access. An entry holds the last
+ * address and stride of its instruction and a saturating confidence that the
+ * stride repeats. Once it is confident, each access of the instruction
+ * prefetches the lines distance to distance + degree - 1 strides ahead.
+ * Accesses without a pc are ignored.
+ */
+class StridePrefetcher: public Prefetcher {
+private:
+  struct Entry {
+    ADDRESS pc;
+    ADDRESS last_address;
+    int64_t stride;
+    uint8_t confidence;
+    bool valid;
+  };
+
+  const uint16_t line_size_B;
+  const uint32_t degree;
+  const uint32_t distance;
+  std::vector<Entry> table;
+
+public:
+  /**
+   * Constructs a StridePrefetcher for lines of line_size_B bytes.
+   *
+   * @param degree the number of strides prefetched per access.
+   * @param distance how many strides ahead the first prefetch is.
+   * @param n_entries the number of instructions tracked.
+   */
+  StridePrefetcher(const uint16_t line_size_B, const uint32_t degree = 1,
+      const uint32_t distance = 1, const uint32_t n_entries =
+          DEFAULT_STRIDE_ENTRIES);
+  virtual ~StridePrefetcher();
+
+  void Train(const ADDRESS address, const ADDRESS pc, const bool miss,
+      std::vector<ADDRESS>& prefetches);
+
+  uint64_t GetStorageBytes() const;
+};
+
+#endif /* STRIDEPREFETCHER_H_ */
@@ -0,0 +1,622 @@
+/*
+ * Symbolizer.cpp
+ *
+ *  Created on: Sep 17, 2016
+ *      Author: vance
+ */
+
+#include "Symbolizer.h"
+
+#include <algorithm>
+#include <cxxabi.h>
+#include <elf.h>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+
+// The DWARF constants of the line tables.
+enum {
+  DW_LNS_copy = 1,
+  DW_LNS_advance_pc = 2,
+  DW_LNS_advance_line = 3,
+  DW_LNS_set_file = 4,
+  DW_LNS_const_add_pc = 8,
+  DW_LNS_fixed_advance_pc = 9,
+  DW_LNE_end_sequence = 1,
+  DW_LNE_set_address = 2,
+  DW_LNE_define_file = 3,
+  DW_LNCT_path = 1,
+  DW_LNCT_directory_index = 2,
+  DW_FORM_data2 = 0x05,
+  DW_FORM_data4 = 0x06,
+  DW_FORM_data8 = 0x07,
+  DW_FORM_string = 0x08,
+  DW_FORM_block = 0x09,
+  DW_FORM_data1 = 0x0b,
+  DW_FORM_strp = 0x0e,
+  DW_FORM_udata = 0x0f,
+  DW_FORM_data16 = 0x1e,
+  DW_FORM_line_strp = 0x1f
+};
+
+/**
+ * Reads the little-endian fields of a section, throwing std::runtime_error
+ * past its end.
+ */
+class Reader {
+private:
+  const std::string& data;
+  size_t offset;
+  const size_t end;
+
+public:
+  Reader(const std::string& data, const size_t offset, const size_t end) :
+      data(data), offset(offset), end(std::min(end, data.size())) {
+  }
+
+  size_t GetOffset() const {
+    return offset;
+  }
+
+  void Seek(const size_t offset) {
+    if (offset > end) {
+      throw std::runtime_error("Truncated DWARF line table.");
+    }
+    this->offset = offset;
+  }
+
+  /**
+   * Returns the offset n_bytes past the current one, which must not be past
+   * the end.
+   */
+  size_t GetOffsetAfter(const uint64_t n_bytes) const {
+    if (n_bytes > end - offset) {
+      throw std::runtime_error("Truncated DWARF line table.");
+    }
+    return offset + n_bytes;
+  }
+
+  void Skip(const size_t n_bytes) {
+    if (n_bytes > end - offset) {
+      throw std::runtime_error("Truncated DWARF line table.");
+    }
+    offset += n_bytes;
+  }
+
+  uint64_t Read(const size_t n_bytes) {
+    Skip(n_bytes);
+    uint64_t value = 0;
+    for (size_t i = 0; i < n_bytes; i++) {
+      value |= ((uint64_t) (uint8_t) data[offset - n_bytes + i]) << (8 * i);
+    }
+    return value;
+  }
+
+  uint64_t ReadUleb() {
+    uint64_t value = 0;
+    uint8_t byte;
+    uint8_t shift = 0;
+    do {
+      byte = Read(1);
+      if (shift < 64) {
+        value |= ((uint64_t) (byte & 0x7f)) << shift;
+      }
+      shift += 7;
+    } while (byte & 0x80);
+    return value;
+  }
+
+  int64_t ReadSleb() {
+    int64_t value = 0;
+    uint8_t byte;
+    uint8_t shift = 0;
+    do {
+      byte = Read(1);
+      if (shift < 64) {
+        value |= ((int64_t) (byte & 0x7f)) << shift;
+      }
+      shift += 7;
+    } while (byte & 0x80);
+    if (shift < 64 && (byte & 0x40)) {
+      value |= -(((int64_t) 1) << shift);
+    }
+    return value;
+  }
+
+  std::string ReadString() {
+    const size_t length = strnlen(data.data() + offset, end - offset);
+    const std::string string(data, offset, length);
+    Skip(length + 1);
+    return string;
+  }
+};
+
+/**
+ * Returns the string at offset of a string section, or "???".
+ */
+std::string GetString(const std::string& section, const uint64_t offset) {
+  if (offset >= section.size()) {
+    return "???";
+  }
+  return std::string(section.c_str() + offset);
+}
+
+/**
+ * Reads an attribute of a DWARF 5 directory or file entry of form, as a
+ * string or a number. Returns false if the form is not one the line tables
+ * use.
+ */
+bool ReadForm(Reader& reader, const uint64_t form, const size_t offset_size,
+    const std::string& debug_line_str, const std::string& debug_str,
+    std::string& string, uint64_t& number) {
+  switch (form) {
+  case DW_FORM_string:
+    string = reader.ReadString();
+    return true;
+  case DW_FORM_line_strp:
+    string = GetString(debug_line_str, reader.Read(offset_size));
+    return true;
+  case DW_FORM_strp:
+    string = GetString(debug_str, reader.Read(offset_size));
+    return true;
+  case DW_FORM_udata:
+    number = reader.ReadUleb();
+    return true;
+  case DW_FORM_data1:
+    number = reader.Read(1);
+    return true;
+  case DW_FORM_data2:
+    number = reader.Read(2);
+    return true;
+  case DW_FORM_data4:
+    number = reader.Read(4);
+    return true;
+  case DW_FORM_data8:
+    number = reader.Read(8);
+    return true;
+  case DW_FORM_data16:
+    reader.Skip(16);
+    return true;
+  case DW_FORM_block:
+    reader.Skip(reader.ReadUleb());
+    return true;
+  default:
+    return false;
+  }
+}
+
+/**
+ * Reads the DWARF 5 entries of a directory or file table: the paths, and
+ * the directory index of each, into paths and directories. Returns false
+ * if the table uses a form that is not supported.
+ */
+bool ReadEntries(Reader& reader, const size_t offset_size,
+    const std::string& debug_line_str, const std::string& debug_str,
+    std::vector<std::string>& paths, std::vector<uint64_t>& directories) {
+  const uint8_t n_formats = reader.Read(1);
+  std::vector<std::pair<uint64_t, uint64_t> > formats;
+  for (uint8_t i = 0; i < n_formats; i++) {
+    const uint64_t content_type = reader.ReadUleb();
+    formats.push_back(std::make_pair(content_type, reader.ReadUleb()));
+  }
+  const uint64_t n_entries = reader.ReadUleb();
+  for (uint64_t entry = 0; entry < n_entries; entry++) {
+    std::string path;
+    uint64_t directory = 0;
+    for (size_t i = 0; i < formats.size(); i++) {
+      std::string string;
+      uint64_t number = 0;
+      if (!ReadForm(reader, formats[i].second, offset_size, debug_line_str,
+          debug_str, string, number)) {
+        return false;
+      }
+      if (formats[i].first == DW_LNCT_path) {
+        path = string;
+      } else if (formats[i].first == DW_LNCT_directory_index) {
+        directory = number;
+      }
+    }
+    paths.push_back(path);
+    directories.push_back(directory);
+  }
+  return true;
+}
+
+/**
+ * Returns path, under directory if it is relative.
+ */
+std::string JoinPath(const std::string& directory, const std::string& path) {
+  if (path.empty() || path[0] == '/' || directory.empty()) {
+    return path;
+  }
+  return directory + "/" + path;
+}
+
+std::string Demangle(const char* const name) {
+  int status;
+  char* const demangled = abi::__cxa_demangle(name, NULL, NULL, &status);
+  if (status != 0) {
+    return name;
+  }
+  const std::string string(demangled);
+  free(demangled);
+  return string;
+}
+
+struct LineCounts {
+  uint64_t misses;
+  uint64_t evictions;
+  uint64_t wasted_bytes;
+  uint64_t resident;
+  uint64_t resident_wasted_bytes;
+
+  LineCounts() :
+      misses(0), evictions(0), wasted_bytes(0), resident(0),
+          resident_wasted_bytes(0) {
+  }
+
+  void Add(const PcCounts& counts) {
+    misses += counts.misses;
+    evictions += counts.evictions;
+    wasted_bytes += counts.wasted_bytes;
+    resident += counts.resident;
+    resident_wasted_bytes += counts.resident_wasted_bytes;
+  }
+};
+
+}
+
+Symbolizer::Symbolizer() :
+    sorted(true) {
+}
+
+Symbolizer::~Symbolizer() {
+}
+
+uint32_t Symbolizer::Intern(const std::string& string,
+    std::vector<std::string>& strings,
+    std::map<std::string, uint32_t>& indexes) {
+  std::map<std::string, uint32_t>::const_iterator index = indexes.find(
+      string);
+  if (index != indexes.end()) {
+    return index->second;
+  }
+  indexes[string] = strings.size();
+  strings.push_back(string);
+  return strings.size() - 1;
+}
+
+void Symbolizer::AddFunction(const ADDRESS start, const ADDRESS end,
+    const std::string& name) {
+  Interval interval = { start, end, Intern(name, names, name_indexes), 0 };
+  functions.push_back(interval);
+  sorted = false;
+}
+
+void Symbolizer::AddLine(const ADDRESS start, const ADDRESS end,
+    const std::string& file, const uint32_t line) {
+  Interval interval = { start, end, Intern(file, files, file_indexes), line };
+  lines.push_back(interval);
+  sorted = false;
+}
+
+void Symbolizer::LoadLines(const std::string& debug_line,
+    const std::string& debug_line_str, const std::string& debug_str,
+    const uint64_t bias) {
+  size_t unit = 0;
+  while (unit + 4 <= debug_line.size()) {
+    Reader length_reader(debug_line, unit, debug_line.size());
+    uint64_t unit_length = length_reader.Read(4);
+    size_t offset_size = 4;
+    if (unit_length == 0xffffffff) {
+      unit_length = length_reader.Read(8);
+      offset_size = 8;
+    }
+    // A unit may not claim to run past the section.
+    const size_t end = length_reader.GetOffset()
+        + std::min<uint64_t>(unit_length,
+            debug_line.size() - length_reader.GetOffset());
+    unit = end;
+    Reader reader(debug_line, length_reader.GetOffset(), end);
+
+    const uint16_t version = reader.Read(2);
+    if (version < 2 || version > 5) {
+      continue;
+    }
+    uint8_t address_size = 8;
+    if (version >= 5) {
+      address_size = reader.Read(1);
+      reader.Skip(1);
+    }
+    const uint64_t header_length = reader.Read(offset_size);
+    const size_t program = reader.GetOffsetAfter(header_length);
+    const uint8_t min_instruction_length = reader.Read(1);
+    // The maximum operations per instruction, for VLIW, and default_is_stmt.
+    reader.Skip(version >= 4 ? 2 : 1);
+    const int8_t line_base = reader.Read(1);
+    const uint8_t line_range = reader.Read(1);
+    const uint8_t opcode_base = reader.Read(1);
+    if (line_range == 0 || opcode_base == 0) {
+      continue;
+    }
+    std::vector<uint8_t> opcode_lengths;
+    for (uint8_t i = 1; i < opcode_base; i++) {
+      opcode_lengths.push_back(reader.Read(1));
+    }
+
+    // The file names, with their directory if relative. Before DWARF 5,
+    // file and directory 0 are those of the compilation unit and are not
+    // in the tables.
+    std::vector<std::string> directories;
+    std::vector<std::string> file_names;
+    if (version >= 5) {
+      std::vector<std::string> paths;
+      std::vector<uint64_t> indexes;
+      if (!ReadEntries(reader, offset_size, debug_line_str, debug_str,
+          directories, indexes)) {
+        continue;
+      }
+      indexes.clear();
+      if (!ReadEntries(reader, offset_size, debug_line_str, debug_str, paths,
+          indexes)) {
+        continue;
+      }
+      for (size_t i = 0; i < paths.size(); i++) {
+        file_names.push_back(JoinPath(
+            indexes[i] < directories.size() ? directories[indexes[i]] : "",
+            paths[i]));
+      }
+    } else {
+      directories.push_back("");
+      for (std::string directory = reader.ReadString(); !directory.empty();
+          directory = reader.ReadString()) {
+        directories.push_back(directory);
+      }
+      file_names.push_back("???");
+      for (std::string path = reader.ReadString(); !path.empty(); path =
+          reader.ReadString()) {
+        const uint64_t directory = reader.ReadUleb();
+        reader.ReadUleb();
+        reader.ReadUleb();
+        file_names.push_back(JoinPath(
+            directory < directories.size() ? directories[directory] : "",
+            path));
+      }
+    }
+
+    // Run the line number program. Each row ends the interval of the row
+    // before it in its sequence.
+    reader.Seek(program);
+    uint64_t address = 0;
+    uint64_t file = 1;
+    int64_t line = 1;
+    bool has_row = false;
+    uint64_t row_address = 0;
+    uint64_t row_file = 0;
+    int64_t row_line = 0;
+    while (reader.GetOffset() < end) {
+      const uint8_t opcode = reader.Read(1);
+      bool emit = false;
+      bool end_sequence = false;
+      if (opcode >= opcode_base) {
+        const uint8_t adjusted = opcode - opcode_base;
+        address += (adjusted / line_range) * min_instruction_length;
+        line += line_base + adjusted % line_range;
+        emit = true;
+      } else if (opcode == 0) {
+        const uint64_t length = reader.ReadUleb();
+        const size_t next = reader.GetOffsetAfter(length);
+        const uint8_t extended = length ? reader.Read(1) : 0;
+        if (extended == DW_LNE_end_sequence) {
+          emit = true;
+          end_sequence = true;
+        } else if (extended == DW_LNE_set_address) {
+          address = reader.Read(std::min<uint64_t>(length - 1, address_size));
+        } else if (extended == DW_LNE_define_file) {
+          const std::string path = reader.ReadString();
+          const uint64_t directory = reader.ReadUleb();
+          file_names.push_back(JoinPath(
+              directory < directories.size() ? directories[directory] : "",
+              path));
+        }
+        reader.Seek(next);
+      } else if (opcode == DW_LNS_copy) {
+        emit = true;
+      } else if (opcode == DW_LNS_advance_pc) {
+        address += reader.ReadUleb() * min_instruction_length;
+      } else if (opcode == DW_LNS_advance_line) {
+        line += reader.ReadSleb();
+      } else if (opcode == DW_LNS_set_file) {
+        file = reader.ReadUleb();
+      } else if (opcode == DW_LNS_const_add_pc) {
+        address += ((255 - opcode_base) / line_range)
+            * min_instruction_length;
+      } else if (opcode == DW_LNS_fixed_advance_pc) {
+        address += reader.Read(2);
+      } else {
+        // Operands that do not concern the addresses or the lines.
+        for (uint8_t i = 0; i < opcode_lengths[opcode - 1]; i++) {
+          reader.ReadUleb();
+        }
+      }
+
+      if (emit) {
+        if (has_row && address > row_address) {
+          AddLine(bias + row_address, bias + address,
+              row_file < file_names.size() ? file_names[row_file] : "???",
+              row_line);
+        }
+        has_row = !end_sequence;
+        row_address = address;
+        row_file = file;
+        row_line = line;
+      }
+      if (end_sequence) {
+        address = 0;
+        file = 1;
+        line = 1;
+      }
+    }
+  }
+}
+
+bool Symbolizer::LoadElf(const std::string& path, const uint64_t bias) {
+  std::ifstream in(path.c_str(), std::ios::binary);
+  if (!in) {
+    throw std::runtime_error("Cannot read " + path + ".");
+  }
+  const std::string image((std::istreambuf_iterator<char>(in)),
+      std::istreambuf_iterator<char>());
+  Elf64_Ehdr header;
+  if (image.size() < sizeof(header)
+      || memcmp(image.data(), ELFMAG, SELFMAG) != 0
+      || image[EI_CLASS] != ELFCLASS64 || image[EI_DATA] != ELFDATA2LSB) {
+    throw std::runtime_error(
+        path + " is not a 64-bit little-endian ELF binary.");
+  }
+  memcpy(&header, image.data(), sizeof(header));
+  if (header.e_shentsize != sizeof(Elf64_Shdr)
+      || header.e_shoff + header.e_shnum * sizeof(Elf64_Shdr) > image.size()
+      || header.e_shstrndx >= header.e_shnum) {
+    throw std::runtime_error(path + " has no valid section headers.");
+  }
+  std::vector<Elf64_Shdr> sections(header.e_shnum);
+  memcpy(&sections[0], image.data() + header.e_shoff,
+      header.e_shnum * sizeof(Elf64_Shdr));
+  for (size_t i = 0; i < sections.size(); i++) {
+    if (sections[i].sh_type != SHT_NOBITS
+        && sections[i].sh_offset + sections[i].sh_size > image.size()) {
+      throw std::runtime_error(path + " is truncated.");
+    }
+  }
+  const Elf64_Shdr& names = sections[header.e_shstrndx];
+  const std::string section_names(image, names.sh_offset, names.sh_size);
+
+  // Prefer the full symbol table to the dynamic one.
+  const Elf64_Shdr* symbols = NULL;
+  std::string debug_line, debug_line_str, debug_str;
+  for (size_t i = 0; i < sections.size(); i++) {
+    const Elf64_Shdr& section = sections[i];
+    if (section.sh_type == SHT_SYMTAB
+        || (section.sh_type == SHT_DYNSYM && symbols == NULL)) {
+      symbols = &section;
+    }
+    if (section.sh_type == SHT_NOBITS || (section.sh_flags & SHF_COMPRESSED)) {
+      continue;
+    }
+    const std::string name = GetString(section_names, section.sh_name);
+    const std::string contents(image, section.sh_offset, section.sh_size);
+    if (name == ".debug_line") {
+      debug_line = contents;
+    } else if (name == ".debug_line_str") {
+      debug_line_str = contents;
+    } else if (name == ".debug_str") {
+      debug_str = contents;
+    }
+  }
+
+  if (symbols != NULL && symbols->sh_link < sections.size()) {
+    const Elf64_Shdr& strings = sections[symbols->sh_link];
+    const std::string symbol_names(image, strings.sh_offset, strings.sh_size);
+    for (size_t offset = symbols->sh_offset;
+        offset + sizeof(Elf64_Sym) <= symbols->sh_offset + symbols->sh_size;
+        offset += sizeof(Elf64_Sym)) {
+      Elf64_Sym symbol;
+      memcpy(&symbol, image.data() + offset, sizeof(symbol));
+      if (symbol.st_shndx == SHN_UNDEF || symbol.st_value == 0) {
+        continue;
+      }
+      const uint64_t start = bias + symbol.st_value;
+      if (ELF64_ST_TYPE(symbol.st_info) == STT_FUNC) {
+        AddFunction(start, start + std::max<uint64_t>(symbol.st_size, 1),
+            Demangle(GetString(symbol_names, symbol.st_name).c_str()));
+      } else if (ELF64_ST_TYPE(symbol.st_info) == STT_OBJECT
+          && symbol.st_size != 0) {
+        const DataSymbol data = { (ADDRESS) start, symbol.st_size, Demangle(
+            GetString(symbol_names, symbol.st_name).c_str()) };
+        data_symbols.push_back(data);
+      }
+    }
+  }
+  if (debug_line.empty()) {
+    return false;
+  }
+  LoadLines(debug_line, debug_line_str, debug_str, bias);
+  return true;
+}
+
+const Symbolizer::Interval* Symbolizer::Find(
+    const std::vector<Interval>& intervals, const ADDRESS pc) {
+  Interval key = { pc, pc, 0, 0 };
+  std::vector<Interval>::const_iterator it = std::upper_bound(
+      intervals.begin(), intervals.end(), key);
+  if (it == intervals.begin()) {
+    return NULL;
+  }
+  --it;
+  return pc < it->end ? &*it : NULL;
+}
+
+SourceLocation Symbolizer::Symbolize(const ADDRESS pc) {
+  if (!sorted) {
+    std::sort(functions.begin(), functions.end());
+    std::sort(lines.begin(), lines.end());
+    sorted = true;
+  }
+  SourceLocation location;
+  const Interval* const function = Find(functions, pc);
+  location.function = function ? names[function->name] : "???";
+  const Interval* const line = Find(lines, pc);
+  location.file = line ? files[line->name] : "???";
+  location.line = line ? line->line : 0;
+  return location;
+}
+
+void Symbolizer::WriteCachegrind(std::ostream& stream,
+    const PcAttribution& attribution, const std::string& command) {
+  // Entry file, function, line sums the charges of the line's instructions.
+  std::map<std::string,
+      std::map<std::string, std::map<uint32_t, LineCounts> > > counts;
+  LineCounts total;
+  const std::vector<PcCounts> entries = attribution.GetEntries();
+  for (size_t i = 0; i < entries.size(); i++) {
+    const SourceLocation location = Symbolize(entries[i].pc);
+    counts[location.file][location.function][location.line].Add(entries[i]);
+    total.Add(entries[i]);
+  }
+  if (attribution.untracked.misses || attribution.untracked.evictions
+      || attribution.untracked.resident) {
+    counts["???"]["???"][0].Add(attribution.untracked);
+    total.Add(attribution.untracked);
+  }
+
+  stream << "desc: Misses and unused bytes of the lines they filled, "
+      "simulated by VCache" << std::endl;
+  stream << "cmd: " << command << std::endl;
+  stream << "events: Misses Evictions WastedBytes Resident ResWastedBytes"
+      << std::endl;
+  for (std::map<std::string,
+      std::map<std::string, std::map<uint32_t, LineCounts> > >::const_iterator
+      file = counts.begin(); file != counts.end(); file++) {
+    stream << "fl=" << file->first << std::endl;
+    for (std::map<std::string, std::map<uint32_t, LineCounts> >::const_iterator
+        function = file->second.begin(); function != file->second.end();
+        function++) {
+      stream << "fn=" << function->first << std::endl;
+      for (std::map<uint32_t, LineCounts>::const_iterator line =
+          function->second.begin(); line != function->second.end(); line++) {
+        stream << line->first << " " << line->second.misses << " "
+            << line->second.evictions << " " << line->second.wasted_bytes
+            << " " << line->second.resident << " "
+            << line->second.resident_wasted_bytes << std::endl;
+      }
+    }
+  }
+  stream << "summary: " << total.misses << " " << total.evictions << " "
+      << total.wasted_bytes << " " << total.resident << " "
+      << total.resident_wasted_bytes << std::endl;
+}
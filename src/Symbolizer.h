@@ -0,0 +1,135 @@
+/*
+ * Symbolizer.h
+ *
+ *  Created on: Sep 17, 2016
+ *      Author: vance
+ */
+
+#ifndef SYMBOLIZER_H_
+#define SYMBOLIZER_H_
+
+#include <iostream>
+#include <map>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "Address.h"
+#include "PcAttribution.h"
+
+/**
+ * Where an instruction is in the source. Unknown parts are "???" and line 0.
+ */
+struct SourceLocation {
+  std::string function;
+  std::string file;
+  uint32_t line;
+};
+
+/**
+ * A variable of static storage of a binary, eg. a global.
+ */
+struct DataSymbol {
+  ADDRESS address;
+  uint64_t size_B;
+  std::string name;
+};
+
+/**
+ * Maps instruction addresses to functions and source lines, after the run,
+ * from the binaries on disk: the function symbols of the ELF symbol table
+ * and the DWARF line tables of .debug_line, versions 2 to 5.
+ *
+ * The functions and the line table rows are kept as address intervals,
+ * sorted on the first lookup after they change, so that each lookup is a
+ * binary search. Images are added at their load bias; addresses wrap like
+ * ADDRESS, the type of the simulated pcs.
+ */
+class Symbolizer {
+private:
+  struct Interval {
+    ADDRESS start;
+    ADDRESS end;
+    // An index in names for a function, in files for a line.
+    uint32_t name;
+    uint32_t line;
+
+    bool operator<(const Interval& other) const {
+      return start < other.start;
+    }
+  };
+
+  std::vector<Interval> functions;
+  std::vector<Interval> lines;
+  bool sorted;
+  std::vector<std::string> names;
+  std::vector<std::string> files;
+  // Map a name or a file to its index.
+  std::map<std::string, uint32_t> name_indexes;
+  std::map<std::string, uint32_t> file_indexes;
+
+private:
+  static uint32_t Intern(const std::string& string,
+      std::vector<std::string>& strings,
+      std::map<std::string, uint32_t>& indexes);
+
+  /**
+   * Returns the interval of intervals that holds pc, or NULL.
+   */
+  static const Interval* Find(const std::vector<Interval>& intervals,
+      const ADDRESS pc);
+
+  /**
+   * Adds the rows of a .debug_line section, at bias. The string sections
+   * hold the DWARF 5 file names; either may be empty.
+   */
+  void LoadLines(const std::string& debug_line,
+      const std::string& debug_line_str, const std::string& debug_str,
+      const uint64_t bias);
+
+public:
+  // The variables of the ELF binaries loaded, at their bias, for
+  // DataObjectMap::AddGlobal.
+  std::vector<DataSymbol> data_symbols;
+
+  Symbolizer();
+  virtual ~Symbolizer();
+
+  /**
+   * Adds a function at [start, end).
+   */
+  void AddFunction(const ADDRESS start, const ADDRESS end,
+      const std::string& name);
+
+  /**
+   * Adds the instructions at [start, end) of line of file.
+   */
+  void AddLine(const ADDRESS start, const ADDRESS end,
+      const std::string& file, const uint32_t line);
+
+  /**
+   * Adds the functions, variables and line tables of the 64-bit ELF binary
+   * at path, loaded at bias, eg. 0 for an executable that is not position
+   * independent. Throws std::runtime_error if the file cannot be read.
+   * Returns false if the binary has no line tables, eg. was built without
+   * -g, in which case only its functions and variables are added.
+   */
+  bool LoadElf(const std::string& path, const uint64_t bias = 0);
+
+  /**
+   * Returns the location of the instruction at pc.
+   */
+  SourceLocation Symbolize(const ADDRESS pc);
+
+  /**
+   * Writes the charges of attribution summed per source line, in the format
+   * of Cachegrind's output files, so cg_annotate and the viewers of
+   * Cachegrind annotate the sources with them. The lines are grouped by
+   * file, then function, whose totals the viewers sum. command is the
+   * command that was simulated.
+   */
+  void WriteCachegrind(std::ostream& stream, const PcAttribution& attribution,
+      const std::string& command);
+};
+
+#endif /* SYMBOLIZER_H_ */
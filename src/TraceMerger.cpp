@@ -0,0 +1,121 @@
+/*
+ * TraceMerger.cpp
+ *
+ *  Created on: Aug 9, 2016
+ *      Author: vance
+ */
+
+#include "TraceMerger.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+TraceMerger::TraceMerger(const std::vector<AccessStream*>& streams,
+    const MergePolicy policy, const uint32_t quantum) :
+    streams(streams), policy(policy), quantum(quantum), current(0), remaining(
+        quantum), exhausted(streams.size(), false), n_exhausted(0), started(
+        false) {
+  if (quantum == 0) {
+    throw std::invalid_argument("The quantum must be at least one record.");
+  }
+}
+
+TraceMerger::~TraceMerger() {
+}
+
+bool TraceMerger::Next(AccessRecord& record) {
+  if (policy == MERGE_BY_TIMESTAMP) {
+    return NextByTimestamp(record);
+  } else {
+    return NextRoundRobin(record);
+  }
+}
+
+bool TraceMerger::After(const Head& a, const Head& b) {
+  if (a.record.timestamp != b.record.timestamp) {
+    return a.record.timestamp > b.record.timestamp;
+  }
+  return a.stream > b.stream;
+}
+
+void TraceMerger::SiftDown(size_t position) {
+  const size_t size = heap.size();
+  while (true) {
+    size_t smallest = position;
+    const size_t left = 2 * position + 1;
+    const size_t right = left + 1;
+    if (left < size && After(heap[smallest], heap[left])) {
+      smallest = left;
+    }
+    if (right < size && After(heap[smallest], heap[right])) {
+      smallest = right;
+    }
+    if (smallest == position) {
+      return;
+    }
+    std::swap(heap[position], heap[smallest]);
+    position = smallest;
+  }
+}
+
+void TraceMerger::SiftUp(size_t position) {
+  while (position > 0) {
+    const size_t parent = (position - 1) / 2;
+    if (!After(heap[parent], heap[position])) {
+      return;
+    }
+    std::swap(heap[parent], heap[position]);
+    position = parent;
+  }
+}
+
+void TraceMerger::Start() {
+  started = true;
+  heap.reserve(streams.size());
+  for (uint32_t stream = 0; stream < streams.size(); stream++) {
+    Head head;
+    head.stream = stream;
+    if (streams[stream]->Next(head.record)) {
+      heap.push_back(head);
+      SiftUp(heap.size() - 1);
+    }
+  }
+}
+
+bool TraceMerger::NextByTimestamp(AccessRecord& record) {
+  if (!started) {
+    Start();
+  }
+  if (heap.empty()) {
+    return false;
+  }
+  record = heap.front().record;
+  // Replace the head with the next record of the same stream, which keeps
+  // the merge to a single sift per record.
+  if (streams[heap.front().stream]->Next(heap.front().record)) {
+    SiftDown(0);
+  } else {
+    heap.front() = heap.back();
+    heap.pop_back();
+    if (!heap.empty()) {
+      SiftDown(0);
+    }
+  }
+  return true;
+}
+
+bool TraceMerger::NextRoundRobin(AccessRecord& record) {
+  while (n_exhausted < streams.size()) {
+    if (remaining > 0 && !exhausted[current]) {
+      if (streams[current]->Next(record)) {
+        remaining--;
+        return true;
+      }
+      exhausted[current] = true;
+      n_exhausted++;
+    }
+    current = (current + 1) % streams.size();
+    remaining = quantum;
+  }
+  return false;
+}
@@ -0,0 +1,87 @@
+/*
+ * TraceMerger.h
+ *
+ *  Created on: Aug 9, 2016
+ *      Author: vance
+ */
+
+#ifndef TRACEMERGER_H_
+#define TRACEMERGER_H_
+
+#include <stdint.h>
+#include <vector>
+
+#include "AccessRecord.h"
+#include "AccessStream.h"
+
+#define DEFAULT_QUANTUM 1000   // records per thread per round
+
+/**
+ * How a TraceMerger interleaves its input streams.
+ */
+enum MergePolicy {
+  // Always take the record with the smallest timestamp. Ties go to the
+  // stream that was added first.
+  MERGE_BY_TIMESTAMP,
+  // Take up to a quantum of records from each stream in turn.
+  MERGE_ROUND_ROBIN
+};
+
+/**
+ * Merges the per-thread streams of a multi-threaded trace into a single
+ * deterministic stream.
+ */
+class TraceMerger: public AccessStream {
+private:
+  struct Head {
+    AccessRecord record;
+    uint32_t stream;
+  };
+
+  std::vector<AccessStream*> streams;
+  const MergePolicy policy;
+  const uint32_t quantum;
+  // MERGE_BY_TIMESTAMP: a binary min-heap of the next record of each stream
+  // that is not exhausted.
+  std::vector<Head> heap;
+  // MERGE_ROUND_ROBIN: the current stream and the records left in its quantum.
+  uint32_t current;
+  uint32_t remaining;
+  std::vector<bool> exhausted;
+  uint32_t n_exhausted;
+  bool started;
+
+private:
+  /**
+   * Returns true iff a should be merged after b.
+   */
+  static bool After(const Head& a, const Head& b);
+
+  void SiftDown(size_t position);
+  void SiftUp(size_t position);
+
+  /**
+   * Reads the first record of every stream into the heap.
+   */
+  void Start();
+
+  bool NextByTimestamp(AccessRecord& record);
+  bool NextRoundRobin(AccessRecord& record);
+
+public:
+  /**
+   * Constructs a TraceMerger. The merger does not own the streams.
+   *
+   * @param streams the streams to merge, eg. one per thread.
+   * @param policy how to interleave the streams.
+   * @param quantum the number of consecutive records taken from a stream
+   *        under MERGE_ROUND_ROBIN.
+   */
+  TraceMerger(const std::vector<AccessStream*>& streams,
+      const MergePolicy policy, const uint32_t quantum = DEFAULT_QUANTUM);
+  virtual ~TraceMerger();
+
+  bool Next(AccessRecord& record);
+};
+
+#endif /* TRACEMERGER_H_ */
@@ -38,4 +38,14 @@ TEST(AddressTest, AddressTagBits) {
   }
 }
 
+TEST(AddressTest, HighBits) {
+  volatile uint64_t high_bits = NO_HIGH_BITS;
+  ASSERT_TRUE(Address::HasHighBits(0x7f0012345678ull, high_bits));
+  ASSERT_EQ(0x7f00u, high_bits);
+  ASSERT_TRUE(Address::HasHighBits(0x7f00ffffffffull, high_bits));
+  // Would alias with 0x7f0012345678.
+  ASSERT_FALSE(Address::HasHighBits(0x12345678ull, high_bits));
+  ASSERT_EQ(0x7f00u, high_bits);
+}
+
 }
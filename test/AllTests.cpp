@@ -10,11 +10,23 @@
 #include "AddressTest.cpp"
 #include "AssociativeCacheSetTest.cpp"
 #include "AssociativeCacheTest.cpp"
+#include "BackpressureSamplerTest.cpp"
 #include "CacheLineTest.cpp"
+#include "CaptureRingTest.cpp"
+#include "CommunicationMatrixTest.cpp"
+#include "ConcurrentMultilevelCacheTest.cpp"
+#include "DataObjectMapTest.cpp"
 #include "DirectMappedCacheSetTest.cpp"
 #include "DirectMappedCacheTest.cpp"
+#include "FalseSharingDetectorTest.cpp"
+#include "FootprintHistogramTest.cpp"
 #include "LargeMultilevelCacheTest.cpp"
 #include "MultilevelCacheTest.cpp"
+#include "PcAttributionTest.cpp"
+#include "PrefetcherTest.cpp"
+#include "SimulatorDaemonTest.cpp"
+#include "SymbolizerTest.cpp"
+#include "TraceMergerTest.cpp"
 
 int main(int argc, char **argv) {
   ::testing::InitGoogleTest(&argc, argv);
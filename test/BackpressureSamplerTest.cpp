@@ -0,0 +1,90 @@
+/*
+ * BackpressureSamplerTest.cpp
+ *
+ *  Created on: Sep 6, 2016
+ *      Author: vance
+ */
+
+#include "../src/BackpressureSampler.h"
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+TEST(BackpressureSamplerTest, PeriodFollowsBacklog) {
+  BackpressureSampler sampler(64, 64, SAMPLING_SETS, 8);
+  ASSERT_EQ(1u, sampler.GetPeriod());
+  sampler.Update(40);
+  ASSERT_EQ(2u, sampler.GetPeriod());
+  sampler.Update(40);
+  sampler.Update(40);
+  sampler.Update(64);
+  ASSERT_EQ(8u, sampler.GetPeriod());
+  // Between the water marks the period holds.
+  sampler.Update(20);
+  ASSERT_EQ(8u, sampler.GetPeriod());
+  sampler.Update(4);
+  ASSERT_EQ(4u, sampler.GetPeriod());
+  sampler.Update(0);
+  sampler.Update(0);
+  sampler.Update(0);
+  ASSERT_EQ(1u, sampler.GetPeriod());
+  ASSERT_EQ(8u, sampler.peak_period);
+}
+
+TEST(BackpressureSamplerTest, SetSampling) {
+  BackpressureSampler sampler(64, 64, SAMPLING_SETS, 8);
+  sampler.Update(64);
+  sampler.Update(64);
+  for (ADDRESS line = 0; line < 16; line++) {
+    // Every access to a sampled line is simulated.
+    ASSERT_EQ(line % 4 == 0, sampler.Sample(line * 64));
+    ASSERT_EQ(line % 4 == 0, sampler.Sample(line * 64 + 32));
+  }
+  ASSERT_EQ(32u, sampler.n_records);
+  ASSERT_EQ(8u, sampler.n_simulated);
+  ASSERT_DOUBLE_EQ(0.25, sampler.GetRatio());
+}
+
+TEST(BackpressureSamplerTest, SetSamplingSpreadsShards) {
+  // The shards of a ConcurrentMultilevelCache are selected by the lowest
+  // line index bits.
+  const uint32_t n_shards = 4;
+  BackpressureSampler sampler(64, 64, SAMPLING_SETS, 8, n_shards);
+  sampler.Update(64);
+  sampler.Update(64);
+  sampler.Update(64);
+  std::vector<uint32_t> shard_records(n_shards, 0);
+  for (ADDRESS line = 0; line < 64; line++) {
+    if (sampler.Sample(line * 64)) {
+      shard_records[line % n_shards]++;
+    }
+  }
+  // One line in 8, spread evenly over the shards.
+  for (uint32_t shard = 0; shard < n_shards; shard++) {
+    ASSERT_EQ(2u, shard_records[shard]);
+  }
+  ASSERT_THROW(BackpressureSampler(64, 64, SAMPLING_SETS, 8, 3),
+      std::invalid_argument);
+}
+
+TEST(BackpressureSamplerTest, TimeSampling) {
+  BackpressureSampler sampler(64, 64, SAMPLING_TIME, 8);
+  sampler.Update(64);
+  for (uint32_t i = 0; i < 4 * SAMPLE_WINDOW; i++) {
+    ASSERT_EQ((i / SAMPLE_WINDOW) % 2 == 0, sampler.Sample(0));
+  }
+  ASSERT_DOUBLE_EQ(0.5, sampler.GetRatio());
+}
+
+TEST(BackpressureSamplerTest, InvalidArguments) {
+  ASSERT_THROW(BackpressureSampler(64, 64, SAMPLING_SETS, 0),
+      std::invalid_argument);
+  ASSERT_THROW(BackpressureSampler(64, 64, SAMPLING_SETS, 12),
+      std::invalid_argument);
+  ASSERT_THROW(BackpressureSampler(64, 48), std::invalid_argument);
+}
+
+}
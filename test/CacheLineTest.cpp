@@ -71,6 +71,17 @@ TEST_F(CacheLineTest, LargeAccessTest) {
   }
 }
 
+TEST_F(CacheLineTest, LevelAccesses) {
+  ASSERT_EQ(0u, line->ClearLevelAccesses(0));
+  line->AccessLevels(0x5, LINE_ADDRESS, n_bytes_rw);
+  line->AccessLevels(0x4, LINE_ADDRESS + 8, n_bytes_rw);
+  ASSERT_EQ(4u, line->ClearLevelAccesses(0));
+  ASSERT_EQ(0u, line->ClearLevelAccesses(1));
+  ASSERT_EQ(8u, line->ClearLevelAccesses(2));
+  // Each residency starts over.
+  ASSERT_EQ(0u, line->ClearLevelAccesses(2));
+}
+
 TEST_F(CacheLineTest, CreateLines) {
   const int create_max = 1024 * 1024;
   for (int i = 0; i < create_max; i++) {
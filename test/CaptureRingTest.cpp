@@ -0,0 +1,183 @@
+/*
+ * CaptureRingTest.cpp
+ *
+ *  Created on: Aug 23, 2016
+ *      Author: vance
+ */
+
+#include "../src/CapturePipeline.h"
+#include "../src/CaptureRing.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+TEST(CaptureRingTest, BatchedPublication) {
+  CaptureRing ring(8, 4);
+  AccessRecord out[8];
+  for (ADDRESS address = 0; address < 3; address++) {
+    ASSERT_TRUE(ring.TryPush(AccessRecord(address, 1)));
+  }
+  // The batch is not complete: nothing is visible yet.
+  ASSERT_EQ(0u, ring.Pop(out, 8));
+  ASSERT_TRUE(ring.TryPush(AccessRecord(3, 1)));
+  ASSERT_EQ(4u, ring.GetSize());
+  ASSERT_TRUE(ring.TryPush(AccessRecord(4, 1)));
+  ring.Flush();
+  ASSERT_EQ(5u, ring.Pop(out, 8));
+  for (ADDRESS address = 0; address < 5; address++) {
+    ASSERT_EQ(address, out[address].address);
+  }
+}
+
+TEST(CaptureRingTest, FullAndWrapAround) {
+  CaptureRing ring(4, 2);
+  AccessRecord out[4];
+  for (ADDRESS address = 0; address < 4; address++) {
+    ASSERT_TRUE(ring.TryPush(AccessRecord(address, 1)));
+  }
+  ASSERT_FALSE(ring.TryPush(AccessRecord(4, 1)));
+  ASSERT_EQ(3u, ring.Pop(out, 3));
+  for (ADDRESS address = 4; address < 7; address++) {
+    ASSERT_TRUE(ring.TryPush(AccessRecord(address, 1)));
+  }
+  ASSERT_FALSE(ring.TryPush(AccessRecord(7, 1)));
+  ASSERT_EQ(4u, ring.Pop(out, 4));
+  for (ADDRESS i = 0; i < 4; i++) {
+    ASSERT_EQ(i + 3, out[i].address);
+  }
+}
+
+TEST(CaptureRingTest, InvalidArguments) {
+  ASSERT_THROW(CaptureRing(6, 2), std::invalid_argument);
+  ASSERT_THROW(CaptureRing(8, 0), std::invalid_argument);
+  ASSERT_THROW(CaptureRing(8, 16), std::invalid_argument);
+}
+
+void* Produce(void* argument) {
+  CaptureRing* const ring = (CaptureRing*) argument;
+  for (ADDRESS address = 0; address < 100000; address++) {
+    ring->Push(AccessRecord(address, 1));
+  }
+  ring->Flush();
+  return NULL;
+}
+
+TEST(CaptureRingTest, ProducerConsumerOrder) {
+  CaptureRing ring(64, 16);
+  pthread_t producer;
+  ASSERT_EQ(0, pthread_create(&producer, NULL, Produce, &ring));
+  AccessRecord out[32];
+  ADDRESS expected = 0;
+  while (expected < 100000) {
+    const size_t n = ring.Pop(out, 32);
+    if (n == 0) {
+      sched_yield();
+    }
+    for (size_t i = 0; i < n; i++) {
+      ASSERT_EQ(expected++, out[i].address);
+    }
+  }
+  pthread_join(producer, NULL);
+  ASSERT_EQ(0u, ring.GetSize());
+}
+
+struct Application {
+  CapturePipeline* pipeline;
+  uint16_t thread_id;
+};
+
+void* Instrumented(void* argument) {
+  Application* const application = (Application*) argument;
+  CaptureRing& ring = application->pipeline->GetRing(application->thread_id);
+  for (int pass = 0; pass < 4; pass++) {
+    for (ADDRESS address = 0; address < 64 * 1024; address += 64) {
+      ring.Push(AccessRecord(address + application->thread_id, 8,
+          ACCESS_LOAD, HINT_NONE, application->thread_id));
+    }
+  }
+  ring.Flush();
+  return NULL;
+}
+
+TEST(CapturePipelineTest, DrainsEveryRing) {
+  std::vector<uint64_t> capacities_B;
+  std::vector<uint16_t> associativities;
+  capacities_B.push_back(4096);
+  capacities_B.push_back(65536);
+  associativities.push_back(4);
+  associativities.push_back(8);
+  ConcurrentMultilevelCache cache(2, capacities_B, associativities);
+  CapturePipeline pipeline(cache, 4, 2, 256, 32);
+  pipeline.Start();
+
+  pthread_t threads[4];
+  Application applications[4];
+  for (uint16_t i = 0; i < 4; i++) {
+    applications[i].pipeline = &pipeline;
+    applications[i].thread_id = i;
+    ASSERT_EQ(0, pthread_create(&threads[i], NULL, Instrumented,
+        &applications[i]));
+  }
+  for (int i = 0; i < 4; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  pipeline.Stop();
+
+  ASSERT_EQ(4u * 4 * 1024, pipeline.GetRecordCount());
+  ASSERT_EQ(4u * 4 * 1024,
+      cache.Sum(&MultilevelCache::hits) + cache.Sum(&MultilevelCache::misses));
+  // The 64KB the threads share fits the LLC: only the first pass misses.
+  ASSERT_EQ(1024u, cache.Sum(&MultilevelCache::misses));
+}
+
+TEST(CapturePipelineTest, SamplesWhenBehind) {
+  std::vector<uint64_t> capacities_B;
+  std::vector<uint16_t> associativities;
+  capacities_B.push_back(4096);
+  capacities_B.push_back(65536);
+  associativities.push_back(4);
+  associativities.push_back(8);
+  ConcurrentMultilevelCache cache(1, capacities_B, associativities);
+  CapturePipeline pipeline(cache, 1, 1, 256, 32, SAMPLING_SETS, 8);
+  for (ADDRESS line = 0; line < 256; line++) {
+    pipeline.GetRing(0).Push(AccessRecord(line * 64, 8));
+  }
+  // The simulator starts behind a full ring: it simulates every other set.
+  pipeline.Start();
+  pipeline.Stop();
+
+  ASSERT_EQ(256u, pipeline.GetRecordCount());
+  ASSERT_EQ(128u, pipeline.GetSimulatedCount());
+  ASSERT_DOUBLE_EQ(0.5, pipeline.GetSamplingRatio());
+  ASSERT_EQ(2u, pipeline.GetPeakPeriod());
+  ASSERT_EQ(128u, cache.Sum(&MultilevelCache::misses));
+}
+
+TEST(CapturePipelineTest, EventsAreNotRecords) {
+  std::vector<uint64_t> capacities_B;
+  std::vector<uint16_t> associativities;
+  capacities_B.push_back(4096);
+  associativities.push_back(4);
+  ConcurrentMultilevelCache cache(1, capacities_B, associativities);
+  cache.EnableDataObjects();
+  CapturePipeline pipeline(cache, 1, 1, 256, 32);
+  for (ADDRESS i = 0; i < 16; i++) {
+    pipeline.GetRing(0).Push(AccessRecord(i * 64, 64, ACCESS_ALLOC,
+        HINT_NONE, 0, 0, 0x400));
+    pipeline.GetRing(0).Push(AccessRecord(i * 64, 8));
+    pipeline.GetRing(0).Push(AccessRecord(i * 64, 0, ACCESS_FREE));
+  }
+  pipeline.GetRing(0).Flush();
+  pipeline.Start();
+  pipeline.Stop();
+
+  ASSERT_EQ(16u, pipeline.GetRecordCount());
+  ASSERT_DOUBLE_EQ(1.0, pipeline.GetSamplingRatio());
+  ASSERT_EQ(16u, cache.MergeDataObjects().GetTopMisses(1).at(0).misses);
+}
+
+}
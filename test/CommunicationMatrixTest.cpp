@@ -0,0 +1,123 @@
+/*
+ * CommunicationMatrixTest.cpp
+ *
+ *  Created on: Aug 17, 2016
+ *      Author: vance
+ */
+
+#include "../src/CommunicationMatrix.h"
+#include "../src/MultilevelCache.h"
+
+#include <sstream>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+class CommunicationMatrixTest: public ::testing::Test {
+protected:
+  static const uint16_t LINE_SIZE_B = 64;
+  CommunicationMatrix* matrix;
+
+  virtual void SetUp() {
+    matrix = new CommunicationMatrix(LINE_SIZE_B);
+  }
+
+  virtual void TearDown() {
+    delete matrix;
+  }
+
+  void Access(CommunicationMatrix& matrix, const ADDRESS address,
+      const uint8_t size, const AccessType type, const uint16_t thread_id) {
+    matrix.Observe(AccessRecord(address, size, type, HINT_NONE, thread_id),
+        address - address % LINE_SIZE_B);
+  }
+};
+
+TEST_F(CommunicationMatrixTest, ProducerConsumer) {
+  Access(*matrix, 0, 8, ACCESS_STORE, 0);
+  Access(*matrix, 0, 8, ACCESS_LOAD, 1);
+  Access(*matrix, 0, 4, ACCESS_LOAD, 2);
+  ASSERT_EQ(8u, matrix->Get(0, 1));
+  ASSERT_EQ(4u, matrix->Get(0, 2));
+  ASSERT_EQ(0u, matrix->Get(1, 0));
+  ASSERT_EQ(3u, matrix->GetThreadCount());
+}
+
+TEST_F(CommunicationMatrixTest, OwnWritesAreNotCommunication) {
+  Access(*matrix, 0, 8, ACCESS_STORE, 0);
+  Access(*matrix, 0, 8, ACCESS_LOAD, 0);
+  ASSERT_EQ(0u, matrix->GetThreadCount());
+}
+
+TEST_F(CommunicationMatrixTest, OnlyWrittenBytes) {
+  Access(*matrix, 0, 4, ACCESS_STORE, 0);
+  // Half of the load overlaps the store, the rest of the line was never
+  // written.
+  Access(*matrix, 2, 4, ACCESS_LOAD, 1);
+  Access(*matrix, 32, 8, ACCESS_LOAD, 1);
+  ASSERT_EQ(2u, matrix->Get(0, 1));
+}
+
+TEST_F(CommunicationMatrixTest, EmptyAccesses) {
+  Access(*matrix, 0, 8, ACCESS_STORE, 0);
+  Access(*matrix, 0, 0, ACCESS_LOAD, 1);
+  Access(*matrix, 63, 0, ACCESS_LOAD, 1);
+  ASSERT_EQ(0u, matrix->Get(0, 1));
+  // An empty store does not take the line from its writer.
+  Access(*matrix, 8, 0, ACCESS_STORE, 2);
+  Access(*matrix, 0, 8, ACCESS_LOAD, 1);
+  ASSERT_EQ(8u, matrix->Get(0, 1));
+  ASSERT_EQ(0u, matrix->Get(2, 1));
+}
+
+TEST_F(CommunicationMatrixTest, LastWriterWins) {
+  Access(*matrix, 0, 8, ACCESS_STORE, 0);
+  Access(*matrix, 0, 8, ACCESS_RMW, 1);
+  Access(*matrix, 0, 8, ACCESS_LOAD, 2);
+  ASSERT_EQ(8u, matrix->Get(0, 1));
+  ASSERT_EQ(8u, matrix->Get(1, 2));
+  ASSERT_EQ(0u, matrix->Get(0, 2));
+}
+
+TEST_F(CommunicationMatrixTest, WideLines) {
+  CommunicationMatrix wide(256);
+  wide.Observe(AccessRecord(0, 16, ACCESS_STORE, HINT_NONE, 0), 0);
+  wide.Observe(AccessRecord(8, 4, ACCESS_LOAD, HINT_NONE, 1), 0);
+  wide.Observe(AccessRecord(252, 4, ACCESS_LOAD, HINT_NONE, 1), 0);
+  ASSERT_EQ(4u, wide.Get(0, 1));
+}
+
+TEST_F(CommunicationMatrixTest, IntervalExport) {
+  std::ostringstream exported;
+  CommunicationMatrix intervals(LINE_SIZE_B, 2, &exported);
+  Access(intervals, 0, 8, ACCESS_STORE, 0);
+  Access(intervals, 0, 8, ACCESS_LOAD, 1);
+  Access(intervals, 0, 8, ACCESS_STORE, 1);
+  Access(intervals, 0, 4, ACCESS_LOAD, 0);
+  Access(intervals, 0, 4, ACCESS_LOAD, 2);
+  intervals.Export();
+  ASSERT_EQ("0,0,1,8\n1,1,0,4\n2,1,2,4\n", exported.str());
+  ASSERT_EQ(8u, intervals.Get(0, 1));
+  ASSERT_THROW(CommunicationMatrix(LINE_SIZE_B, 2), std::invalid_argument);
+}
+
+TEST_F(CommunicationMatrixTest, ObserveMultilevelCache) {
+  std::vector<uint64_t> capacities_B;
+  std::vector<uint16_t> associativities;
+  capacities_B.push_back(256);
+  capacities_B.push_back(1024);
+  associativities.push_back(2);
+  associativities.push_back(4);
+  MultilevelCache cache(2, capacities_B, associativities, LINE_SIZE_B);
+  cache.AddObserver(matrix);
+  // A store spanning two lines, read back by the other core.
+  cache.Access(AccessRecord(60, 8, ACCESS_STORE, HINT_NONE, 0));
+  cache.Access(AccessRecord(56, 16, ACCESS_LOAD, HINT_NONE, 1));
+  ASSERT_EQ(8u, matrix->Get(0, 1));
+  std::ostringstream report;
+  report << *matrix;
+  ASSERT_NE(std::string::npos, report.str().find("8"));
+}
+
+}
@@ -0,0 +1,166 @@
+/*
+ * ConcurrentMultilevelCacheTest.cpp
+ *
+ *  Created on: Aug 19, 2016
+ *      Author: vance
+ */
+
+#include "../src/ConcurrentMultilevelCache.h"
+#include "../src/MultilevelCache.h"
+
+#include <pthread.h>
+#include <stdexcept>
+#include <stdlib.h>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+class ConcurrentMultilevelCacheTest: public ::testing::Test {
+protected:
+  static const uint16_t LINE_SIZE_B = 64;
+  static const uint32_t N_THREADS = 4;
+  static const uint32_t N_RECORDS = 100000;
+  std::vector<uint64_t> capacities_B;
+  std::vector<uint16_t> associativities;
+  std::vector<AccessRecord> records;
+
+  struct Worker {
+    ConcurrentMultilevelCache* cache;
+    const std::vector<AccessRecord>* records;
+    uint32_t thread;
+  };
+
+  virtual void SetUp() {
+    // 8, 16 and 32 sets.
+    capacities_B.push_back(1024);
+    capacities_B.push_back(4096);
+    capacities_B.push_back(16384);
+    associativities.push_back(2);
+    associativities.push_back(4);
+    associativities.push_back(8);
+    srand(35);
+    for (uint32_t i = 0; i < N_RECORDS; i++) {
+      // Accesses within one line, over 64KB.
+      const ADDRESS line = (rand() % 1024) * LINE_SIZE_B;
+      const uint8_t offset = rand() % 56;
+      records.push_back(
+          AccessRecord(line + offset, 8,
+              rand() % 4 ? ACCESS_LOAD : ACCESS_STORE));
+    }
+  }
+
+  /**
+   * Replays the records of the shards owned by worker thread, in order.
+   */
+  static void* Replay(void* argument) {
+    Worker* const worker = (Worker*) argument;
+    for (size_t i = 0; i < worker->records->size(); i++) {
+      const AccessRecord& record = (*worker->records)[i];
+      if (((record.address / LINE_SIZE_B) & 7) % N_THREADS == worker->thread) {
+        worker->cache->Access(record);
+      }
+    }
+    return NULL;
+  }
+
+  /**
+   * Replays every record from every thread.
+   */
+  static void* ReplayAll(void* argument) {
+    Worker* const worker = (Worker*) argument;
+    for (size_t i = 0; i < worker->records->size(); i++) {
+      AccessRecord record = (*worker->records)[i];
+      record.thread_id = worker->thread;
+      worker->cache->Access(record);
+    }
+    return NULL;
+  }
+
+  void Run(ConcurrentMultilevelCache& cache, void* (*replay)(void*)) {
+    pthread_t threads[N_THREADS];
+    Worker workers[N_THREADS];
+    for (uint32_t i = 0; i < N_THREADS; i++) {
+      workers[i].cache = &cache;
+      workers[i].records = &records;
+      workers[i].thread = i;
+      ASSERT_EQ(0, pthread_create(&threads[i], NULL, replay, &workers[i]));
+    }
+    for (uint32_t i = 0; i < N_THREADS; i++) {
+      pthread_join(threads[i], NULL);
+    }
+  }
+};
+
+TEST(ConcurrentMultilevelCacheParseTest, ParseLevels) {
+  std::vector<uint64_t> capacities_B;
+  std::vector<uint16_t> associativities;
+  ConcurrentMultilevelCache::ParseLevels("32768:8,0x40000,8388608:16",
+      capacities_B, associativities);
+  ASSERT_EQ(3u, capacities_B.size());
+  ASSERT_EQ(0x40000u, capacities_B[1]);
+  ASSERT_EQ(1u, associativities[1]);
+  ASSERT_EQ(16u, associativities[2]);
+  const char* const invalid[] = { "32k", "32768:", "32768:8;65536", ",", ":8" };
+  for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+    ASSERT_THROW(ConcurrentMultilevelCache::ParseLevels(invalid[i],
+        capacities_B, associativities), std::invalid_argument);
+  }
+}
+
+TEST_F(ConcurrentMultilevelCacheTest, ShardCount) {
+  ConcurrentMultilevelCache cache(1, capacities_B, associativities,
+      LINE_SIZE_B);
+  ASSERT_EQ(8u, cache.GetShardCount());
+  ConcurrentMultilevelCache split(1, capacities_B, associativities, 256, 2,
+      LINE_SIZE_B);
+  ASSERT_EQ(2u, split.GetShardCount());
+}
+
+TEST_F(ConcurrentMultilevelCacheTest, MatchesSequential) {
+  MultilevelCache sequential(capacities_B, associativities, LINE_SIZE_B);
+  for (size_t i = 0; i < records.size(); i++) {
+    sequential.Simulate(records[i]);
+  }
+
+  ConcurrentMultilevelCache cache(1, capacities_B, associativities,
+      LINE_SIZE_B);
+  Run(cache, Replay);
+
+  ASSERT_EQ(sequential.hits, cache.Sum(&MultilevelCache::hits));
+  ASSERT_EQ(sequential.misses, cache.Sum(&MultilevelCache::misses));
+  const std::vector<LevelCounters> level_counters = cache.SumLevelCounters();
+  for (size_t i = 0; i < level_counters.size(); i++) {
+    ASSERT_EQ(sequential.level_counters[i].hits, level_counters[i].hits);
+    ASSERT_EQ(sequential.level_counters[i].misses, level_counters[i].misses);
+    ASSERT_EQ(sequential.level_counters[i].GetEvictionCount(),
+        level_counters[i].GetEvictionCount());
+    ASSERT_EQ(sequential.level_counters[i].write_backs,
+        level_counters[i].write_backs);
+  }
+  ASSERT_EQ(sequential.inclusion_victims,
+      cache.Sum(&MultilevelCache::inclusion_victims));
+  ASSERT_EQ(sequential.byte_utilizations,
+      cache.Sum(&MultilevelCache::byte_utilizations));
+}
+
+TEST_F(ConcurrentMultilevelCacheTest, Contended) {
+  ConcurrentMultilevelCache cache(N_THREADS, capacities_B, associativities,
+      LINE_SIZE_B);
+  Run(cache, ReplayAll);
+  ASSERT_EQ(N_THREADS * N_RECORDS,
+      cache.Sum(&MultilevelCache::hits) + cache.Sum(&MultilevelCache::misses));
+  std::vector<uint64_t> core_hits = cache.Sum(&MultilevelCache::core_hits);
+  ASSERT_EQ((size_t) N_THREADS, core_hits.size());
+}
+
+TEST_F(ConcurrentMultilevelCacheTest, AccessSpanningShards) {
+  ConcurrentMultilevelCache cache(1, capacities_B, associativities,
+      LINE_SIZE_B);
+  cache.Access(AccessRecord(60, 8));
+  ASSERT_EQ(2u, cache.Sum(&MultilevelCache::misses));
+  cache.Access(AccessRecord(64, 4));
+  ASSERT_EQ(1u, cache.Sum(&MultilevelCache::hits));
+}
+
+}
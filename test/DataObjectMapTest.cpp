@@ -0,0 +1,219 @@
+/*
+ * DataObjectMapTest.cpp
+ *
+ *  Created on: Sep 18, 2016
+ *      Author: vance
+ */
+
+#include "../src/ConcurrentMultilevelCache.h"
+#include "../src/DataObjectMap.h"
+#include "../src/MultilevelCache.h"
+
+#include <sstream>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+class DataObjectMapTest: public ::testing::Test {
+protected:
+  static const uint16_t LINE_SIZE_B = 64;
+
+  static AccessRecord Load(const ADDRESS address, const uint8_t size) {
+    return AccessRecord(address, size, ACCESS_LOAD);
+  }
+
+  static AccessRecord Allocate(const ADDRESS address, const uint32_t size,
+      const ADDRESS site) {
+    return AccessRecord(address, size, ACCESS_ALLOC, HINT_NONE, 0, 0, site);
+  }
+
+  static AccessRecord Free(const ADDRESS address) {
+    return AccessRecord(address, 0, ACCESS_FREE);
+  }
+
+  static const ObjectSite* GetSite(const DataObjectMap& map,
+      const ADDRESS address) {
+    const std::vector<ObjectSite>& sites = map.GetSites();
+    for (size_t i = 0; i < sites.size(); i++) {
+      if (sites[i].address == address) {
+        return &sites[i];
+      }
+    }
+    return NULL;
+  }
+};
+
+TEST_F(DataObjectMapTest, Lookup) {
+  DataObjectMap map(LINE_SIZE_B);
+  map.AddGlobal(0x1000, 16, "table");
+  map.Allocate(0x2000, 100, 0x400);
+  map.Allocate(0x2080, 100, 0x400);
+  map.Allocate(0x3000, 8, 0x500);
+  ASSERT_EQ(4u, map.GetObjectCount());
+
+  map.Miss(0x100f);
+  map.Miss(0x1010);
+  map.Miss(0x2063);
+  map.Miss(0x2064);
+  map.Miss(0x20e3);
+  map.Miss(0x3000);
+  ASSERT_EQ(1u, GetSite(map, 0x1000)->misses);
+  ASSERT_EQ("table", GetSite(map, 0x1000)->name);
+  ASSERT_EQ(2u, GetSite(map, 0x400)->misses);
+  ASSERT_EQ(2u, GetSite(map, 0x400)->objects);
+  ASSERT_EQ(1u, GetSite(map, 0x500)->misses);
+  ASSERT_EQ(2u, map.unknown.misses);
+  ASSERT_EQ(6u, map.n_lookups);
+
+  // The last object found answers the next lookup in it.
+  map.Miss(0x3004);
+  ASSERT_EQ(1u, map.n_last_hits);
+
+  map.Free(0x3000);
+  map.Miss(0x3004);
+  ASSERT_EQ(3u, map.unknown.misses);
+  // Globals are not freed.
+  map.Free(0x1000);
+  ASSERT_EQ(3u, map.GetObjectCount());
+  // An allocation replaces the objects it covers, whose frees were lost.
+  map.Allocate(0x2000, 256, 0x600);
+  ASSERT_EQ(2u, map.GetObjectCount());
+  map.Miss(0x2080);
+  ASSERT_EQ(1u, GetSite(map, 0x600)->misses);
+}
+
+TEST_F(DataObjectMapTest, Evict) {
+  DataObjectMap map(LINE_SIZE_B);
+  map.Allocate(0x2000, 256, 0x400);
+  map.Evict(0x2000, 16);
+  map.Evict(0x2048, 64);
+  map.Evict(0x3000, 8);
+  const ObjectSite& site = *GetSite(map, 0x400);
+  ASSERT_EQ(2u, site.evictions);
+  ASSERT_EQ(80u, site.used_bytes);
+  ASSERT_EQ(48u, site.GetWastedBytes());
+  ASSERT_EQ(1u, site.byte_utilizations[15]);
+  ASSERT_EQ(1u, site.byte_utilizations[63]);
+  ASSERT_EQ(56u, map.unknown.GetWastedBytes());
+}
+
+TEST_F(DataObjectMapTest, Shard) {
+  // Shard 1 of 4 holds lines 1, 5, 9...
+  DataObjectMap map(LINE_SIZE_B, 1, 2);
+  map.Allocate(0, LINE_SIZE_B, 0x400);
+  map.Allocate(LINE_SIZE_B, 8, 0x500);
+  map.Allocate(2 * LINE_SIZE_B, 3 * LINE_SIZE_B, 0x600);
+  map.Allocate(6 * LINE_SIZE_B, 4 * LINE_SIZE_B, 0x700);
+  ASSERT_EQ(2u, map.GetObjectCount());
+  // Line 1 is line 0 of the shard, line 5 line 1 and line 9 line 2.
+  map.Miss(4);
+  map.Miss(LINE_SIZE_B + 4);
+  map.Miss(2 * LINE_SIZE_B);
+  ASSERT_EQ(1u, GetSite(map, 0x500)->misses);
+  ASSERT_EQ(1u, map.unknown.misses);
+  ASSERT_EQ(1u, GetSite(map, 0x700)->misses);
+  // Shard 0 counts the objects.
+  ASSERT_EQ(0u, GetSite(map, 0x500)->objects);
+  ASSERT_THROW(DataObjectMap(LINE_SIZE_B, 4, 2), std::invalid_argument);
+}
+
+TEST_F(DataObjectMapTest, Merge) {
+  DataObjectMap a(LINE_SIZE_B);
+  DataObjectMap b(LINE_SIZE_B);
+  a.AddGlobal(0x1000, 8, "counter");
+  b.AddGlobal(0x1000, 8, "counter");
+  a.Allocate(0x2000, 8, 0x400);
+  b.Allocate(0x3000, 8, 0x500);
+  a.Miss(0x1000);
+  b.Miss(0x1000);
+  b.Miss(0x3000);
+  b.Miss(0x4000);
+  b.Evict(0x3000, 8);
+  a.Merge(b);
+  ASSERT_EQ(2u, GetSite(a, 0x1000)->misses);
+  ASSERT_EQ(1u, GetSite(a, 0x500)->misses);
+  ASSERT_EQ(1u, a.unknown.misses);
+  ASSERT_EQ(3u, a.GetSites().size());
+  // Only the objects of a are live in a.
+  ASSERT_EQ(2u, a.GetObjectCount());
+  ASSERT_THROW(a.Merge(DataObjectMap(32)), std::invalid_argument);
+  // Static variables of the same name in different units stay apart.
+  DataObjectMap c(LINE_SIZE_B);
+  c.AddGlobal(0x5000, 8, "counter");
+  c.Miss(0x5000);
+  a.Merge(c);
+  ASSERT_EQ(2u, GetSite(a, 0x1000)->misses);
+  ASSERT_EQ(1u, GetSite(a, 0x5000)->misses);
+  ASSERT_EQ("counter", GetSite(a, 0x5000)->name);
+
+  std::vector<ObjectSite> top = a.GetTopMisses(10);
+  ASSERT_EQ(3u, top.size());
+  ASSERT_EQ("counter", top[0].name);
+  top = a.GetTopWastedBytes(1);
+  ASSERT_EQ(1u, top.size());
+  ASSERT_EQ(0x500u, top[0].address);
+  std::ostringstream stream;
+  stream << a;
+  ASSERT_NE(std::string::npos, stream.str().find("counter"));
+}
+
+TEST_F(DataObjectMapTest, Hierarchy) {
+  std::vector<uint64_t> capacities_B;
+  std::vector<uint16_t> associativities;
+  capacities_B.push_back(LINE_SIZE_B);
+  associativities.push_back(1);
+  MultilevelCache cache(capacities_B, associativities, LINE_SIZE_B);
+  DataObjectMap objects(LINE_SIZE_B);
+  cache.SetDataObjects(&objects);
+  cache.Simulate(Allocate(0, 2 * LINE_SIZE_B, 0x400));
+  cache.Access(Load(8, 4));
+  cache.Access(Load(0, 4));
+  // Evicts line 0, charged to the first byte accessed, then misses.
+  cache.Access(Load(4 * LINE_SIZE_B, 4));
+  cache.Simulate(Free(0));
+  cache.Access(Load(8, 4));
+  const ObjectSite& site = *GetSite(objects, 0x400);
+  ASSERT_EQ(1u, site.misses);
+  ASSERT_EQ(1u, site.evictions);
+  ASSERT_EQ(56u, site.GetWastedBytes());
+  ASSERT_EQ(2u, objects.unknown.misses);
+  ASSERT_EQ(1u, objects.unknown.evictions);
+  // Events are not accesses.
+  ASSERT_EQ(3u, cache.misses);
+  ASSERT_EQ(1u, cache.hits);
+  // The line of the last load is resident when finalized.
+  cache.Finalize();
+  ASSERT_EQ(1u, objects.unknown.resident);
+  ASSERT_EQ(60u, objects.unknown.GetResidentWastedBytes());
+  ASSERT_EQ(0u, site.resident);
+  cache.SetDataObjects(NULL);
+}
+
+TEST_F(DataObjectMapTest, Shards) {
+  std::vector<uint64_t> capacities_B;
+  std::vector<uint16_t> associativities;
+  capacities_B.push_back(4 * LINE_SIZE_B);
+  capacities_B.push_back(8 * LINE_SIZE_B);
+  associativities.push_back(1);
+  associativities.push_back(2);
+  ConcurrentMultilevelCache cache(1, capacities_B, associativities,
+      LINE_SIZE_B);
+  cache.EnableDataObjects();
+  cache.AddGlobal(0x10000, 8, "flag");
+  cache.Access(Allocate(0, 4 * LINE_SIZE_B, 0x400));
+  // The lines fall in different shards.
+  for (ADDRESS line = 0; line < 4; line++) {
+    cache.Access(Load(line * LINE_SIZE_B + 8, 8));
+  }
+  cache.Access(Load(0x10000, 8));
+  cache.Access(Load(0x20000, 8));
+  const DataObjectMap merged = cache.MergeDataObjects();
+  ASSERT_EQ(4u, GetSite(merged, 0x400)->misses);
+  ASSERT_EQ(1u, GetSite(merged, 0x400)->objects);
+  ASSERT_EQ(1u, GetSite(merged, 0x10000)->misses);
+  ASSERT_EQ(1u, GetSite(merged, 0x10000)->objects);
+  ASSERT_EQ(1u, merged.unknown.misses);
+}
+
+}
@@ -0,0 +1,148 @@
+/*
+ * FalseSharingDetectorTest.cpp
+ *
+ *  Created on: Aug 16, 2016
+ *      Author: vance
+ */
+
+#include "../src/FalseSharingDetector.h"
+#include "../src/MultilevelCache.h"
+
+#include <sstream>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+class FalseSharingDetectorTest: public ::testing::Test {
+protected:
+  static const uint16_t LINE_SIZE_B = 8;
+  FalseSharingDetector* detector;
+
+  virtual void SetUp() {
+    detector = new FalseSharingDetector(LINE_SIZE_B);
+  }
+
+  virtual void TearDown() {
+    delete detector;
+  }
+
+  void Store(const ADDRESS address, const uint8_t size,
+      const uint16_t thread_id) {
+    detector->Observe(
+        AccessRecord(address, size, ACCESS_STORE, HINT_NONE, thread_id),
+        address - address % LINE_SIZE_B);
+  }
+};
+
+TEST_F(FalseSharingDetectorTest, DisjointWritesPingPong) {
+  for (int i = 0; i < 4; i++) {
+    Store(0, 4, 0);
+    Store(4, 4, 1);
+  }
+  std::vector<FalseSharingReport> reports = detector->GetFalseSharing();
+  ASSERT_EQ(1u, reports.size());
+  ASSERT_EQ(0u, reports[0].address);
+  ASSERT_EQ(0u, reports[0].thread_a);
+  ASSERT_EQ(1u, reports[0].thread_b);
+  // The first write of each thread is a cold miss.
+  ASSERT_EQ(6u, reports[0].ping_pongs);
+  ASSERT_EQ(0u, reports[0].true_sharing_transfers);
+  ASSERT_EQ(0x0fu, reports[0].bytes_a.to_ulong());
+  ASSERT_EQ(0xf0u, reports[0].bytes_b.to_ulong());
+}
+
+TEST_F(FalseSharingDetectorTest, TrueSharing) {
+  for (int i = 0; i < 4; i++) {
+    Store(0, 4, 0);
+    Store(2, 4, 1);
+  }
+  ASSERT_TRUE(detector->GetFalseSharing().empty());
+}
+
+TEST_F(FalseSharingDetectorTest, PrivateLines) {
+  for (int i = 0; i < 4; i++) {
+    Store(0, 8, 0);
+    Store(8, 8, 1);
+  }
+  ASSERT_TRUE(detector->GetFalseSharing().empty());
+}
+
+TEST_F(FalseSharingDetectorTest, SharedOnSecondThread) {
+  for (ADDRESS line = 0; line < 4; line++) {
+    Store(line * LINE_SIZE_B, 4, 0);
+  }
+  ASSERT_EQ(0u, detector->GetSharedLineCount());
+  // The bytes thread 0 wrote before the line was shared are kept.
+  Store(4, 4, 1);
+  Store(0, 4, 0);
+  ASSERT_EQ(1u, detector->GetSharedLineCount());
+  std::vector<FalseSharingReport> reports = detector->GetFalseSharing();
+  ASSERT_EQ(1u, reports.size());
+  ASSERT_EQ(1u, reports[0].ping_pongs);
+  ASSERT_EQ(0x0fu, reports[0].bytes_a.to_ulong());
+}
+
+TEST_F(FalseSharingDetectorTest, ReadOfUnwrittenBytes) {
+  Store(0, 4, 0);
+  detector->Observe(AccessRecord(4, 4, ACCESS_LOAD, HINT_NONE, 1), 0);
+  Store(0, 4, 0);
+  detector->Observe(AccessRecord(4, 4, ACCESS_LOAD, HINT_NONE, 1), 0);
+  std::vector<FalseSharingReport> reports = detector->GetFalseSharing();
+  ASSERT_EQ(1u, reports.size());
+  ASSERT_EQ(1u, reports[0].ping_pongs);
+}
+
+TEST_F(FalseSharingDetectorTest, MostPingPongsFirst) {
+  for (int i = 0; i < 2; i++) {
+    Store(0, 1, 0);
+    Store(1, 1, 1);
+  }
+  for (int i = 0; i < 4; i++) {
+    Store(8, 1, 2);
+    Store(9, 1, 3);
+  }
+  std::vector<FalseSharingReport> reports = detector->GetFalseSharing();
+  ASSERT_EQ(2u, reports.size());
+  ASSERT_EQ(8u, reports[0].address);
+  ASSERT_EQ(6u, reports[0].ping_pongs);
+  ASSERT_EQ(0u, reports[1].address);
+  ASSERT_EQ(2u, reports[1].ping_pongs);
+}
+
+TEST_F(FalseSharingDetectorTest, Report) {
+  for (int i = 0; i < 2; i++) {
+    Store(0, 2, 0);
+    Store(4, 4, 1);
+  }
+  std::ostringstream report;
+  report << *detector;
+  ASSERT_NE(std::string::npos, report.str().find("0-1"));
+  ASSERT_NE(std::string::npos, report.str().find("4-7"));
+}
+
+TEST_F(FalseSharingDetectorTest, ObserveMultilevelCache) {
+  std::vector<uint64_t> capacities_B;
+  std::vector<uint16_t> associativities;
+  capacities_B.push_back(16);
+  capacities_B.push_back(32);
+  associativities.push_back(2);
+  associativities.push_back(4);
+  MultilevelCache cache(2, capacities_B, associativities, LINE_SIZE_B);
+  cache.AddObserver(detector);
+  for (int i = 0; i < 2; i++) {
+    // Thread 0's store spans the first two lines.
+    cache.Access(AccessRecord(6, 4, ACCESS_STORE, HINT_NONE, 0));
+    cache.Access(AccessRecord(0, 4, ACCESS_STORE, HINT_NONE, 1));
+    cache.Access(AccessRecord(12, 4, ACCESS_STORE, HINT_NONE, 1));
+  }
+  std::vector<FalseSharingReport> reports = detector->GetFalseSharing();
+  ASSERT_EQ(2u, reports.size());
+  ASSERT_EQ(0xc0u, reports[0].bytes_a.to_ulong());
+  ASSERT_EQ(0x0fu, reports[0].bytes_b.to_ulong());
+  ASSERT_EQ(0x03u, reports[1].bytes_a.to_ulong());
+  ASSERT_EQ(0xf0u, reports[1].bytes_b.to_ulong());
+  ASSERT_EQ(2u, cache.coherence_misses[0]);
+}
+
+}
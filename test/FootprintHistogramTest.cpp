@@ -0,0 +1,117 @@
+/*
+ * FootprintHistogramTest.cpp
+ *
+ *  Created on: Sep 15, 2016
+ *      Author: vance
+ */
+
+#include "../src/FootprintHistogram.h"
+#include "../src/MultilevelCache.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+class FootprintHistogramTest: public ::testing::Test {
+protected:
+  static const uint16_t LINE_SIZE_B = 64;
+
+  /**
+   * Returns the bytes of a line with the bytes from first to last accessed,
+   * every stride bytes.
+   */
+  static boost::dynamic_bitset<> Bytes(const size_t first, const size_t last,
+      const size_t stride) {
+    boost::dynamic_bitset<> bytes(LINE_SIZE_B);
+    for (size_t i = first; i <= last; i += stride) {
+      bytes[i] = true;
+    }
+    return bytes;
+  }
+};
+
+TEST_F(FootprintHistogramTest, Runs) {
+  FootprintHistogram histogram(LINE_SIZE_B);
+  // 8 bytes at the start of a line, then 8 bytes scattered across one.
+  histogram.Record(Bytes(0, 7, 1), 0);
+  histogram.Record(Bytes(0, 56, 8), 16);
+  histogram.Record(boost::dynamic_bitset<>(LINE_SIZE_B), 0);
+  ASSERT_EQ(2u, histogram.n_lines);
+  ASSERT_EQ(1u, histogram.run_lengths[7]);
+  ASSERT_EQ(8u, histogram.run_lengths[0]);
+  ASSERT_EQ(1u, histogram.run_counts[1]);
+  ASSERT_EQ(1u, histogram.run_counts[8]);
+  ASSERT_EQ(1u, histogram.first_offsets[0]);
+  ASSERT_EQ(1u, histogram.first_offsets[16]);
+
+  std::vector<FootprintCount> top = histogram.GetTop();
+  ASSERT_EQ(2u, top.size());
+  ASSERT_EQ(0xffu, top[0].footprint);
+  ASSERT_EQ(0x0101010101010101u, top[1].footprint);
+}
+
+TEST_F(FootprintHistogramTest, SpaceSaving) {
+  FootprintHistogram histogram(LINE_SIZE_B, 2);
+  for (int i = 0; i < 3; i++) {
+    histogram.Record(Bytes(0, 3, 1), 0);
+  }
+  histogram.Record(Bytes(4, 7, 1), 4);
+  // Takes over the entry of 4-7.
+  histogram.Record(Bytes(8, 11, 1), 8);
+  std::vector<FootprintCount> top = histogram.GetTop();
+  ASSERT_EQ(2u, top.size());
+  ASSERT_EQ(0xfu, top[0].footprint);
+  ASSERT_EQ(3u, top[0].count);
+  ASSERT_EQ(0u, top[0].error);
+  ASSERT_EQ(0xf00u, top[1].footprint);
+  ASSERT_EQ(2u, top[1].count);
+  ASSERT_EQ(1u, top[1].error);
+}
+
+TEST_F(FootprintHistogramTest, Granules) {
+  FootprintHistogram histogram(256);
+  ASSERT_EQ(4u, histogram.GetGranuleSize());
+  boost::dynamic_bitset<> bytes(256);
+  bytes[3] = true;
+  bytes[4] = true;
+  bytes[255] = true;
+  histogram.Record(bytes, 3);
+  ASSERT_EQ(0x8000000000000003u, histogram.GetTop()[0].footprint);
+  ASSERT_EQ(1u, histogram.run_lengths[1]);
+  ASSERT_EQ(1u, histogram.run_lengths[0]);
+}
+
+TEST_F(FootprintHistogramTest, Merge) {
+  FootprintHistogram a(LINE_SIZE_B);
+  FootprintHistogram b(LINE_SIZE_B);
+  a.Record(Bytes(0, 3, 1), 0);
+  b.Record(Bytes(0, 3, 1), 2);
+  b.Record(Bytes(4, 7, 1), 4);
+  a.Merge(b);
+  ASSERT_EQ(3u, a.n_lines);
+  ASSERT_EQ(2u, a.GetTop()[0].count);
+  ASSERT_EQ(1u, a.first_offsets[2]);
+  ASSERT_EQ(3u, a.run_lengths[3]);
+  ASSERT_THROW(a.Merge(FootprintHistogram(32)), std::invalid_argument);
+}
+
+TEST_F(FootprintHistogramTest, Evictions) {
+  std::vector<uint64_t> capacities_B;
+  std::vector<uint16_t> associativities;
+  capacities_B.push_back(LINE_SIZE_B);
+  associativities.push_back(1);
+  MultilevelCache cache(capacities_B, associativities, LINE_SIZE_B);
+  cache.Access(8, 4);
+  cache.Access(0, 2);
+  // Evicts line 0.
+  cache.Access(LINE_SIZE_B, 1);
+  ASSERT_EQ(1u, cache.footprints.n_lines);
+  ASSERT_EQ(0x0f03u, cache.footprints.GetTop()[0].footprint);
+  ASSERT_EQ(1u, cache.footprints.first_offsets[8]);
+  ASSERT_EQ(1u, cache.footprints.run_counts[2]);
+  // Resident lines are not evictions.
+  cache.Finalize();
+  ASSERT_EQ(1u, cache.footprints.n_lines);
+}
+
+}
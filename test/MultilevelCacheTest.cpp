@@ -8,6 +8,9 @@
 #include "../src/CacheLine.h"
 #include "../src/Cache.h"
 #include "../src/MultilevelCache.h"
+#include "../src/TraceMerger.h"
+
+#include <sstream>
 
 #include "gtest/gtest.h"
 
@@ -50,4 +53,608 @@ TEST_F(MultilevelCacheTest, CacheAccess) {
   ASSERT_TRUE(true);
 }
 
+TEST(MultilevelCacheSplitTest, WideAccess) {
+  std::vector<uint64_t> capacities_B(1, 1024);
+  std::vector<uint16_t> associativities(1, 2);
+  MultilevelCache cache(capacities_B, associativities, 64);
+  // Wider than a uint8_t: split into its 4 lines.
+  cache.Access(AccessRecord(0x2000, 256));
+  ASSERT_EQ(4u, cache.misses);
+  cache.Access(AccessRecord(0x2020, 300));
+  ASSERT_EQ(6u, cache.misses);
+  ASSERT_EQ(4u, cache.hits);
+}
+
+TEST_F(MultilevelCacheTest, CacheLevelMask) {
+  CacheLine* line = cache->Access(0, 1).front();
+  ASSERT_EQ(0x7u, line->GetLevels());
+  cache->Access(4, 1);
+  // 0 was evicted from the L1 but is still held by the L2 and L3.
+  ASSERT_EQ(0x6u, line->GetLevels());
+  cache->Access(0, 1);
+  ASSERT_EQ(0x7u, line->GetLevels());
+  ASSERT_EQ(2u, cache->misses);
+  ASSERT_EQ(1u, cache->hits);
+}
+
+TEST_F(MultilevelCacheTest, CacheInclusionVictims) {
+  cache->Access(0, 1);
+  cache->Access(4, 1);
+  // The L3 set holding 0 and 4 is full: 0 is the LRU line and is
+  // back-invalidated from the L2 (it has already left the L1).
+  cache->Access(8, 1);
+  ASSERT_EQ(0u, cache->inclusion_victims[0]);
+  ASSERT_EQ(1u, cache->inclusion_victims[1]);
+  ASSERT_EQ(0u, cache->inclusion_victims[2]);
+  ASSERT_EQ(3u, cache->misses);
+  ASSERT_EQ(1u, cache->byte_utilizations[0]);
+}
+
+TEST_F(MultilevelCacheTest, LevelCounters) {
+  cache->Access(0, 1);
+  cache->Access(4, 1);
+  cache->Access(8, 1);
+  for (uint8_t i = 0; i < 3; i++) {
+    ASSERT_EQ(0u, cache->level_counters[i].hits);
+    ASSERT_EQ(3u, cache->level_counters[i].misses);
+    ASSERT_EQ(3u, cache->level_counters[i].fills);
+  }
+  // The L1 made room twice. The L3 evicted 0, which the L2 still held.
+  ASSERT_EQ(2u, cache->level_counters[0].evictions[EVICTION_CAPACITY]);
+  ASSERT_EQ(0u, cache->level_counters[1].evictions[EVICTION_CAPACITY]);
+  ASSERT_EQ(1u, cache->level_counters[1].evictions[EVICTION_INCLUSION]);
+  ASSERT_EQ(1u, cache->level_counters[2].evictions[EVICTION_CAPACITY]);
+  ASSERT_EQ(1u, cache->level_counters[2].back_invalidations);
+  ASSERT_EQ(1u, cache->level_counters[1].GetEvictionCount());
+
+  // 4 is served by the L2.
+  cache->Access(4, 1);
+  ASSERT_EQ(4u, cache->level_counters[0].misses);
+  ASSERT_EQ(1u, cache->level_counters[1].hits);
+  ASSERT_EQ(0u, sizeof(LevelCounters) % CACHE_LINE_B);
+}
+
+class InclusionPolicyTest: public ::testing::Test {
+protected:
+  static const ADDRESS A = 0, B = 1, C = 2, D = 3;
+  MultilevelCache* cache;
+
+  virtual void SetUp() {
+    std::vector<uint64_t> capacities_B;
+    std::vector<uint16_t> associativities;
+    capacities_B.push_back(2);
+    capacities_B.push_back(3);
+    associativities.push_back(2);
+    associativities.push_back(3);
+    cache = new MultilevelCache(capacities_B, associativities, 1);
+  }
+
+  virtual void TearDown() {
+    delete cache;
+  }
+
+  /**
+   * Leaves B hot in the L1 while it is the LLC's LRU line, then misses on D.
+   */
+  void AccessPattern() {
+    cache->Access(A, 1);
+    cache->Access(B, 1);
+    cache->Access(C, 1);
+    cache->Access(B, 1);
+    cache->Access(A, 1);
+    cache->Access(D, 1);
+    cache->Access(B, 1);
+  }
+};
+
+TEST_F(InclusionPolicyTest, LRU) {
+  AccessPattern();
+  ASSERT_EQ(1u, cache->inclusion_victims[0]);
+  ASSERT_EQ(0u, cache->inclusion_victims_avoided);
+  ASSERT_EQ(5u, cache->misses);
+}
+
+TEST_F(InclusionPolicyTest, TLH) {
+  cache->SetInclusionPolicy(INCLUSION_POLICY_TLH);
+  AccessPattern();
+  ASSERT_EQ(0u, cache->inclusion_victims[0]);
+  ASSERT_EQ(1u, cache->temporal_locality_hints);
+  ASSERT_EQ(4u, cache->misses);
+  ASSERT_EQ(2u, cache->level_counters[1].hits);
+}
+
+TEST_F(InclusionPolicyTest, ECI) {
+  cache->SetInclusionPolicy(INCLUSION_POLICY_ECI);
+  AccessPattern();
+  ASSERT_EQ(2u, cache->early_invalidations[0]);
+  ASSERT_EQ(1u, cache->inclusion_victims_avoided);
+}
+
+TEST_F(InclusionPolicyTest, QBS) {
+  cache->SetInclusionPolicy(INCLUSION_POLICY_QBS);
+  AccessPattern();
+  ASSERT_EQ(0u, cache->inclusion_victims[0]);
+  ASSERT_EQ(1u, cache->inclusion_victims_avoided);
+  ASSERT_EQ(4u, cache->misses);
+  ASSERT_EQ(2u, cache->level_counters[1].hits);
+}
+
+class WritePolicyTest: public ::testing::Test {
+protected:
+  MultilevelCache* cache;
+
+  virtual void SetUp() {
+    std::vector<uint64_t> capacities_B;
+    std::vector<uint16_t> associativities;
+    capacities_B.push_back(4);
+    capacities_B.push_back(8);
+    capacities_B.push_back(16);
+    associativities.push_back(1);
+    associativities.push_back(2);
+    associativities.push_back(4);
+    cache = new MultilevelCache(capacities_B, associativities, 4);
+  }
+
+  virtual void TearDown() {
+    delete cache;
+  }
+};
+
+TEST_F(WritePolicyTest, WriteBack) {
+  CacheLine* line = cache->Access(0, 2, ACCESS_STORE).front();
+  ASSERT_EQ(2u, line->CountDirtyBytes(0));
+  cache->Access(4, 4);
+  // The L1 copy was written back into the L2 copy.
+  ASSERT_EQ(0u, line->CountDirtyBytes(0));
+  ASSERT_EQ(2u, line->CountDirtyBytes(1));
+  ASSERT_EQ(1u, cache->level_counters[0].write_backs);
+  ASSERT_EQ(4u, cache->write_back_bytes[0]);
+  ASSERT_EQ(2u, cache->write_back_dirty_bytes[0]);
+  cache->Access(8, 4);
+  cache->Access(12, 4);
+  cache->Access(16, 4);
+  // The line left the hierarchy and was written back to memory.
+  ASSERT_EQ(1u, cache->level_counters[1].write_backs);
+  ASSERT_EQ(1u, cache->level_counters[2].write_backs);
+  ASSERT_EQ(4u, cache->write_back_bytes[2]);
+  ASSERT_EQ(2u, cache->write_back_dirty_bytes[2]);
+}
+
+TEST(WritePolicyInclusionTest, WriteBackOnInclusionVictim) {
+  std::vector<uint64_t> capacities_B;
+  std::vector<uint16_t> associativities;
+  capacities_B.push_back(8);
+  capacities_B.push_back(12);
+  associativities.push_back(2);
+  associativities.push_back(3);
+  MultilevelCache cache(capacities_B, associativities, 4);
+
+  CacheLine* line = cache.Access(0, 4, ACCESS_RMW).front();
+  cache.Access(4, 4);
+  cache.Access(0, 1, ACCESS_STORE);
+  cache.Access(8, 4);
+  ASSERT_EQ(4u, line->CountDirtyBytes(0));
+  cache.Access(12, 4);
+  // The dirty L1 copy is back-invalidated along with the LLC copy and
+  // reaches memory through the LLC.
+  ASSERT_EQ(1u, cache.inclusion_victims[0]);
+  ASSERT_EQ(1u, cache.level_counters[0].write_backs);
+  ASSERT_EQ(1u, cache.level_counters[1].write_backs);
+  ASSERT_EQ(4u, cache.write_back_dirty_bytes[1]);
+}
+
+TEST_F(WritePolicyTest, WriteThrough) {
+  cache->SetWritePolicy(0, WRITE_THROUGH, WRITE_ALLOCATE);
+  CacheLine* line = cache->Access(0, 2, ACCESS_STORE).front();
+  ASSERT_EQ(0x7u, line->GetLevels());
+  ASSERT_EQ(0u, line->CountDirtyBytes(0));
+  ASSERT_EQ(2u, line->CountDirtyBytes(1));
+  ASSERT_EQ(2u, cache->write_through_bytes[0]);
+  cache->Access(4, 4);
+  ASSERT_EQ(0u, cache->level_counters[0].write_backs);
+}
+
+TEST_F(WritePolicyTest, NoWriteAllocate) {
+  cache->SetWritePolicy(0, WRITE_BACK, NO_WRITE_ALLOCATE);
+  CacheLine* line = cache->Access(0, 2, ACCESS_STORE).front();
+  ASSERT_EQ(0x6u, line->GetLevels());
+  ASSERT_EQ(2u, line->CountDirtyBytes(1));
+  ASSERT_EQ(2u, cache->write_through_bytes[0]);
+  // A load still allocates.
+  cache->Access(0, 2);
+  ASSERT_EQ(0x7u, line->GetLevels());
+}
+
+TEST_F(WritePolicyTest, NoWriteAllocateAnywhere) {
+  cache->SetWritePolicy(0, WRITE_BACK, NO_WRITE_ALLOCATE);
+  cache->SetWritePolicy(1, WRITE_BACK, NO_WRITE_ALLOCATE);
+  cache->SetWritePolicy(2, WRITE_BACK, NO_WRITE_ALLOCATE);
+  ASSERT_EQ(NULL, cache->Access(0, 2, ACCESS_STORE).front());
+  ASSERT_EQ(1u, cache->misses);
+  ASSERT_EQ(2u, cache->write_through_bytes[0]);
+  ASSERT_EQ(2u, cache->write_through_bytes[1]);
+  ASSERT_EQ(2u, cache->write_through_bytes[2]);
+}
+
+TEST_F(WritePolicyTest, LevelUtilization) {
+  cache->Access(0, 1);
+  cache->Access(4, 2);
+  // 0 returns to the L1 from the L2.
+  cache->Access(1, 1);
+  cache->Access(8, 4);
+  cache->Access(12, 4);
+  // Each of the L1's residencies of 0 used one byte.
+  ASSERT_EQ(2u, cache->level_byte_utilizations[0][1]);
+  ASSERT_EQ(1u, cache->level_byte_utilizations[0][2]);
+  ASSERT_EQ(1u, cache->level_byte_utilizations[0][4]);
+  ASSERT_EQ(8u, cache->level_counters[0].used_bytes);
+  // The L2 evicted 4, then 0.
+  ASSERT_EQ(2u, cache->level_byte_utilizations[1][2]);
+  ASSERT_EQ(4u, cache->level_counters[1].used_bytes);
+  ASSERT_EQ(0u, cache->level_counters[2].used_bytes);
+}
+
+TEST_F(WritePolicyTest, Finalize) {
+  cache->Access(0, 1);
+  cache->Access(4, 2);
+  cache->Access(8, 4);
+  cache->Finalize();
+  ASSERT_EQ(1u, cache->level_counters[0].resident_lines);
+  ASSERT_EQ(4u, cache->level_counters[0].resident_used_bytes);
+  ASSERT_EQ(2u, cache->level_counters[1].resident_lines);
+  ASSERT_EQ(6u, cache->level_counters[1].resident_used_bytes);
+  ASSERT_EQ(3u, cache->level_counters[2].resident_lines);
+  ASSERT_EQ(7u, cache->level_counters[2].resident_used_bytes);
+  // The resident lines are not counted as evicted.
+  ASSERT_EQ(0u, cache->level_counters[2].GetEvictionCount());
+  ASSERT_EQ(1u, cache->resident_byte_utilizations[0]);
+  ASSERT_EQ(1u, cache->resident_byte_utilizations[1]);
+  ASSERT_EQ(1u, cache->resident_byte_utilizations[3]);
+  ASSERT_EQ(0u, cache->byte_utilizations[0]);
+  // The hierarchy is cold.
+  cache->Access(8, 4);
+  ASSERT_EQ(4u, cache->level_counters[2].misses);
+}
+
+class AccessHintTest: public WritePolicyTest {
+protected:
+  static AccessRecord Record(const ADDRESS address, const uint8_t size,
+      const AccessType type, const uint8_t hints) {
+    AccessRecord record;
+    record.address = address;
+    record.size = size;
+    record.type = type;
+    record.hints = hints;
+    return record;
+  }
+};
+
+TEST_F(AccessHintTest, BypassL1) {
+  CacheLine* line =
+      cache->Access(Record(0, 4, ACCESS_LOAD, HINT_BYPASS_L1)).front();
+  ASSERT_EQ(0x6u, line->GetLevels());
+}
+
+TEST_F(AccessHintTest, BypassL2) {
+  CacheLine* line =
+      cache->Access(Record(0, 4, ACCESS_LOAD, HINT_BYPASS_L2)).front();
+  ASSERT_EQ(0x4u, line->GetLevels());
+  // Without the hint the line is promoted as usual.
+  cache->Access(0, 4);
+  ASSERT_EQ(0x7u, line->GetLevels());
+  ASSERT_EQ(1u, cache->level_counters[2].hits);
+}
+
+TEST_F(AccessHintTest, InsertLRU) {
+  cache->Access(0, 4);
+  cache->Access(4, 4);
+  cache->Access(8, 4);
+  cache->Access(Record(12, 4, ACCESS_LOAD, HINT_INSERT_LRU));
+  // 12 was the LLC's next victim.
+  cache->Access(16, 4);
+  cache->Access(0, 4);
+  ASSERT_EQ(1u, cache->hits);
+  cache->Access(12, 4);
+  ASSERT_EQ(6u, cache->misses);
+}
+
+TEST_F(AccessHintTest, NonTemporalStoreInvalidates) {
+  cache->Access(0, 4, ACCESS_STORE);
+  ASSERT_EQ(NULL,
+      cache->Access(Record(0, 4, ACCESS_STORE, HINT_NON_TEMPORAL)).front());
+  ASSERT_EQ(1u, cache->non_temporal_invalidations[0]);
+  ASSERT_EQ(1u, cache->non_temporal_invalidations[1]);
+  ASSERT_EQ(1u, cache->non_temporal_invalidations[2]);
+  ASSERT_EQ(1u, cache->level_counters[2].write_backs);
+  for (uint8_t i = 0; i < 3; i++) {
+    ASSERT_EQ(1u, cache->level_counters[i].evictions[EVICTION_FLUSH]);
+  }
+  ASSERT_EQ(2u, cache->level_counters[2].back_invalidations);
+  // The store covered the whole line, so it was flushed immediately.
+  ASSERT_EQ(1u, cache->write_combining_flushes);
+  ASSERT_EQ(0u, cache->write_combining_partial_flushes);
+  ASSERT_EQ(4u, cache->write_combining_bytes);
+  cache->Access(0, 4);
+  ASSERT_EQ(2u, cache->misses);
+}
+
+TEST_F(AccessHintTest, WriteCombining) {
+  cache->SetWriteCombiningBuffers(1);
+  cache->Access(Record(0, 1, ACCESS_STORE, HINT_NON_TEMPORAL));
+  cache->Access(Record(1, 1, ACCESS_STORE, HINT_NON_TEMPORAL));
+  ASSERT_EQ(0u, cache->write_combining_flushes);
+  cache->Access(Record(4, 1, ACCESS_STORE, HINT_NON_TEMPORAL));
+  ASSERT_EQ(1u, cache->write_combining_flushes);
+  ASSERT_EQ(1u, cache->write_combining_partial_flushes);
+  ASSERT_EQ(2u, cache->write_combining_bytes);
+  // A regular access to a buffered line flushes it.
+  cache->Access(4, 1);
+  ASSERT_EQ(2u, cache->write_combining_flushes);
+  cache->Access(Record(8, 1, ACCESS_STORE, HINT_NON_TEMPORAL));
+  cache->FlushWriteCombiningBuffers();
+  ASSERT_EQ(3u, cache->write_combining_flushes);
+  ASSERT_EQ(3u, cache->write_combining_partial_flushes);
+  ASSERT_EQ(4u, cache->write_combining_bytes);
+}
+
+class SplitL1Test: public ::testing::Test {
+protected:
+  static const uint8_t L1D = 0, L2 = 1, L1I = 2;
+  MultilevelCache* cache;
+
+  virtual void SetUp() {
+    std::vector<uint64_t> capacities_B;
+    std::vector<uint16_t> associativities;
+    capacities_B.push_back(4);
+    capacities_B.push_back(16);
+    associativities.push_back(1);
+    associativities.push_back(4);
+    cache = new MultilevelCache(capacities_B, associativities, 4, 1, 4);
+  }
+
+  virtual void TearDown() {
+    delete cache;
+  }
+};
+
+TEST_F(SplitL1Test, CacheNames) {
+  ASSERT_EQ(3u, cache->GetCacheCount());
+  ASSERT_EQ("L1D", cache->GetCacheName(L1D));
+  ASSERT_EQ("L2", cache->GetCacheName(L2));
+  ASSERT_EQ("L1I", cache->GetCacheName(L1I));
+  ASSERT_EQ(0u, cache->GetCacheLevel(L1I));
+}
+
+TEST_F(SplitL1Test, InstructionFetchesUseL1I) {
+  CacheLine* line = cache->Access(0, 4, ACCESS_IFETCH).front();
+  ASSERT_EQ((1u << L1I) | (1u << L2), line->GetLevels());
+  cache->Access(0, 4);
+  ASSERT_EQ(1u, cache->level_counters[L2].hits);
+  ASSERT_EQ((1u << L1I) | (1u << L2) | (1u << L1D), line->GetLevels());
+  cache->Access(0, 4, ACCESS_IFETCH);
+  ASSERT_EQ(1u, cache->level_counters[L1I].hits);
+}
+
+TEST_F(SplitL1Test, FetchBlock) {
+  cache->FetchBlock(2, 10);
+  // The block touches three lines.
+  ASSERT_EQ(3u, cache->misses);
+  ASSERT_EQ(0u, cache->hits);
+  cache->FetchBlock(8, 4);
+  ASSERT_EQ(1u, cache->level_counters[L1I].hits);
+  cache->FetchBlock(0, 16);
+  ASSERT_EQ(4u, cache->misses);
+  ASSERT_EQ(4u, cache->hits);
+}
+
+TEST_F(SplitL1Test, SharedL2BackInvalidatesBothL1s) {
+  cache->Access(0, 4, ACCESS_IFETCH);
+  cache->Access(4, 4, ACCESS_STORE);
+  cache->Access(8, 4);
+  cache->Access(12, 4);
+  cache->Access(16, 4);
+  ASSERT_EQ(1u, cache->inclusion_victims[L1I]);
+  ASSERT_EQ(0u, cache->inclusion_victims[L1D]);
+  cache->Access(20, 4, ACCESS_IFETCH);
+  ASSERT_EQ(0u, cache->inclusion_victims[L1D]);
+  ASSERT_EQ(1u, cache->level_counters[L1D].write_backs);
+  ASSERT_EQ(1u, cache->level_counters[L2].write_backs);
+}
+
+TEST_F(SplitL1Test, Report) {
+  cache->Access(0, 4, ACCESS_IFETCH);
+  std::ostringstream report;
+  report << *cache;
+  ASSERT_NE(std::string::npos, report.str().find("L1I"));
+  ASSERT_NE(std::string::npos, report.str().find("Misses: 1"));
+}
+
+class MulticoreTest: public ::testing::Test {
+protected:
+  static const uint8_t N_CORES = 2;
+  // Core 0 holds indexes 0 to 2, core 1's private caches follow the LLC.
+  static const uint8_t C0_L1 = 0, C0_L2 = 1, LLC = 2, C1_L1 = 3, C1_L2 = 4;
+  MultilevelCache* cache;
+
+  virtual void SetUp() {
+    std::vector<uint64_t> capacities_B;
+    std::vector<uint16_t> associativities;
+    capacities_B.push_back(4);
+    capacities_B.push_back(8);
+    capacities_B.push_back(16);
+    associativities.push_back(1);
+    associativities.push_back(2);
+    associativities.push_back(4);
+    cache = new MultilevelCache(N_CORES, capacities_B, associativities, 4);
+  }
+
+  virtual void TearDown() {
+    delete cache;
+  }
+};
+
+TEST_F(MulticoreTest, Topology) {
+  ASSERT_EQ(5u, cache->GetCacheCount());
+  ASSERT_EQ("C0.L1", cache->GetCacheName(C0_L1));
+  ASSERT_EQ("C0.L2", cache->GetCacheName(C0_L2));
+  ASSERT_EQ("L3", cache->GetCacheName(LLC));
+  ASSERT_EQ("C1.L1", cache->GetCacheName(C1_L1));
+  ASSERT_EQ("C1.L2", cache->GetCacheName(C1_L2));
+}
+
+TEST_F(MulticoreTest, SharedLLC) {
+  CacheLine* line = cache->Access(AccessRecord(0, 4, ACCESS_LOAD, HINT_NONE,
+      0)).front();
+  ASSERT_EQ((1u << C0_L1) | (1u << C0_L2) | (1u << LLC), line->GetLevels());
+  cache->Access(AccessRecord(0, 4, ACCESS_LOAD, HINT_NONE, 1));
+  // Core 1 found the line in the shared LLC.
+  ASSERT_EQ(1u, cache->level_counters[LLC].hits);
+  ASSERT_EQ(0x1fu, line->GetLevels());
+  ASSERT_EQ(1u, cache->core_misses[0]);
+  ASSERT_EQ(1u, cache->core_hits[1]);
+}
+
+TEST_F(MulticoreTest, LevelUtilizationPerCore) {
+  cache->Access(AccessRecord(0, 1, ACCESS_LOAD, HINT_NONE, 0));
+  cache->Access(AccessRecord(1, 1, ACCESS_LOAD, HINT_NONE, 1));
+  cache->Access(AccessRecord(2, 1, ACCESS_LOAD, HINT_NONE, 0));
+  cache->Finalize();
+  // Each core's caches count the bytes of that core, the LLC those of both.
+  ASSERT_EQ(2u, cache->level_counters[C0_L1].resident_used_bytes);
+  ASSERT_EQ(2u, cache->level_counters[C0_L2].resident_used_bytes);
+  ASSERT_EQ(3u, cache->level_counters[LLC].resident_used_bytes);
+  ASSERT_EQ(1u, cache->level_counters[C1_L1].resident_used_bytes);
+  ASSERT_EQ(1u, cache->level_counters[C1_L2].resident_used_bytes);
+}
+
+TEST_F(MulticoreTest, LLCEvictionInvalidatesEveryCore) {
+  cache->Access(AccessRecord(0, 4, ACCESS_LOAD, HINT_NONE, 0));
+  cache->Access(AccessRecord(0, 4, ACCESS_LOAD, HINT_NONE, 1));
+  // Core 1 streams through the LLC while core 0 keeps 0 in its L1.
+  for (ADDRESS address = 4; address <= 16; address += 4) {
+    cache->Access(AccessRecord(address, 4, ACCESS_LOAD, HINT_NONE, 1));
+  }
+  ASSERT_EQ(1u, cache->inclusion_victims[C0_L1]);
+  ASSERT_EQ(1u, cache->inclusion_victims[C0_L2]);
+  // Core 1's own L2 had already evicted it.
+  ASSERT_EQ(0u, cache->inclusion_victims[C1_L1]);
+  ASSERT_EQ(0u, cache->inclusion_victims[C1_L2]);
+}
+
+TEST_F(MulticoreTest, SimulateMergedTrace) {
+  std::vector<AccessRecord> thread0, thread1;
+  for (uint64_t i = 0; i < 4; i++) {
+    thread0.push_back(AccessRecord(0, 4, ACCESS_LOAD, HINT_NONE, 0, 2 * i));
+    thread1.push_back(AccessRecord(0, 4, ACCESS_LOAD, HINT_NONE, 1, 2 * i + 1));
+  }
+  VectorAccessStream stream0(thread0), stream1(thread1);
+  std::vector<AccessStream*> streams;
+  streams.push_back(&stream0);
+  streams.push_back(&stream1);
+  TraceMerger merger(streams, MERGE_BY_TIMESTAMP);
+  ASSERT_EQ(8u, cache->Simulate(merger));
+  ASSERT_EQ(1u, cache->misses);
+  ASSERT_EQ(3u, cache->level_counters[C0_L1].hits);
+  ASSERT_EQ(3u, cache->level_counters[C1_L1].hits);
+}
+
+TEST_F(MulticoreTest, CoherenceReadSharing) {
+  CacheLine* line = cache->Access(AccessRecord(0, 4, ACCESS_LOAD, HINT_NONE,
+      0)).front();
+  ASSERT_EQ(COHERENCE_EXCLUSIVE, line->GetCoherenceState(0));
+  ASSERT_EQ(COHERENCE_INVALID, line->GetCoherenceState(1));
+  cache->Access(AccessRecord(0, 4, ACCESS_LOAD, HINT_NONE, 1));
+  ASSERT_EQ(COHERENCE_SHARED, line->GetCoherenceState(0));
+  ASSERT_EQ(COHERENCE_SHARED, line->GetCoherenceState(1));
+  ASSERT_EQ(3u, line->GetSharers());
+  // A clean exclusive copy is downgraded without a transfer.
+  ASSERT_EQ(1u, cache->core_downgrades[0]);
+  ASSERT_EQ(0u, cache->cache_to_cache_transfers[1]);
+  ASSERT_EQ(0u, cache->core_invalidations[0]);
+}
+
+TEST_F(MulticoreTest, CoherenceModifiedTransfer) {
+  CacheLine* line = cache->Access(AccessRecord(0, 4, ACCESS_STORE, HINT_NONE,
+      0)).front();
+  ASSERT_EQ(COHERENCE_MODIFIED, line->GetCoherenceState(0));
+  cache->Access(AccessRecord(0, 4, ACCESS_LOAD, HINT_NONE, 1));
+  ASSERT_EQ(COHERENCE_SHARED, line->GetCoherenceState(0));
+  ASSERT_EQ(1u, cache->cache_to_cache_transfers[1]);
+  ASSERT_EQ(1u, cache->core_downgrades[0]);
+  // The owner wrote its modified copy back to the LLC.
+  ASSERT_EQ(1u, cache->level_counters[C0_L1].write_backs);
+  ASSERT_EQ(1u, cache->level_counters[C0_L2].write_backs);
+  ASSERT_EQ(4u, line->CountDirtyBytes(LLC));
+}
+
+TEST_F(MulticoreTest, CoherenceUpgradeInvalidates) {
+  CacheLine* line = cache->Access(AccessRecord(0, 4, ACCESS_LOAD, HINT_NONE,
+      0)).front();
+  cache->Access(AccessRecord(0, 4, ACCESS_LOAD, HINT_NONE, 1));
+  cache->Access(AccessRecord(0, 4, ACCESS_STORE, HINT_NONE, 0));
+  ASSERT_EQ(COHERENCE_MODIFIED, line->GetCoherenceState(0));
+  ASSERT_EQ(COHERENCE_INVALID, line->GetCoherenceState(1));
+  ASSERT_EQ(1u, cache->core_upgrades[0]);
+  ASSERT_EQ(1u, cache->core_invalidations[1]);
+  ASSERT_EQ(1u, cache->coherence_invalidations[C1_L1]);
+  ASSERT_EQ(1u, cache->coherence_invalidations[C1_L2]);
+  ASSERT_EQ(1u, cache->level_counters[C1_L2].evictions[EVICTION_COHERENCE]);
+  ASSERT_EQ((1u << C0_L1) | (1u << C0_L2) | (1u << LLC), line->GetLevels());
+
+  // Core 1 lost its copy to the store, not to capacity.
+  cache->Access(AccessRecord(0, 4, ACCESS_LOAD, HINT_NONE, 1));
+  ASSERT_EQ(2u, cache->private_misses[1]);
+  ASSERT_EQ(1u, cache->coherence_misses[1]);
+  ASSERT_EQ(1u, cache->cache_to_cache_transfers[1]);
+}
+
+TEST_F(MulticoreTest, CoherencePingPong) {
+  // Two cores incrementing a shared counter.
+  for (int i = 0; i < 4; i++) {
+    cache->Access(AccessRecord(0, 4, ACCESS_RMW, HINT_NONE, 0));
+    cache->Access(AccessRecord(0, 4, ACCESS_RMW, HINT_NONE, 1));
+  }
+  ASSERT_EQ(1u, cache->misses);
+  ASSERT_EQ(3u, cache->coherence_misses[0]);
+  ASSERT_EQ(3u, cache->coherence_misses[1]);
+  ASSERT_EQ(4u, cache->core_invalidations[0]);
+  ASSERT_EQ(3u, cache->core_invalidations[1]);
+  ASSERT_EQ(7u, cache->cache_to_cache_transfers[0]
+      + cache->cache_to_cache_transfers[1]);
+}
+
+TEST_F(MulticoreTest, CoherenceEvictionLeavesDirectory) {
+  CacheLine* line = cache->Access(AccessRecord(0, 4, ACCESS_STORE, HINT_NONE,
+      0)).front();
+  // Core 0 evicts the line from its private caches.
+  cache->Access(AccessRecord(8, 4, ACCESS_LOAD, HINT_NONE, 0));
+  cache->Access(AccessRecord(16, 4, ACCESS_LOAD, HINT_NONE, 0));
+  cache->Access(AccessRecord(24, 4, ACCESS_LOAD, HINT_NONE, 0));
+  ASSERT_EQ(COHERENCE_INVALID, line->GetCoherenceState(0));
+  ASSERT_EQ(0u, line->GetSharers());
+  cache->Access(AccessRecord(0, 4, ACCESS_LOAD, HINT_NONE, 1));
+  ASSERT_EQ(COHERENCE_EXCLUSIVE, line->GetCoherenceState(1));
+  ASSERT_EQ(0u, cache->cache_to_cache_transfers[1]);
+  ASSERT_EQ(0u, cache->coherence_misses[1]);
+}
+
+TEST(MulticoreSplitTest, Topology) {
+  std::vector<uint64_t> capacities_B;
+  std::vector<uint16_t> associativities;
+  capacities_B.push_back(4);
+  capacities_B.push_back(16);
+  associativities.push_back(1);
+  associativities.push_back(4);
+  MultilevelCache cache(2, capacities_B, associativities, 4, 1, 4);
+  ASSERT_EQ(5u, cache.GetCacheCount());
+  ASSERT_EQ("C0.L1D", cache.GetCacheName(0));
+  ASSERT_EQ("L2", cache.GetCacheName(1));
+  ASSERT_EQ("C1.L1D", cache.GetCacheName(2));
+  ASSERT_EQ("C0.L1I", cache.GetCacheName(3));
+  ASSERT_EQ("C1.L1I", cache.GetCacheName(4));
+  CacheLine* line = cache.Access(AccessRecord(0, 4, ACCESS_IFETCH, HINT_NONE,
+      1)).front();
+  ASSERT_EQ((1u << 1) | (1u << 4), line->GetLevels());
+}
+
 }
@@ -0,0 +1,124 @@
+/*
+ * PcAttributionTest.cpp
+ *
+ *  Created on: Sep 16, 2016
+ *      Author: vance
+ */
+
+#include "../src/ConcurrentMultilevelCache.h"
+#include "../src/MultilevelCache.h"
+#include "../src/PcAttribution.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+class PcAttributionTest: public ::testing::Test {
+protected:
+  static const uint16_t LINE_SIZE_B = 64;
+
+  static AccessRecord Load(const ADDRESS address, const uint8_t size,
+      const ADDRESS pc) {
+    return AccessRecord(address, size, ACCESS_LOAD, HINT_NONE, 0, 0, pc);
+  }
+};
+
+TEST_F(PcAttributionTest, Charges) {
+  PcAttribution attribution(LINE_SIZE_B);
+  attribution.Miss(0x400000);
+  attribution.Miss(0x400000);
+  attribution.Miss(0x400010);
+  attribution.Evict(0x400000, 8);
+  attribution.Evict(0x400010, 64);
+  attribution.Evict(0x400010, 60);
+  ASSERT_EQ(2u, attribution.Get(0x400000).misses);
+  ASSERT_EQ(56u, attribution.Get(0x400000).wasted_bytes);
+  ASSERT_EQ(2u, attribution.Get(0x400010).evictions);
+  ASSERT_EQ(4u, attribution.Get(0x400010).wasted_bytes);
+  ASSERT_EQ(0u, attribution.Get(0x400020).misses);
+
+  std::vector<PcCounts> top = attribution.GetTopMisses(1);
+  ASSERT_EQ(1u, top.size());
+  ASSERT_EQ(0x400000u, top[0].pc);
+  top = attribution.GetTopWastedBytes(10);
+  ASSERT_EQ(2u, top.size());
+  ASSERT_EQ(0x400000u, top[0].pc);
+  ASSERT_EQ(0x400010u, top[1].pc);
+}
+
+TEST_F(PcAttributionTest, Bounded) {
+  PcAttribution attribution(LINE_SIZE_B, 4);
+  for (ADDRESS pc = 1; pc <= 5; pc++) {
+    attribution.Miss(pc);
+  }
+  // Three quarters of the table are tracked.
+  ASSERT_EQ(1u, attribution.Get(3).misses);
+  ASSERT_EQ(0u, attribution.Get(4).misses);
+  ASSERT_EQ(2u, attribution.untracked.misses);
+  // Tracked instructions are still charged.
+  attribution.Miss(1);
+  ASSERT_EQ(2u, attribution.Get(1).misses);
+  ASSERT_EQ(4u * sizeof(PcCounts), attribution.GetStorageBytes());
+  ASSERT_THROW(PcAttribution(LINE_SIZE_B, 6), std::invalid_argument);
+  ASSERT_THROW(PcAttribution(LINE_SIZE_B, 2), std::invalid_argument);
+}
+
+TEST_F(PcAttributionTest, Merge) {
+  PcAttribution a(LINE_SIZE_B);
+  PcAttribution b(LINE_SIZE_B);
+  a.Miss(0x10);
+  b.Miss(0x10);
+  b.Evict(0x20, 32);
+  a.Merge(b);
+  ASSERT_EQ(2u, a.Get(0x10).misses);
+  ASSERT_EQ(32u, a.Get(0x20).wasted_bytes);
+  ASSERT_THROW(a.Merge(PcAttribution(32)), std::invalid_argument);
+}
+
+TEST_F(PcAttributionTest, Hierarchy) {
+  std::vector<uint64_t> capacities_B;
+  std::vector<uint16_t> associativities;
+  capacities_B.push_back(LINE_SIZE_B);
+  associativities.push_back(1);
+  MultilevelCache cache(capacities_B, associativities, LINE_SIZE_B);
+  PcAttribution attribution(LINE_SIZE_B);
+  cache.SetPcAttribution(&attribution);
+  cache.Access(Load(0, 4, 0x10));
+  // A hit is not charged, but its bytes are used.
+  cache.Access(Load(4, 4, 0x30));
+  // Evicts line 0, which 0x10 filled.
+  cache.Access(Load(LINE_SIZE_B, 1, 0x20));
+  ASSERT_EQ(1u, attribution.Get(0x10).misses);
+  ASSERT_EQ(1u, attribution.Get(0x10).evictions);
+  ASSERT_EQ(56u, attribution.Get(0x10).wasted_bytes);
+  ASSERT_EQ(1u, attribution.Get(0x20).misses);
+  ASSERT_EQ(0u, attribution.Get(0x20).evictions);
+  ASSERT_EQ(0u, attribution.Get(0x30).misses);
+  // The line filled by 0x20 is charged as resident when finalized.
+  cache.Finalize();
+  ASSERT_EQ(1u, attribution.Get(0x20).resident);
+  ASSERT_EQ(63u, attribution.Get(0x20).resident_wasted_bytes);
+  ASSERT_EQ(0u, attribution.Get(0x20).wasted_bytes);
+  ASSERT_EQ(0u, attribution.Get(0x10).resident);
+  ASSERT_EQ(0x20u, attribution.GetTopWastedBytes(1).at(0).pc);
+  cache.SetPcAttribution(NULL);
+}
+
+TEST_F(PcAttributionTest, Shards) {
+  std::vector<uint64_t> capacities_B;
+  std::vector<uint16_t> associativities;
+  capacities_B.push_back(4 * LINE_SIZE_B);
+  capacities_B.push_back(8 * LINE_SIZE_B);
+  associativities.push_back(1);
+  associativities.push_back(2);
+  ConcurrentMultilevelCache cache(1, capacities_B, associativities,
+      LINE_SIZE_B);
+  cache.EnablePcAttribution(16);
+  // The lines fall in different shards.
+  for (ADDRESS line = 0; line < 4; line++) {
+    cache.Access(Load(line * LINE_SIZE_B, 8, 0x10));
+  }
+  ASSERT_EQ(4u, cache.MergePcAttribution().Get(0x10).misses);
+}
+
+}
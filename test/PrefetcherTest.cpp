@@ -0,0 +1,326 @@
+/*
+ * PrefetcherTest.cpp
+ *
+ *  Created on: Sep 9, 2016
+ *      Author: vance
+ */
+
+#include "../src/MarkovPrefetcher.h"
+#include "../src/MultilevelCache.h"
+#include "../src/NextLinePrefetcher.h"
+#include "../src/SpatialPrefetcher.h"
+#include "../src/StreamPrefetcher.h"
+#include "../src/StridePrefetcher.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+TEST(NextLinePrefetcherTest, Train) {
+  NextLinePrefetcher prefetcher(64, 2);
+  std::vector<ADDRESS> prefetches;
+  prefetcher.Train(0x104, 0, false, prefetches);
+  ASSERT_TRUE(prefetches.empty());
+  prefetcher.Train(0x104, 0, true, prefetches);
+  ASSERT_EQ(2u, prefetches.size());
+  ASSERT_EQ(0x140u, prefetches[0]);
+  ASSERT_EQ(0x180u, prefetches[1]);
+  prefetches.clear();
+  // Nothing follows the last line.
+  prefetcher.Train(0xFFFFFFC0, 0, true, prefetches);
+  ASSERT_TRUE(prefetches.empty());
+}
+
+TEST(StridePrefetcherTest, Train) {
+  StridePrefetcher prefetcher(64, 2, 1, 16);
+  std::vector<ADDRESS> prefetches;
+  for (ADDRESS address = 0; address < 768; address += 256) {
+    prefetcher.Train(address, 0x400, true, prefetches);
+    // Accesses of unknown instructions do not train the table.
+    prefetcher.Train(address + 4096, 0, true, prefetches);
+    ASSERT_TRUE(prefetches.empty());
+  }
+  prefetcher.Train(768, 0x400, false, prefetches);
+  ASSERT_EQ(2u, prefetches.size());
+  ASSERT_EQ(1024u, prefetches[0]);
+  ASSERT_EQ(1280u, prefetches[1]);
+  prefetches.clear();
+
+  // A stride shorter than a line asks for each line once.
+  for (ADDRESS address = 0; address < 32; address += 8) {
+    prefetcher.Train(address, 0x404, true, prefetches);
+  }
+  prefetcher.Train(32, 0x404, true, prefetches);
+  ASSERT_TRUE(prefetches.empty());
+  prefetcher.Train(56, 0x404, true, prefetches);
+  ASSERT_EQ(1u, prefetches.size());
+  ASSERT_EQ(64u, prefetches[0]);
+}
+
+TEST(StreamPrefetcherTest, Train) {
+  StreamPrefetcher prefetcher(64, 2, 4, 2);
+  std::vector<ADDRESS> prefetches;
+  // A hit does not start a stream.
+  prefetcher.Train(10 * 64, 0, false, prefetches);
+  prefetcher.Train(11 * 64, 0, false, prefetches);
+  ASSERT_TRUE(prefetches.empty());
+
+  prefetcher.Train(10 * 64, 0, true, prefetches);
+  ASSERT_TRUE(prefetches.empty());
+  prefetcher.Train(11 * 64, 0, true, prefetches);
+  ASSERT_EQ(2u, prefetches.size());
+  ASSERT_EQ(12u * 64, prefetches[0]);
+  ASSERT_EQ(13u * 64, prefetches[1]);
+  prefetches.clear();
+  prefetcher.Train(12 * 64, 0, false, prefetches);
+  prefetcher.Train(13 * 64, 0, false, prefetches);
+  ASSERT_EQ(4u, prefetches.size());
+  ASSERT_EQ(17u * 64, prefetches[3]);
+  prefetches.clear();
+  // The prefetches stay within distance lines of the stream.
+  prefetcher.Train(14 * 64, 0, false, prefetches);
+  ASSERT_EQ(1u, prefetches.size());
+  ASSERT_EQ(18u * 64, prefetches[0]);
+  prefetches.clear();
+
+  // Descending streams too.
+  prefetcher.Train(100 * 64, 0, true, prefetches);
+  prefetcher.Train(99 * 64, 0, true, prefetches);
+  ASSERT_EQ(2u, prefetches.size());
+  ASSERT_EQ(98u * 64, prefetches[0]);
+  ASSERT_EQ(97u * 64, prefetches[1]);
+}
+
+TEST(SpatialPrefetcherTest, Footprint) {
+  SpatialPrefetcher prefetcher(64, 512, 2, 17);
+  std::vector<ADDRESS> prefetches;
+  prefetcher.Train(0x1000 + 1 * 64, 0x40, true, prefetches);
+  prefetcher.Train(0x1000 + 3 * 64, 0x44, true, prefetches);
+  prefetcher.Train(0x1000 + 5 * 64, 0x48, false, prefetches);
+  ASSERT_TRUE(prefetches.empty());
+  // A line of the footprint leaves the cache: the generation ends.
+  prefetcher.Evict(0x1000 + 3 * 64);
+
+  // The same trigger in another region prefetches the rest of the footprint.
+  prefetcher.Train(0x2000 + 1 * 64, 0x40, true, prefetches);
+  ASSERT_EQ(2u, prefetches.size());
+  ASSERT_EQ(0x2000u + 3 * 64, prefetches[0]);
+  ASSERT_EQ(0x2000u + 5 * 64, prefetches[1]);
+  prefetches.clear();
+  prefetcher.Train(0x2000 + 3 * 64, 0x44, false, prefetches);
+  prefetcher.Train(0x2000 + 6 * 64, 0x4C, true, prefetches);
+  ASSERT_TRUE(prefetches.empty());
+  // Lines outside the footprint do not end the generation.
+  prefetcher.Evict(0x2000);
+  ASSERT_EQ(0u, prefetcher.predicted_lines);
+  prefetcher.Evict(0x2000 + 6 * 64);
+  ASSERT_EQ(1u, prefetcher.n_predictions);
+  ASSERT_EQ(2u, prefetcher.predicted_lines);
+  ASSERT_EQ(1u, prefetcher.covered_lines);
+  ASSERT_EQ(1u, prefetcher.uncovered_lines);
+  ASSERT_EQ(1u, prefetcher.footprint_utilizations[0]);
+  ASSERT_DOUBLE_EQ(0.5, prefetcher.GetAccuracy());
+  ASSERT_DOUBLE_EQ(0.5, prefetcher.GetCoverage());
+
+  // A trigger is its pc and its offset in the region.
+  prefetcher.Train(0x3000 + 1 * 64, 0x50, true, prefetches);
+  prefetcher.Train(0x4000 + 2 * 64, 0x40, true, prefetches);
+  ASSERT_TRUE(prefetches.empty());
+  // Replacing a generation ends it. The last footprint replaced the first.
+  prefetcher.Train(0x5000 + 1 * 64, 0x40, true, prefetches);
+  ASSERT_EQ(2u, prefetches.size());
+  ASSERT_EQ(0x5000u + 3 * 64, prefetches[0]);
+  ASSERT_EQ(0x5000u + 6 * 64, prefetches[1]);
+}
+
+TEST(SpatialPrefetcherTest, InvalidArguments) {
+  ASSERT_THROW(SpatialPrefetcher(64, 32), std::invalid_argument);
+  ASSERT_THROW(SpatialPrefetcher(64, 192), std::invalid_argument);
+  ASSERT_THROW(SpatialPrefetcher(64, 512, 0), std::invalid_argument);
+}
+
+TEST(SpatialPrefetcherTest, MultilevelCache) {
+  std::vector<uint64_t> capacities_B;
+  std::vector<uint16_t> associativities;
+  capacities_B.push_back(1024);
+  capacities_B.push_back(4096);
+  capacities_B.push_back(16384);
+  associativities.push_back(1);
+  associativities.push_back(4);
+  associativities.push_back(8);
+  MultilevelCache cache(capacities_B, associativities, 64);
+  SpatialPrefetcher prefetcher(64, 512);
+  cache.AddPrefetcher(0, &prefetcher);
+  cache.SetPrefetchLatency(0);
+  // Visit lines 0, 2 and 5 of three regions of 8 lines, from the same
+  // instructions. The third evicts the first from the L1 as it starts.
+  for (ADDRESS region = 0; region < 3; region++) {
+    cache.Access(AccessRecord(region * 512 + 0 * 64, 4, ACCESS_LOAD,
+        HINT_NONE, 0, 0, 0x40));
+    cache.Access(AccessRecord(region * 512 + 2 * 64, 4, ACCESS_LOAD,
+        HINT_NONE, 0, 0, 0x44));
+    cache.Access(AccessRecord(region * 512 + 5 * 64, 4, ACCESS_LOAD,
+        HINT_NONE, 0, 0, 0x48));
+  }
+  ASSERT_EQ(1u, prefetcher.n_predictions);
+  ASSERT_EQ(2u, cache.prefetches[0]);
+  ASSERT_EQ(2u, cache.useful_prefetches[0]);
+  ASSERT_EQ(7u, cache.misses);
+}
+
+TEST(MarkovPrefetcherTest, Train) {
+  MarkovPrefetcher prefetcher(64, 16, 2, 2);
+  std::vector<ADDRESS> prefetches;
+  prefetcher.Train(0x10 * 64, 0, true, prefetches);
+  prefetcher.Train(0x07 * 64, 0, true, prefetches);
+  prefetcher.Train(0x23 * 64, 0, true, prefetches);
+  // Hits do not train the table.
+  prefetcher.Train(0x30 * 64, 0, false, prefetches);
+  ASSERT_TRUE(prefetches.empty());
+  prefetcher.Train(0x10 * 64 + 8, 0, true, prefetches);
+  ASSERT_EQ(1u, prefetches.size());
+  ASSERT_EQ(0x07u * 64, prefetches[0]);
+  prefetches.clear();
+  // The most recent successor comes first.
+  prefetcher.Train(0x50 * 64, 0, true, prefetches);
+  prefetcher.Train(0x10 * 64, 0, true, prefetches);
+  ASSERT_EQ(2u, prefetches.size());
+  ASSERT_EQ(0x50u * 64, prefetches[0]);
+  ASSERT_EQ(0x07u * 64, prefetches[1]);
+  ASSERT_EQ(6u, prefetcher.n_lookups);
+  ASSERT_EQ(2u, prefetcher.n_table_hits);
+}
+
+TEST(MarkovPrefetcherTest, Replacement) {
+  MarkovPrefetcher prefetcher(64, 16, 2, 1);
+  std::vector<ADDRESS> prefetches;
+  // Lines 0, 8 and 16 map to the same set of two ways.
+  const ADDRESS lines[] = { 0, 1, 8, 1, 16, 1 };
+  for (size_t i = 0; i < 6; i++) {
+    prefetcher.Train(lines[i] * 64, 0, true, prefetches);
+  }
+  prefetches.clear();
+  prefetcher.Train(8 * 64, 0, true, prefetches);
+  ASSERT_EQ(1u, prefetches.size());
+  ASSERT_EQ(64u, prefetches[0]);
+  prefetches.clear();
+  // The least recently used line was replaced.
+  prefetcher.Train(0, 0, true, prefetches);
+  ASSERT_TRUE(prefetches.empty());
+}
+
+TEST(MarkovPrefetcherTest, Depth) {
+  MarkovPrefetcher prefetcher(64, 16, 2, 1, 3);
+  std::vector<ADDRESS> prefetches;
+  const ADDRESS lines[] = { 0x10, 0x07, 0x23, 0x42 };
+  for (size_t i = 0; i < 4; i++) {
+    prefetcher.Train(lines[i] * 64, 0, true, prefetches);
+  }
+  prefetcher.Train(0x10 * 64, 0, true, prefetches);
+  ASSERT_EQ(3u, prefetches.size());
+  ASSERT_EQ(0x07u * 64, prefetches[0]);
+  ASSERT_EQ(0x23u * 64, prefetches[1]);
+  ASSERT_EQ(0x42u * 64, prefetches[2]);
+}
+
+TEST(MarkovPrefetcherTest, Storage) {
+  // 16 entries of a valid bit, a 23 bit tag, an LRU bit, a 2 bit count and
+  // two 26 bit successors.
+  ASSERT_EQ(158u, MarkovPrefetcher(64, 16, 2, 2).GetStorageBytes());
+  ASSERT_EQ(0u, NextLinePrefetcher(64).GetStorageBytes());
+  ASSERT_THROW(MarkovPrefetcher(64, 24, 8), std::invalid_argument);
+  ASSERT_THROW(MarkovPrefetcher(64, 16, 2, 0), std::invalid_argument);
+}
+
+TEST(MarkovPrefetcherTest, PointerChase) {
+  std::vector<uint64_t> capacities_B;
+  std::vector<uint16_t> associativities;
+  capacities_B.push_back(128);
+  capacities_B.push_back(256);
+  capacities_B.push_back(512);
+  associativities.push_back(1);
+  associativities.push_back(2);
+  associativities.push_back(4);
+  MultilevelCache cache(capacities_B, associativities, 64);
+  MarkovPrefetcher prefetcher(64, 64, 4, 1);
+  cache.AddPrefetcher(2, &prefetcher);
+  cache.SetPrefetchLatency(0);
+  // Chase a chain of 32 scattered lines, larger than the LLC, three times.
+  for (uint32_t pass = 0; pass < 3; pass++) {
+    for (ADDRESS node = 0; node < 32; node++) {
+      cache.Access(AccessRecord((node * 37 % 64) * 64, 8));
+    }
+  }
+  ASSERT_EQ(32u + 1, cache.misses);
+  ASSERT_EQ(63u, cache.useful_prefetches[2]);
+  ASSERT_EQ(0u, cache.useless_prefetches[2]);
+}
+
+class PrefetchTest: public ::testing::Test {
+protected:
+  MultilevelCache* cache;
+  NextLinePrefetcher* prefetcher;
+
+  virtual void SetUp() {
+    std::vector<uint64_t> capacities_B;
+    std::vector<uint16_t> associativities;
+    capacities_B.push_back(128);
+    capacities_B.push_back(256);
+    capacities_B.push_back(512);
+    associativities.push_back(1);
+    associativities.push_back(2);
+    associativities.push_back(4);
+    cache = new MultilevelCache(capacities_B, associativities, 64);
+    prefetcher = new NextLinePrefetcher(64);
+    cache->AddPrefetcher(0, prefetcher);
+  }
+
+  virtual void TearDown() {
+    delete cache;
+    delete prefetcher;
+  }
+};
+
+TEST_F(PrefetchTest, Coverage) {
+  cache->SetPrefetchLatency(0);
+  for (ADDRESS line = 0; line < 16; line++) {
+    cache->Access(AccessRecord(line * 64, 4));
+  }
+  // Each use of a prefetched line prefetches the next one.
+  ASSERT_EQ(1u, cache->misses);
+  ASSERT_EQ(1u, cache->level_counters[0].misses);
+  ASSERT_EQ(15u, cache->prefetches[0]);
+  ASSERT_EQ(15u, cache->useful_prefetches[0]);
+  ASSERT_EQ(0u, cache->late_prefetches[0]);
+  ASSERT_EQ(0u, cache->useless_prefetches[0]);
+  // The LLC holds 8 lines: the first 8 were evicted, and only the first was
+  // filled on demand.
+  ASSERT_EQ(1u, cache->byte_utilizations[3]);
+  ASSERT_EQ(7u, cache->prefetched_byte_utilizations[3]);
+}
+
+TEST_F(PrefetchTest, Late) {
+  for (ADDRESS line = 0; line < 16; line++) {
+    cache->Access(AccessRecord(line * 64, 4));
+  }
+  // The next line is always used before its prefetch arrives.
+  ASSERT_EQ(15u, cache->useful_prefetches[0]);
+  ASSERT_EQ(15u, cache->late_prefetches[0]);
+}
+
+TEST_F(PrefetchTest, Pollution) {
+  cache->Access(AccessRecord(0, 4));
+  // Line 1 is prefetched into set 1 of the L1, where line 3 replaces it.
+  cache->Access(AccessRecord(3 * 64, 4));
+  ASSERT_EQ(1u, cache->prefetches[0]);
+  ASSERT_EQ(1u, cache->useless_prefetches[0]);
+  // Line 4 is prefetched into set 0 over line 0, which then misses.
+  cache->Access(AccessRecord(0, 4));
+  ASSERT_EQ(2u, cache->prefetches[0]);
+  ASSERT_EQ(2u, cache->useless_prefetches[0]);
+  ASSERT_EQ(1u, cache->prefetch_pollution[0]);
+  ASSERT_EQ(3u, cache->level_counters[0].misses);
+  ASSERT_EQ(0u, cache->useful_prefetches[0]);
+}
+
+}
@@ -0,0 +1,159 @@
+/*
+ * SimulatorDaemonTest.cpp
+ *
+ *  Created on: Sep 2, 2016
+ *      Author: vance
+ */
+
+#include "../src/SharedCaptureRegion.h"
+#include "../src/SimulatorDaemon.h"
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+const char* const REGION_NAME = "/vcache-test";
+
+SharedRecord Record(const uint64_t address, const AccessType type =
+    ACCESS_LOAD) {
+  SharedRecord record;
+  record.address = address;
+  record.size = 4;
+  record.type = type;
+  record.hints = HINT_NONE;
+  return record;
+}
+
+ConcurrentMultilevelCache* NewCache() {
+  std::vector<uint64_t> capacities_B;
+  std::vector<uint16_t> associativities;
+  capacities_B.push_back(1024);
+  capacities_B.push_back(8192);
+  associativities.push_back(2);
+  associativities.push_back(4);
+  return new ConcurrentMultilevelCache(2, capacities_B, associativities, 64);
+}
+
+TEST(SharedCaptureRegionTest, AttachAndDrop) {
+  SharedCaptureRegion daemon_side(REGION_NAME, 2, 8, 4);
+  SharedCaptureRegion process_side(REGION_NAME);
+  ASSERT_EQ(2u, process_side.GetSlotCount());
+  SharedRing* const ring = process_side.Attach(10, 11);
+  SharedRing* const other = process_side.Attach(10, 12);
+  ASSERT_TRUE(ring != NULL);
+  ASSERT_TRUE(other != NULL);
+  ASSERT_TRUE(process_side.Attach(10, 13) == NULL);
+  ASSERT_EQ(SLOT_ATTACHED, daemon_side.GetState(0));
+  ASSERT_EQ(11u, daemon_side.GetTid(0));
+
+  for (uint64_t address = 0; address < 10; address++) {
+    // The producer never waits: the last two records are dropped.
+    ASSERT_EQ(address < 8, ring->Push(Record(address)));
+  }
+  ASSERT_EQ(2u, daemon_side.GetDroppedCount(0));
+  SharedRecord out[16];
+  ASSERT_EQ(8u, daemon_side.Pop(0, out, 16));
+  for (uint64_t address = 0; address < 8; address++) {
+    ASSERT_EQ(address, out[address].address);
+  }
+
+  process_side.Detach(ring);
+  process_side.Detach(other);
+  ASSERT_EQ(SLOT_DETACHED, daemon_side.GetState(0));
+  daemon_side.Release(0);
+  ASSERT_EQ(SLOT_FREE, daemon_side.GetState(0));
+}
+
+TEST(SharedCaptureRegionTest, NotARegion) {
+  ASSERT_THROW(SharedCaptureRegion("/vcache-test-missing"), std::runtime_error);
+  ASSERT_THROW(SharedCaptureRegion(REGION_NAME, 2, 6), std::invalid_argument);
+}
+
+TEST(SimulatorDaemonTest, SimulatesAndReleases) {
+  SharedCaptureRegion region(REGION_NAME, 4, 1024, 16);
+  ConcurrentMultilevelCache* const cache = NewCache();
+  SimulatorDaemon daemon(region, *cache);
+  SharedRing* const ring = region.Attach(getpid(), 1);
+  for (uint64_t i = 0; i < 100; i++) {
+    ring->Push(Record(0x1000 + i % 16 * 4));
+  }
+  region.Detach(ring);
+  daemon.Start();
+  daemon.Stop();
+
+  ASSERT_EQ(99u, cache->Sum(&MultilevelCache::hits));
+  ASSERT_EQ(1u, cache->Sum(&MultilevelCache::misses));
+  const std::vector<CaptureStats> stats = daemon.GetStats();
+  ASSERT_EQ(1u, stats.size());
+  ASSERT_EQ(100u, stats[0].n_simulated);
+  ASSERT_EQ(0u, stats[0].n_sampled_out);
+  ASSERT_EQ(SLOT_FREE, region.GetState(0));
+  delete cache;
+}
+
+TEST(SimulatorDaemonTest, SamplesWhenBehind) {
+  SharedCaptureRegion region(REGION_NAME, 1, 64, 1);
+  ConcurrentMultilevelCache* const cache = NewCache();
+  SimulatorDaemon daemon(region, *cache, 1, false, SAMPLING_SETS, 4);
+  SharedRing* const ring = region.Attach(getpid(), 1);
+  for (uint64_t i = 0; i < 65; i++) {
+    ring->Push(Record(i * 64));
+  }
+  daemon.Start();
+  daemon.Stop();
+
+  // The full ring is past the high water mark: the lines of every other
+  // set are simulated.
+  std::vector<CaptureStats> stats = daemon.GetStats();
+  ASSERT_EQ(1u, stats.size());
+  ASSERT_EQ(32u, stats[0].n_simulated);
+  ASSERT_EQ(32u, stats[0].n_sampled_out);
+  ASSERT_EQ(1u, stats[0].n_dropped);
+  ASSERT_EQ(2u, stats[0].peak_period);
+  ASSERT_DOUBLE_EQ(32.0 / 65, daemon.GetSamplingRatio());
+
+  // Once caught up, every record is simulated again.
+  for (uint64_t i = 0; i < 10; i++) {
+    ring->Push(Record(i * 64 + 64));
+  }
+  region.Detach(ring);
+  daemon.Start();
+  daemon.Stop();
+  stats = daemon.GetStats();
+  ASSERT_EQ(42u, stats[0].n_simulated);
+  ASSERT_EQ(42u, cache->Sum(&MultilevelCache::hits)
+      + cache->Sum(&MultilevelCache::misses));
+  delete cache;
+}
+
+TEST(SimulatorDaemonTest, AnotherProcess) {
+  SharedCaptureRegion region(REGION_NAME, 4, 1024, 16);
+  const pid_t child = fork();
+  ASSERT_NE(-1, child);
+  if (child == 0) {
+    SharedCaptureRegion process_side(REGION_NAME);
+    SharedRing* const ring = process_side.Attach(getpid(), 2);
+    for (uint64_t i = 0; i < 50; i++) {
+      ring->Push(Record(0x2000 + i * 64, ACCESS_STORE));
+    }
+    process_side.Detach(ring);
+    _exit(0);
+  }
+  ASSERT_EQ(child, waitpid(child, NULL, 0));
+
+  ConcurrentMultilevelCache* const cache = NewCache();
+  SimulatorDaemon daemon(region, *cache);
+  daemon.Start();
+  daemon.Stop();
+  const std::vector<CaptureStats> stats = daemon.GetStats();
+  ASSERT_EQ(1u, stats.size());
+  ASSERT_EQ((uint32_t) child, stats[0].pid);
+  ASSERT_EQ(50u, stats[0].n_simulated);
+  ASSERT_EQ(50u, cache->Sum(&MultilevelCache::misses));
+  delete cache;
+}
+
+}
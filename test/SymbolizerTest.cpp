@@ -0,0 +1,184 @@
+/*
+ * SymbolizerTest.cpp
+ *
+ *  Created on: Sep 17, 2016
+ *      Author: vance
+ */
+
+#include "../src/PcAttribution.h"
+#include "../src/Symbolizer.h"
+
+#include <elf.h>
+#include <link.h>
+#include <sstream>
+#include <stdexcept>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+const uint32_t SYMBOLIZED_LINE = __LINE__ + 1;
+int SymbolizedFunction(int value) {
+  return value * 2;
+}
+
+int symbolized_global[4];
+
+int GetProgramBias(struct dl_phdr_info* info, size_t size, void* bias) {
+  // The program comes first.
+  *(uint64_t*) bias = info->dlpi_addr;
+  return 1;
+}
+
+/**
+ * Writes an ELF binary holding only debug_line as its .debug_line section
+ * to a new temporary file, and returns its path.
+ */
+std::string WriteDebugLine(const std::string& debug_line) {
+  const std::string section_names("\0.shstrtab\0.debug_line\0", 24);
+  Elf64_Ehdr header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.e_ident, ELFMAG, SELFMAG);
+  header.e_ident[EI_CLASS] = ELFCLASS64;
+  header.e_ident[EI_DATA] = ELFDATA2LSB;
+  header.e_shentsize = sizeof(Elf64_Shdr);
+  header.e_shnum = 3;
+  header.e_shstrndx = 1;
+  header.e_shoff = sizeof(header) + section_names.size() + debug_line.size();
+  Elf64_Shdr sections[3];
+  memset(sections, 0, sizeof(sections));
+  sections[1].sh_type = SHT_STRTAB;
+  sections[1].sh_name = 1;
+  sections[1].sh_offset = sizeof(header);
+  sections[1].sh_size = section_names.size();
+  sections[2].sh_type = SHT_PROGBITS;
+  sections[2].sh_name = 11;
+  sections[2].sh_offset = sizeof(header) + section_names.size();
+  sections[2].sh_size = debug_line.size();
+  const std::string image = std::string((const char*) &header,
+      sizeof(header)) + section_names + debug_line
+      + std::string((const char*) sections, sizeof(sections));
+
+  char path[] = "/tmp/SymbolizerTestXXXXXX";
+  const int file = mkstemp(path);
+  EXPECT_NE(-1, file);
+  EXPECT_EQ((ssize_t) image.size(), write(file, image.data(), image.size()));
+  close(file);
+  return path;
+}
+
+class SymbolizerTest: public ::testing::Test {
+protected:
+  Symbolizer symbolizer;
+
+  virtual void SetUp() {
+    symbolizer.AddFunction(0x1000, 0x1040, "main");
+    symbolizer.AddFunction(0x1040, 0x1100, "Walk(Node*)");
+    symbolizer.AddLine(0x1000, 0x1010, "main.cpp", 3);
+    symbolizer.AddLine(0x1010, 0x1040, "main.cpp", 4);
+    symbolizer.AddLine(0x1040, 0x1100, "walk.cpp", 12);
+  }
+};
+
+TEST_F(SymbolizerTest, Intervals) {
+  SourceLocation location = symbolizer.Symbolize(0x1010);
+  ASSERT_EQ("main", location.function);
+  ASSERT_EQ("main.cpp", location.file);
+  ASSERT_EQ(4u, location.line);
+  location = symbolizer.Symbolize(0x10ff);
+  ASSERT_EQ("Walk(Node*)", location.function);
+  ASSERT_EQ(12u, location.line);
+  location = symbolizer.Symbolize(0x1100);
+  ASSERT_EQ("???", location.function);
+  ASSERT_EQ("???", location.file);
+  ASSERT_EQ(0u, location.line);
+  ASSERT_EQ("???", symbolizer.Symbolize(0xfff).function);
+  // Intervals added after a lookup are found.
+  symbolizer.AddFunction(0x800, 0x900, "init");
+  ASSERT_EQ("init", symbolizer.Symbolize(0x880).function);
+}
+
+TEST_F(SymbolizerTest, Cachegrind) {
+  PcAttribution attribution(64);
+  attribution.Miss(0x1000);
+  attribution.Miss(0x1008);
+  attribution.Evict(0x1008, 16);
+  attribution.Miss(0x1044);
+  attribution.Miss(0x2000);
+  std::ostringstream stream;
+  symbolizer.WriteCachegrind(stream, attribution, "./walk");
+  ASSERT_EQ("desc: Misses and unused bytes of the lines they filled, "
+      "simulated by VCache\n"
+      "cmd: ./walk\n"
+      "events: Misses Evictions WastedBytes Resident ResWastedBytes\n"
+      "fl=???\n"
+      "fn=???\n"
+      "0 1 0 0 0 0\n"
+      "fl=main.cpp\n"
+      "fn=main\n"
+      "3 2 1 48 0 0\n"
+      "fl=walk.cpp\n"
+      "fn=Walk(Node*)\n"
+      "12 1 0 0 0 0\n"
+      "summary: 4 1 48 0 0\n", stream.str());
+}
+
+TEST_F(SymbolizerTest, Elf) {
+  uint64_t bias = 0;
+  dl_iterate_phdr(GetProgramBias, &bias);
+  Symbolizer elf;
+  ASSERT_TRUE(elf.LoadElf("/proc/self/exe", bias));
+  const SourceLocation location = elf.Symbolize(
+      (ADDRESS) (uintptr_t) &SymbolizedFunction);
+  ASSERT_NE(std::string::npos, location.function.find("SymbolizedFunction"));
+  ASSERT_NE(std::string::npos, location.file.find("SymbolizerTest.cpp"));
+  ASSERT_EQ(SYMBOLIZED_LINE, location.line);
+  ASSERT_EQ(2, SymbolizedFunction(1));
+  bool found = false;
+  for (size_t i = 0; i < elf.data_symbols.size(); i++) {
+    if (elf.data_symbols[i].address
+        == (ADDRESS) (uintptr_t) symbolized_global) {
+      ASSERT_EQ(sizeof(symbolized_global), elf.data_symbols[i].size_B);
+      ASSERT_NE(std::string::npos,
+          elf.data_symbols[i].name.find("symbolized_global"));
+      found = true;
+    }
+  }
+  ASSERT_TRUE(found);
+  ASSERT_THROW(elf.LoadElf("/nonexistent"), std::runtime_error);
+}
+
+TEST_F(SymbolizerTest, MalformedLines) {
+  // A DWARF 2 unit longer than the section, whose header claims to end far
+  // past it.
+  const char unit[] = {
+      (char) 0xf0, (char) 0xff, (char) 0xff, (char) 0xff,  // unit_length
+      2, 0,                                                // version
+      0, 0, (char) 0xff, (char) 0xff,                      // header_length
+      1, 1, -5, 14, 13,
+      0, 1, 1, 1, 1, 0, 0, 0, 1, 0, 0, 1,                  // opcode lengths
+      0,                                                   // directories
+      0 };                                                 // files
+  const std::string path = WriteDebugLine(std::string(unit, sizeof(unit)));
+  Symbolizer elf;
+  EXPECT_THROW(elf.LoadElf(path), std::runtime_error);
+  unlink(path.c_str());
+
+  // The same unit, fitting the section, with an extended opcode longer
+  // than the unit.
+  const std::string opcode("\0\xff\xff\xff\xff\x0f\x01", 7);
+  std::string program(unit, sizeof(unit));
+  program[0] = sizeof(unit) - 4 + opcode.size();
+  program[1] = program[2] = program[3] = 0;
+  program[6] = sizeof(unit) - 10;
+  program[8] = program[9] = 0;
+  program += opcode;
+  const std::string extended_path = WriteDebugLine(program);
+  EXPECT_THROW(elf.LoadElf(extended_path), std::runtime_error);
+  unlink(extended_path.c_str());
+}
+
+}
@@ -0,0 +1,88 @@
+/*
+ * TraceMergerTest.cpp
+ *
+ *  Created on: Aug 9, 2016
+ *      Author: vance
+ */
+
+#include "../src/AccessStream.h"
+#include "../src/TraceMerger.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+class TraceMergerTest: public ::testing::Test {
+protected:
+  static const uint16_t N_THREADS = 3;
+  static const uint32_t N_RECORDS = 4;
+  std::vector<AccessStream*> streams;
+
+  virtual void SetUp() {
+    // Thread t makes its i-th access at time 3 * i + (2 - t).
+    for (uint16_t thread = 0; thread < N_THREADS; thread++) {
+      std::vector<AccessRecord> records;
+      for (uint32_t i = 0; i < N_RECORDS; i++) {
+        records.push_back(
+            AccessRecord(i, 1, ACCESS_LOAD, HINT_NONE, thread,
+                3 * i + (N_THREADS - 1 - thread)));
+      }
+      streams.push_back(new VectorAccessStream(records));
+    }
+  }
+
+  virtual void TearDown() {
+    for (size_t i = 0; i < streams.size(); i++) {
+      delete streams[i];
+    }
+  }
+};
+
+TEST_F(TraceMergerTest, MergeByTimestamp) {
+  TraceMerger merger(streams, MERGE_BY_TIMESTAMP);
+  AccessRecord record;
+  for (uint64_t time = 0; time < N_THREADS * N_RECORDS; time++) {
+    ASSERT_TRUE(merger.Next(record));
+    ASSERT_EQ(time, record.timestamp);
+    ASSERT_EQ(N_THREADS - 1 - time % N_THREADS, record.thread_id);
+  }
+  ASSERT_FALSE(merger.Next(record));
+}
+
+TEST_F(TraceMergerTest, MergeByTimestampTies) {
+  std::vector<AccessRecord> records;
+  records.push_back(AccessRecord(0, 1, ACCESS_LOAD, HINT_NONE, 7, 0));
+  VectorAccessStream tied(records);
+  std::vector<AccessStream*> tied_streams;
+  tied_streams.push_back(streams[2]);
+  tied_streams.push_back(&tied);
+  TraceMerger merger(tied_streams, MERGE_BY_TIMESTAMP);
+  AccessRecord record;
+  // Both streams start at time 0: the stream added first wins.
+  ASSERT_TRUE(merger.Next(record));
+  ASSERT_EQ(2u, record.thread_id);
+  ASSERT_TRUE(merger.Next(record));
+  ASSERT_EQ(7u, record.thread_id);
+}
+
+TEST_F(TraceMergerTest, MergeRoundRobin) {
+  TraceMerger merger(streams, MERGE_ROUND_ROBIN, 3);
+  AccessRecord record;
+  const uint16_t expected[] = { 0, 0, 0, 1, 1, 1, 2, 2, 2, 0, 1, 2 };
+  for (size_t i = 0; i < N_THREADS * N_RECORDS; i++) {
+    ASSERT_TRUE(merger.Next(record));
+    ASSERT_EQ(expected[i], record.thread_id);
+  }
+  ASSERT_FALSE(merger.Next(record));
+}
+
+TEST_F(TraceMergerTest, MergeEmpty) {
+  std::vector<AccessStream*> no_streams;
+  TraceMerger by_timestamp(no_streams, MERGE_BY_TIMESTAMP);
+  TraceMerger round_robin(no_streams, MERGE_ROUND_ROBIN);
+  AccessRecord record;
+  ASSERT_FALSE(by_timestamp.Next(record));
+  ASSERT_FALSE(round_robin.Next(record));
+}
+
+}